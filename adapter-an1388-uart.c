@@ -29,6 +29,7 @@ typedef struct {
     /* Common part */
     adapter_t adapter;
 
+    serial_t *port;
     unsigned char reply [64];
     int reply_len;
 
@@ -118,7 +119,7 @@ static void an1388_command(an1388_adapter_t *a, unsigned char cmd,
         }
         fprintf(stderr, "\n");
     }
-    serial_write(buf, n);
+    serial_write(a->port, buf, n);
 
     if (cmd == CMD_JUMP_APP) {
         /* No reply expected. */
@@ -129,7 +130,7 @@ static void an1388_command(an1388_adapter_t *a, unsigned char cmd,
     c = 0;
     esc = 0;
     while(1) {
-        res = serial_read(buf, 64, 1000);
+        res = serial_read(a->port, buf, 64, 1000);
         /* timeout */
         if (res < 0) {
             a->reply_len = 0;
@@ -193,7 +194,7 @@ static void an1388_close(adapter_t *adapter, int power_on)
     an1388_command(a, CMD_JUMP_APP, 0, 0);
 
     /* restore and close serial port */
-    serial_close();
+    serial_close(a->port);
     free(a);
 }
 
@@ -247,7 +248,7 @@ static void an1388_verify_data(adapter_t *adapter,
     an1388_command(a, CMD_READ_CRC, request, 8);
     if (a->reply_len != 3 || a->reply[0] != CMD_READ_CRC) {
         fprintf(stderr, "uart: cannot read crc at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
     flash_crc = a->reply[1] | a->reply[2] << 8;
 
@@ -280,7 +281,7 @@ static void set_flash_address(an1388_adapter_t *a, unsigned addr)
     an1388_command(a, CMD_PROGRAM_FLASH, request, 7);
     if (a->reply_len != 1 || a->reply[0] != CMD_PROGRAM_FLASH) {
         fprintf(stderr, "uart: error setting flash address at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -320,7 +321,7 @@ static void program_flash(an1388_adapter_t *a,
     an1388_command(a, CMD_PROGRAM_FLASH, request, nbytes + 5);
     if (a->reply_len != 1 || a->reply[0] != CMD_PROGRAM_FLASH) {
         fprintf(stderr, "uart: error programming flash at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -353,30 +354,34 @@ static void an1388_erase_chip(adapter_t *adapter)
     an1388_command(a, CMD_ERASE_FLASH, 0, 0);
     if (a->reply_len != 1 || a->reply[0] != CMD_ERASE_FLASH) {
         fprintf(stderr, "uart: Erase failed\n");
-        exit(-1);
+        session_abort(-1);
     }
 }
 
-adapter_t *adapter_open_an1388_uart(const char *port, int baud_rate)
+adapter_t *adapter_open_an1388_uart(const char *port, int baud_rate, int alt_baud_rate)
 {
     an1388_adapter_t *a;
 
-    /* open serial port */
-    if (serial_open(port, baud_rate) < 0) {
-        /* failed to open serial port */
-        return 0;
-    }
-
     a = calloc(1, sizeof(*a));
     if (! a) {
         fprintf(stderr, "Out of memory\n");
         return 0;
     }
 
+    /* open serial port */
+    a->port = serial_open(port, baud_rate);
+    if (! a->port) {
+        /* failed to open serial port */
+        free(a);
+        return 0;
+    }
+
     /* Read version of adapter. */
     an1388_command(a, CMD_READ_VERSION, 0, 0);
     if (a->reply_len == 0) {
         /* bad reply or no device connected */
+        serial_close(a->port);
+        free(a);
         return 0;
     }
     printf("      Adapter: AN1388 UART Bootloader Version %d.%d\n",
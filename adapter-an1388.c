@@ -89,7 +89,7 @@ static int an1388_recv(hid_device *hiddev, unsigned char *buf)
     n = hid_read(hiddev, buf, 64);
     if (n <= 0) {
         fprintf(stderr, "hidboot: error %d receiving packet\n", n);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 0) {
         int k;
@@ -249,7 +249,7 @@ static void an1388_verify_data(adapter_t *adapter,
     an1388_command(a, CMD_READ_CRC, request, 8);
     if (a->reply_len != 3 || a->reply[0] != CMD_READ_CRC) {
         fprintf(stderr, "hidboot: cannot read crc at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
     flash_crc = a->reply[1] | a->reply[2] << 8;
 
@@ -282,7 +282,7 @@ static void set_flash_address(an1388_adapter_t *a, unsigned addr)
     an1388_command(a, CMD_PROGRAM_FLASH, request, 7);
     if (a->reply_len != 1 || a->reply[0] != CMD_PROGRAM_FLASH) {
         fprintf(stderr, "hidboot: error setting flash address at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -322,7 +322,7 @@ static void program_flash(an1388_adapter_t *a,
     an1388_command(a, CMD_PROGRAM_FLASH, request, nbytes + 5);
     if (a->reply_len != 1 || a->reply[0] != CMD_PROGRAM_FLASH) {
         fprintf(stderr, "hidboot: error programming flash at %08x\n", addr);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -355,7 +355,7 @@ static void an1388_erase_chip(adapter_t *adapter)
     an1388_command(a, CMD_ERASE_FLASH, 0, 0);
     if (a->reply_len != 1 || a->reply[0] != CMD_ERASE_FLASH) {
         fprintf(stderr, "hidboot: Erase failed\n");
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -6,6 +6,9 @@
  *
  * Additions for talking to ascii ICSP programmer Copyright (C) 2015 Robert Rozee
  *
+ * Binary framed protocol (bitbang2:) uses the same programmer commands,
+ * except TMS/TDI sequences are sent as bit-packed frames.
+ *
  * This file is part of PIC32PROG project, which is distributed
  * under the terms of the GNU General Public License (GPL).
  * See the accompanying file "COPYING" for more details.
@@ -21,6 +24,7 @@
 
 typedef struct {
     adapter_t adapter;              /* Common part */
+    serial_t *port;
 
     int BitsToRead;                 // number of 'bits' waiting in Rx buffer
     int CharToRead;                 // number of characters the bits are encoded into
@@ -32,6 +36,9 @@ typedef struct {
     unsigned TotalBitsReceived;     // count of total # of TDO bits recieved
     unsigned MaxBufferedWrites;     // max continuous characters written before read
     unsigned RunningWriteCount;     // running count of characters written, reset by read
+    unsigned SyncedWriteCount;      // characters written up to the pending handshake
+    unsigned BufferSize;            // size of Rx buffer in the programmer
+    unsigned WriteWindow;           // max characters written ahead of the programmer
     unsigned WriteCount;            // number of calls to serial_write
     unsigned Read1Count;            // number of calls to serial_read (data)
     unsigned Read2Count;            // number of calls to serial_read (handshakes)
@@ -41,18 +48,29 @@ typedef struct {
 
     unsigned use_executive;
     unsigned serial_execution_mode;
+    unsigned fastword;              // adapter knows '#', '*' fastdata codes (v1F and up)
+    unsigned binary;                // binary framed protocol (v2A and up)
 } bitbang_adapter_t;
 
 static int DBG1 = 0;    // add format characters to command strings, print out
 static int DBG2 = 0;    // print messages at entry to main routines
 static int DBG3 = 0;    // print our row program parameters
-static int CFG1 = 2;    // 1/2 configure for 64/1024 byte buffer in programming adapter
+static int CFG1 = 0;    // 0 = measure Rx buffer of programming adapter at open
+                        // 1/2 configure for 64/512 byte buffer in programming adapter
 static int CFG2 = 1;    // 1/2 config to retrieve PrAcc and alert if (PrAcc != 1)
                         // (note: option 2 doubles programming time)
 static int CFG3 = 1;    // 0 = uncompressed stream (use only 'd','e','f','g'
                         // 1 = use 4-bit packing (on data only) 'i'-'x','I'-'X','a','z','A'
 static int CFG4 = 1;    // decompression method in serial read (normally set to match CFG3)
-static int MAXW = 440;  // maximum continuous write before sync: 900 + 50 < 1024, 440 + 30 < 512
+static int CFG5 = 1;    // 1 = use whole-word fastdata codes '#' and '*', if adapter is v1F or later
+
+/*
+ * Binary framed protocol: a shift frame is
+ *      B2_SHIFT | read_flag, tms_nbits, TMS bytes, tdi_nbits, TDI bytes
+ * with TMS and TDI packed LSB first into (nbits + 7) / 8 bytes.
+ * Opcodes are below 0x20, so they never clash with ascii commands.
+ */
+#define B2_SHIFT        0x10    // shift frame, plus read_flag in low bits
 
 /*
  * Calculate checksum.
@@ -86,11 +104,125 @@ static void bitbang_delay10mS(bitbang_adapter_t *a, int caller)
     unsigned char ch;
 
     ch = '8';
-    serial_write(&ch, 1);
+    serial_write(a->port, &ch, 1);
     a->WriteCount++;
     a->DelayCount[caller]++;
 }
 
+/*
+ * Update the statistics of buffered writes, when the programmer
+ * got in sync with us: either the '<' reply to a sync request came,
+ * or (when all_done is set) the reply to a read request.
+ */
+static void bitbang_synced(bitbang_adapter_t *a, int all_done)
+{
+    if (a->SyncedWriteCount + a->RunningWriteCount > a->MaxBufferedWrites)
+        a->MaxBufferedWrites = a->SyncedWriteCount + a->RunningWriteCount;
+    a->SyncedWriteCount = 0;
+    if (all_done)
+        a->RunningWriteCount = 0;
+}
+
+/*
+ * Write a string of codes to the programmer, with handshaking.
+ * The buffer must have room for two more characters: a handshake
+ * request '>' and a trailing zero. Return the resulting length.
+ * (by RR)
+ */
+static int bitbang_write(bitbang_adapter_t *a,
+    unsigned char *buffer, int index, int read_flag)
+{
+    unsigned char ch;
+    int n;
+
+    //
+    // Control handshaking for ICSP programmers. A sync request '>' is
+    // placed when half of the write window is used, and the '<' reply is
+    // awaited only when the window gets full, or before reading data.
+    // Meanwhile the programmer keeps working through its Rx buffer.
+    //
+
+    if (a->PendingHandshake && (read_flag ||
+        a->SyncedWriteCount + a->RunningWriteCount + index > a->WriteWindow))
+    {
+        bitbang_synced(a, 0);
+        a->PendingHandshake = 0;
+
+        n = serial_read(a->port, &ch, 1, 250);
+        a->Read2Count++;
+
+        if (n != 1 || ch != '<')
+            fprintf(stderr, "WARNING - handshake read error (in write)\n");
+    }
+
+    if (!read_flag && !a->PendingHandshake &&
+        (a->RunningWriteCount + index) > a->WriteWindow / 2)
+    {
+        buffer[index++] = '>';
+        a->PendingHandshake = 1;
+        a->SyncedWriteCount = a->RunningWriteCount + index;
+        a->RunningWriteCount = 0;
+    }
+    else
+        a->RunningWriteCount += index;           // number of characters being written
+
+    //
+    // end of handshaking code
+    //
+
+    buffer[index] = 0;          // append trailing zero so can print as a string
+
+    serial_write(a->port, buffer, index);
+    a->WriteCount++;
+    return index;
+}
+
+/*
+ * Send TMS and TDI bits as a binary frame. The programmer applies
+ * TMS bits, then the data header 1-0-0, TDI bits with TMS = 1 on the
+ * last one, and the data footer 1-0, as with 'a', 'i'..'x', 'z' codes.
+ *
+ * if read_flag == 1, respond with TDO of the last header bit and
+ *                    the n-1 data bits, packed into bytes
+ * if read_flag == 2, respond with one byte, TDO of the last header bit
+ * if read_flag == 3, accumulate TDO of the last header bit in PrAcc
+ */
+static void bitbang2_send(bitbang_adapter_t *a,
+    unsigned tms_nbits, unsigned tms,
+    unsigned tdi_nbits, unsigned long long tdi, int read_flag)
+{
+    unsigned char buffer[20];
+    int index = 0, i;
+
+    if (a->BitsToRead != 0)
+        fprintf(stderr, "WARNING - write while pending read (in send)\n");
+    if (read_flag && (tdi_nbits == 0))
+        fprintf(stderr, "WARNING - request to read 0 bits (in send)\n");
+
+    buffer[index++] = B2_SHIFT | read_flag;
+    buffer[index++] = tms_nbits;
+    for (i = 0; i < tms_nbits; i += 8)
+        buffer[index++] = tms >> i;
+    buffer[index++] = tdi_nbits;
+    for (i = 0; i < tdi_nbits; i += 8)
+        buffer[index++] = tdi >> i;
+
+    a->BitsToRead = (read_flag == 1 ? tdi_nbits : read_flag == 2 ? 1 : 0);
+    a->CharToRead = (a->BitsToRead + 7) / 8;
+
+    a->TotalBitPairsSent += tms_nbits + (tdi_nbits ? tdi_nbits + 5 : 0);
+    a->TotalCodeChrsSent += index;
+
+    index = bitbang_write(a, buffer, index, read_flag == 1 || read_flag == 2);
+
+    if (DBG1) {
+        printf("n=%i, <", index);
+        for (i = 0; i < index; i++)
+            printf("%s%02x", i ? " " : "", buffer[i]);
+        printf("> read=%i\n", read_flag);
+    }
+}
+
 /*
  * Current version of bitbang_send, sends a string of data out to the target encoded
  * as ASCII characters to be interpreted by an intellenent ICSP programmer.
@@ -120,6 +252,10 @@ static void bitbang_delay10mS(bitbang_adapter_t *a, int caller)
  * 'A' : data header with read_flag = 1 on last bit
  * 'I'..'X' : 4 TDI bits encoded, TMS = 0, read_flag = 1
  *
+ * '#' : whole FASTDATA word, followed by 6 characters '0'..'o' with 6 bits each
+ * '*' : run of 0xFFFFFFFF FASTDATA words, followed by count-1 as '0'..'o'
+ * '=' : retrieve PrAcc accumulated by '#' and '*', then set PrAcc = 1
+ *
  * '.' : no operation, used for formatting
  * '>' : request sync response - '<'
  *
@@ -134,6 +270,11 @@ static void bitbang_delay10mS(bitbang_adapter_t *a, int caller)
  *
  * if the request is 'D'..'G', then respond with '0'/'1' to indicate TDO = 0/1
  * if the request is 'I'..'X', then respond with 'I'..'X' encoding 4 TDO bits
+ * if the request is '=', then respond with '0'/'1' to indicate PrAcc
+ *
+ * '#', '*' and '=' are available in adapters v1F and later.
+ * In binary mode (v2A), the TMS/TDI codes are replaced by frames,
+ * see bitbang2_send().
  *
  * (by RR)
  */
@@ -159,9 +300,14 @@ static void bitbang_send(bitbang_adapter_t *a,
     int index = 0;              // index of next slot to use in buffer
     int pairs = 0;              // count of number of TDI/TMS pairs
     int count = 0;              // count of the number of symbols used
-    int i, n;
+    int i;
     unsigned char ch;
 
+    if (a->binary) {
+        bitbang2_send(a, tms_nbits, tms, tdi_nbits, tdi, read_flag);
+        return;
+    }
+
     if (a->BitsToRead != 0)
         fprintf(stderr, "WARNING - write while pending read (in send)\n");
     if (read_flag && (tdi_nbits == 0))
@@ -242,58 +388,11 @@ static void bitbang_send(bitbang_adapter_t *a,
         pairs += 2;
     }
 
-    //
-    // Control handshaking for ICSP programmers
-    //
-
-    if (a->PendingHandshake)
-    {
-        //////// this code is also duplicated in bitbang_send ////////
-        if (a->RunningWriteCount > a->MaxBufferedWrites)
-            a->MaxBufferedWrites = a->RunningWriteCount;
-        a->RunningWriteCount = 0;
-        //////////////////////////////////////////////////////////////
-
-        a->PendingHandshake = 0;
-
-        n = serial_read(&ch, 1, 250);
-        a->Read2Count++;
-
-        if (n != 1 || ch != '<')
-            fprintf(stderr, "WARNING - handshake read error (in send)\n");
-    }
-
-    //
-    // the below block is to implement handshake on
-    // EVERY write that does not have (read_flag != 0)
-    //
-    if (CFG1 == 1 && !read_flag)
-    {
-        buffer[index++] = '>';
-        a->PendingHandshake = 1;
-    }
-
-    //
-    // this block is to implement handshake on every 900/440 (MAXW) characters
-    // NOTE: assumes the Rx buffer in the programmer is 1024/512 bytes long
-    //                                                  **************
-
-    if (CFG1 == 2 && !read_flag && (a->RunningWriteCount + index) > MAXW)   // 900 + 50 < 1024
-    {                                                                       // 440 + 30 < 512
-        buffer[index++] = '>';
-        a->PendingHandshake = 1;
-    }
-
-    //
-    // end of handshaking code
-    //
-
-    buffer[index] = 0;          // append trailing zero so can print as a string
-
-    a->RunningWriteCount += index;               // number of characters being written
     a->TotalBitPairsSent += pairs;               // number of TDI/TMS pairs encoded
     a->TotalCodeChrsSent += count;               // number of symbols used to send pairs
 
+    index = bitbang_write(a, buffer, index, read_flag);
+
     if (DBG1) {
         unsigned L4 = Xtdi >> 48;
         unsigned L3 = (Xtdi >> 32) & 0xFFFF;
@@ -302,9 +401,6 @@ static void bitbang_send(bitbang_adapter_t *a,
         printf("n=%i, <%s> read=%i TDI: %04x %04x %04x %04x\n",
                 index, buffer, read_flag, L4,  L3,  L2,  L1);
     }
-
-    serial_write(buffer, index);
-    a->WriteCount++;
 }
 
 /*
@@ -316,18 +412,42 @@ static unsigned long long bitbang_recv(bitbang_adapter_t *a)
     unsigned long long word;
     int n, i;
 
-    //////// this code is also duplicated in bitbang_send ////////
-    if (a->RunningWriteCount > a->MaxBufferedWrites)
-        a->MaxBufferedWrites = a->RunningWriteCount;
-    a->RunningWriteCount = 0;
-    //////////////////////////////////////////////////////////////
-
+    bitbang_synced(a, 1);
     if (a->PendingHandshake)
         fprintf(stderr, "WARNING - handshake pending error (in recv)\n");
 
+    if (a->binary) {
+        // TDO bits come back packed, LSB first
+        for (n = 0; n < a->CharToRead; n += i) {
+            i = serial_read(a->port, buffer + n, a->CharToRead - n, 250);
+            a->Read1Count++;
+            if (i <= 0)
+                break;
+        }
+        a->TotalCodeChrsRecv += n;
+        if (n != a->CharToRead)
+            fprintf(stderr,
+                "WARNING - fewer bytes read (%i) than expected (%i) (in recv)\n",
+                                         n,           a->CharToRead);
+        word = 0;
+        for (i = n-1; i >= 0; i--)
+            word = (word << 8) | buffer[i];
+        if (a->BitsToRead < 64)
+            word &= (1ULL << a->BitsToRead) - 1;
+
+        if (DBG1)
+            printf("TDO = %08x %08x (%i bits)\n", (unsigned) (word >> 32),
+                                   (unsigned) word, a->BitsToRead);
+
+        a->TotalBitsReceived += a->BitsToRead;
+        a->BitsToRead = 0;
+        a->CharToRead = 0;
+        return word;
+    }
+
     int expected = (CFG4 ? a->CharToRead : a->BitsToRead);
 
-    n = serial_read(buffer, expected, 250);
+    n = serial_read(a->port, buffer, expected, 250);
     a->TotalCodeChrsRecv += n;
     a->Read1Count++;
     buffer[n] = 0;              // append trailing zero so can print as a string
@@ -373,6 +493,33 @@ static unsigned long long bitbang_recv(bitbang_adapter_t *a)
     return word;
 }
 
+/*
+ * Find the size of Rx buffer in the programmer. A burst of characters
+ * is sent, starting with a few 10mS delays, so that the rest of the
+ * burst has to wait in the buffer. If the buffer is too small, the
+ * trailing sync request '>' is lost and no '<' comes back.
+ */
+static unsigned bitbang_measure_buffer(bitbang_adapter_t *a)
+{
+    static const unsigned sizes[] = { 1024, 512, 256, 128, 0 };
+    unsigned char buffer[1024], ch;
+    unsigned i, n, size, ndelays;
+
+    for (i = 0; sizes[i] != 0; i++) {
+        size = sizes[i];
+        ndelays = size / 100 + 2;           // 1024 chars take 90mS at 115200 baud
+        memset(buffer, '.', size - 1);      // ring buffer holds (size - 1) chars
+        memset(buffer, '8', ndelays);
+        buffer[size - 2] = '>';
+        serial_write(a->port, buffer, size - 1);
+
+        n = serial_read(a->port, &ch, 1, 250 + ndelays * 10);
+        if (n == 1 && ch == '<')
+            return size;
+    }
+    return 64;                              // as in original Arduino core
+}
+
 /*
  * this routine performs the functions:
  * (1) power up the target, then send out the ICSP signature to enable ICSP programming mode;
@@ -388,7 +535,7 @@ static void bitbang_ICSP_enable(bitbang_adapter_t *a, int ICSP_EN)
                                  // 0000000001111111111222222222233333333334444444444555555555566666
                                  // 1234567890123456789012345678901234567890123456789012345678901234
 
-        serial_write(buffer, 64);
+        serial_write(a->port, buffer, 64);
         usleep(150000);    // 150mS delay to allow the above to percolate through the system
     }
     else
@@ -398,7 +545,7 @@ static void bitbang_ICSP_enable(bitbang_adapter_t *a, int ICSP_EN)
                                  // 0000000001111111
                                  // 1234567890123456
 
-        serial_write(buffer, 16);
+        serial_write(a->port, buffer, 16);
 
         // 100mS delay to allow the above to percolate through the system
         usleep(100000);
@@ -431,6 +578,8 @@ static void bitbang_close(adapter_t *adapter, int power_on)
     printf("total ascii codes sent   = %i\n", a->TotalCodeChrsSent);
     printf("total ascii codes recv   = %i\n", a->TotalCodeChrsRecv);
     printf("maximum continuous write = %i chars\n", a->MaxBufferedWrites);
+    printf("programmer Rx buffer     = %i chars (window %i)\n", a->BufferSize,
+                                                              a->WriteWindow);
 
     printf("O/S serial writes        = %i\n", a->WriteCount);
     printf("O/S serial reads (data)  = %i\n", a->Read1Count);
@@ -442,7 +591,7 @@ static void bitbang_close(adapter_t *adapter, int power_on)
     printf("elapsed programming time = %lum %02lus\n", (a->T2.tv_sec - a->T1.tv_sec) / 60,
                                                        (a->T2.tv_sec - a->T1.tv_sec) % 60);
 
-    serial_close();                    // at this point we are exiting application???
+    serial_close(a->port);                    // at this point we are exiting application???
 //  free(a);                           // suspect this line was causing XP CRASHES
                                        // - shouldn't be needed anyway
 }
@@ -495,7 +644,7 @@ static void serial_execution(bitbang_adapter_t *a)
         fprintf(stderr, "status %04x\n", status);
     if ((status & MCHP_STATUS_CPS) == 0) {
         fprintf(stderr, "invalid status = %04x (code protection)\n", status);   // 4.
-        exit(-1);
+        session_abort(-1);
     }
 
     bitbang_send(a, 0, 0, 8, MCHP_ASSERT_RST, 0);   /* Xfer data. */            // 5.
@@ -523,8 +672,87 @@ static void serial_execution(bitbang_adapter_t *a)
 // UPDATE2: We are operating at such a slow speed that the PrAcc
 // check is not really needed. To date, have never seen PrAcc != 1
 //
+/*
+ * Send FASTDATA words using whole-word codes of v1F adapters:
+ * '#' with the word packed into 6 characters, or '*' with
+ * the length of a run of 0xFFFFFFFF words (erased flash).
+ * The adapter accumulates PrAcc of every word.
+ */
+static void fastword_send(bitbang_adapter_t *a, unsigned *data, unsigned nwords)
+{
+    unsigned char buffer[40];
+    unsigned n, word;
+    int index, i;
+
+    while (nwords > 0) {
+        index = 0;
+        if (*data == 0xFFFFFFFF) {
+            for (n = 1; n < nwords && n < 64; n++)
+                if (data[n] != 0xFFFFFFFF)
+                    break;
+            buffer[index++] = '*';
+            buffer[index++] = '0' + n - 1;
+        } else {
+            for (n = 0; n < nwords && n < 4; n++) {
+                if (data[n] == 0xFFFFFFFF)
+                    break;
+                buffer[index++] = '#';
+                word = data[n];
+                for (i = 0; i < 6; i++) {       // LSB first
+                    buffer[index++] = '0' + (word & 0x3F);
+                    word >>= 6;
+                }
+            }
+        }
+        a->FDataCount += n;
+        a->TotalBitPairsSent += n * 38;         // header, PrAcc, 32 data bits, footer
+        a->TotalCodeChrsSent += index;
+
+        index = bitbang_write(a, buffer, index, 0);
+        if (DBG1)
+            printf("n=%i, <%s> fastdata x%u: %08x\n", index, buffer, n, *data);
+
+        data += n;
+        nwords -= n;
+    }
+}
+
+/*
+ * Retrieve PrAcc, accumulated by the adapter.
+ */
+static unsigned fastword_pracc(bitbang_adapter_t *a)
+{
+    unsigned char buffer[3], ch;
+    int n;
+
+    /* Room for the handshake request and trailing zero. */
+    buffer[0] = '=';
+    bitbang_write(a, buffer, 1, 1);
+    bitbang_synced(a, 1);
+
+    n = serial_read(a->port, &ch, 1, 250);
+    a->Read1Count++;
+    a->TotalCodeChrsRecv += n;
+    if (n != 1 || (ch != '0' && ch != '1')) {
+        fprintf(stderr, "WARNING - PrAcc read error (in fastword)\n");
+        return 0;
+    }
+    return ch == '1';
+}
+
 static void xfer_fastdata(bitbang_adapter_t *a, unsigned word)
 {
+    if (a->fastword) {
+        fastword_send(a, &word, 1);
+        return;
+    }
+    if (a->binary) {
+        // PrAcc is accumulated by the programmer
+        a->FDataCount++;
+        bitbang_send(a, 0, 0, 33, (unsigned long long) word << 1, 3);
+        return;
+    }
+
     a->FDataCount++;
 
     if (CFG2 == 1)
@@ -548,6 +776,28 @@ static void xfer_fastdata(bitbang_adapter_t *a, unsigned word)
     // used as the check command (PrAcc |= TDO), while '=' used to read out
     // the result (PrAcc) and reset the accumulator (PrAcc = 1) at the
     // programming adaptor.
+    //
+    // UPDATE3: done for v1F adapters, see xfer_fastblock.
+}
+
+/*
+ * Send a block of data words to the PE.
+ * With v1F or binary adapter, PrAcc is checked once for the whole block.
+ */
+static void xfer_fastblock(bitbang_adapter_t *a, unsigned *data, unsigned nwords)
+{
+    if (! a->fastword) {
+        while (nwords-- > 0)
+            xfer_fastdata(a, *data++);
+        if (! a->binary)
+            return;
+    } else
+        fastword_send(a, data, nwords);
+
+    if (! fastword_pracc(a)) {
+        printf("!");
+        fflush(stdout);
+    }
 }
 
 static void xfer_instruction(bitbang_adapter_t *a, unsigned instruction)
@@ -582,7 +832,7 @@ static void xfer_instruction(bitbang_adapter_t *a, unsigned instruction)
 
     if (i == 150) {
         fprintf(stderr, "PE response, PrAcc not set (in XferInstruction)\n");
-        exit(-1);
+        session_abort(-1);
     }
 
     // Select Data Register
@@ -625,7 +875,7 @@ static unsigned get_pe_response(bitbang_adapter_t *a)
 
     if (i == 150) {
         fprintf(stderr, "PE response, PrAcc not set (in GetPEResponse)\n");
-        exit(-1);
+        session_abort(-1);
     }
 
     // Select Data Register
@@ -706,7 +956,7 @@ static void bitbang_read_data(adapter_t *adapter,
         if (response != PE_READ << 16) {
             fprintf(stderr, "bad READ response = %08x, expected %08x\n",
                                                response,     PE_READ << 16);
-            exit(-1);
+            session_abort(-1);
         }
         for (i = 0; i < 32; i++) {
             *data++ = get_pe_response(a);           /* Get data */
@@ -718,11 +968,59 @@ static void bitbang_read_data(adapter_t *adapter,
 /*
  * Download programming executive (PE).
  */
+static int bitbang_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes);
+
+/*
+ * Check whether the PE, downloaded before, is still running.
+ * The PE must accept EXEC_VERSION command on FASTDATA
+ * and return the expected version, and the checksum of its
+ * image in RAM must match the code.
+ */
+static int pe_resident(bitbang_adapter_t *a,
+    const unsigned *pe, unsigned nwords, unsigned pe_version)
+{
+    unsigned version, crc;
+
+    /* A waiting PE completes the FASTDATA access at once;
+     * otherwise PrAcc is not set and nothing is executed. */
+    bitbang_send(a, 1, 1, 5, ETAP_FASTDATA, 0);  /* Send command. */
+    bitbang_send(a, 0, 0, 33, (unsigned long long) (PE_EXEC_VERSION << 16) << 1, 2);
+    if (! (bitbang_recv(a) & 1))
+        return 0;
+
+    version = get_pe_response(a);
+    if (version != (PE_EXEC_VERSION << 16 | pe_version)) {
+        if (debug_level > 0)
+            fprintf(stderr, "stale PE version = %08x\n", version);
+        return 0;
+    }
+
+    /* PE code is at 0xA000_0900. */
+    crc = bitbang_get_crc(&a->adapter, 0x900, nwords * 4);
+    if (crc != calculate_crc(0xffff, (unsigned char*) pe, nwords * 4)) {
+        if (debug_level > 0)
+            fprintf(stderr, "stale PE image, crc = %04x\n", crc);
+        return 0;
+    }
+    return 1;
+}
+
 static void bitbang_load_executive(adapter_t *adapter,
     const unsigned *pe, unsigned nwords, unsigned pe_version)
 {
     bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
 
+    /* PE, downloaded in this session, can still be running:
+     * serial execution mode has not been entered again. */
+    if (a->use_executive && a->serial_execution_mode) {
+        if (pe_resident(a, pe, nwords, pe_version)) {
+            printf("   Loading PE: already running\n");
+            return;
+        }
+        /* Board was reset: enter serial execution again. */
+        a->serial_execution_mode = 0;
+    }
+
     a->use_executive = 1;
     serial_execution(a);
 
@@ -800,9 +1098,7 @@ static void bitbang_load_executive(adapter_t *adapter,
     fflush(stdout);
 
     /* Download the PE itself (step 7-B). */
-    for (i = 0; i < nwords; i++) {
-        xfer_fastdata(a, *pe++);
-    }
+    xfer_fastblock(a, (unsigned*) pe, nwords);
     bitbang_delay10mS(a, 3);
     printf(" 7b");
     fflush(stdout);
@@ -820,7 +1116,7 @@ static void bitbang_load_executive(adapter_t *adapter,
     if (version != (PE_EXEC_VERSION << 16 | pe_version)) {
         fprintf(stderr, "\nbad PE version = %08x, expected %08x\n",
                        version, PE_EXEC_VERSION << 16 | pe_version);
-        exit(-1);
+        session_abort(-1);
     }
 
     printf(" v%04x\n", version & 0xFFFF);
@@ -858,10 +1154,15 @@ static void bitbang_erase_chip(adapter_t *adapter)
 
     if (i == 100) {
         fprintf(stderr, "invalid status = %04x (in erase chip)\n", status);
-        exit(-1);
+        session_abort(-1);
     }
     printf("(%imS) ", i * 10);
     fflush(stdout);
+
+    /* Chip erase resets the processor: serial execution
+     * mode and the PE are lost. */
+    a->serial_execution_mode = 0;
+    a->use_executive = 0;
 }
 
 /*
@@ -885,7 +1186,7 @@ static void bitbang_program_word(adapter_t *adapter,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "slow flash write not implemented yet\n");
-        exit(-1);
+        session_abort(-1);
     }
 
     if (memcmp(a->adapter.family_name, "mz", 2) == 0) {
@@ -903,7 +1204,36 @@ static void bitbang_program_word(adapter_t *adapter,
     if (response != (PE_WORD_PROGRAM << 16)) {
         fprintf(stderr, "\nfailed to program word %08x at %08x, reply = %08x\n",
                                                    word,   addr,       response);
-        exit(-1);
+        session_abort(-1);
+    }
+}
+
+/*
+ * Erase pages of flash memory.
+ */
+static void bitbang_erase_page(adapter_t *adapter, unsigned addr, unsigned npages)
+{
+    bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
+
+    if (DBG2)
+        fprintf(stderr, "erase_page\n");
+
+    if (! a->use_executive) {
+        /* Without PE. */
+        fprintf(stderr, "page erase without PE not implemented\n");
+        session_abort(-1);
+    }
+
+    /* Use PE to erase flash memory. */
+    bitbang_send(a, 1, 1, 5, ETAP_FASTDATA, 0); /* Send command. */
+    xfer_fastdata(a, PE_PAGE_ERASE << 16 | npages);
+    xfer_fastdata(a, addr);                     /* Send address. */
+
+    unsigned response = get_pe_response(a);
+    if (response != (PE_PAGE_ERASE << 16)) {
+        fprintf(stderr, "\nfailed to erase %u pages at %08x, reply = %08x\n",
+                                          npages,     addr,       response);
+        session_abort(-1);
     }
 }
 
@@ -926,7 +1256,7 @@ static void bitbang_program_row(adapter_t *adapter, unsigned addr,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "slow flash write not implemented yet\n");
-        exit(-1);
+        session_abort(-1);
     }
 
     /* Use PE to write flash memory. */
@@ -939,71 +1269,149 @@ static void bitbang_program_row(adapter_t *adapter, unsigned addr,
     //
 
     /* Download data. */
-    int i;
-    for (i = 0; i < words_per_row; i++) {
-        xfer_fastdata(a, *data++);               /* Send word. */
-    }
+    xfer_fastblock(a, data, words_per_row);
 
     unsigned response = get_pe_response(a);
     if (response != (PE_ROW_PROGRAM << 16)) {
         fprintf(stderr, "\nfailed to program row at %08x, reply = %08x\n",
                                                      addr,         response);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
 /*
- * Verify a block of memory.
+ * Program a contiguous run of rows by one PE command.
  */
-static void bitbang_verify_data(adapter_t *adapter,
-    unsigned addr, unsigned nwords, unsigned *data)
+static void bitbang_program_cluster(adapter_t *adapter, unsigned addr,
+    unsigned *data, unsigned nwords)
 {
     bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
-    unsigned data_crc, flash_crc;
 
     if (DBG2)
-        fprintf(stderr, "verify_data\n");
-    if (DBG3)
-        fprintf(stderr, "\nverifying %u words at %08x ", nwords, addr);
+        fprintf(stderr, "program_cluster\n");
 
+    if (debug_level > 0)
+        fprintf(stderr, "cluster program %u words at %08x\n", nwords, addr);
     if (! a->use_executive) {
         /* Without PE. */
-        fprintf(stderr, "slow verify not implemented yet\n");
-        exit(-1);
+        fprintf(stderr, "slow flash write not implemented yet\n");
+        session_abort(-1);
     }
 
+    /* Use PE to write flash memory. */
+    bitbang_send(a, 1, 1, 5, ETAP_FASTDATA, 0);  /* Send command. */
+    xfer_fastdata(a, PE_PROGRAM_CLUSTER << 16);
+    xfer_fastdata(a, addr);                      /* Send address. */
+    xfer_fastdata(a, nwords * 4);                /* Send length. */
+
+    /* Download data. */
+    xfer_fastblock(a, data, nwords);
+
+    unsigned response = get_pe_response(a);
+    if (response != (PE_PROGRAM_CLUSTER << 16)) {
+        fprintf(stderr, "\nfailed to program cluster at %08x, reply = %08x\n",
+                                                         addr,         response);
+        session_abort(-1);
+    }
+}
+
+/*
+ * Get checksum of flash memory, computed by PE.
+ * Return -1 when PE is not loaded.
+ */
+static int bitbang_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
+
+    if (DBG2)
+        fprintf(stderr, "get_crc\n");
+
+    if (! a->use_executive)
+        return -1;
+
     /* Use PE to get CRC of flash memory. */
     bitbang_send(a, 1, 1, 5, ETAP_FASTDATA, 0);  /* Send command. */
     xfer_fastdata(a, PE_GET_CRC << 16);
     xfer_fastdata(a, addr);                      /* Send address. */
-    xfer_fastdata(a, nwords * 4);                /* Send length. */
+    xfer_fastdata(a, nbytes);                    /* Send length. */
 
     unsigned response = get_pe_response(a);
     if (response != (PE_GET_CRC << 16)) {
-        fprintf(stderr, "\nfailed to verify %d words at %08x, reply = %08x\n",
-                                             nwords,     addr,       response);
-        exit(-1);
+        fprintf(stderr, "\nfailed to verify %d bytes at %08x, reply = %08x\n",
+                                             nbytes,     addr,       response);
+        session_abort(-1);
+    }
+
+    return get_pe_response(a) & 0xffff;
+}
+
+/*
+ * Check that memory is erased, using PE.
+ * Return 1 when blank, 0 when not blank, -1 without PE.
+ */
+static int bitbang_blank_check(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
+
+    if (DBG2)
+        fprintf(stderr, "blank_check\n");
+
+    if (! a->use_executive)
+        return -1;
+
+    bitbang_send(a, 1, 1, 5, ETAP_FASTDATA, 0);  /* Send command. */
+    xfer_fastdata(a, PE_BLANK_CHECK << 16);
+    xfer_fastdata(a, addr);                      /* Send address. */
+    xfer_fastdata(a, nbytes);                    /* Send length. */
+
+    unsigned response = get_pe_response(a);
+    if ((response >> 16) != PE_BLANK_CHECK) {
+        fprintf(stderr, "\nfailed to blank check %d bytes at %08x, reply = %08x\n",
+                                                  nbytes,     addr,       response);
+        session_abort(-1);
+    }
+    return (response & 0xffff) == 0;
+}
+
+/*
+ * Verify a block of memory.
+ */
+static void bitbang_verify_data(adapter_t *adapter,
+    unsigned addr, unsigned nwords, unsigned *data)
+{
+    bitbang_adapter_t *a = (bitbang_adapter_t*) adapter;
+    unsigned data_crc, flash_crc;
+
+    if (DBG2)
+        fprintf(stderr, "verify_data\n");
+    if (DBG3)
+        fprintf(stderr, "\nverifying %u words at %08x ", nwords, addr);
+
+    if (! a->use_executive) {
+        /* Without PE. */
+        fprintf(stderr, "slow verify not implemented yet\n");
+        session_abort(-1);
     }
 
-    flash_crc = get_pe_response(a) & 0xffff;
+    flash_crc = bitbang_get_crc(adapter, addr, nwords * 4);
 
     data_crc = calculate_crc(0xffff, (unsigned char*) data, nwords * 4);
     if (flash_crc != data_crc) {
         fprintf(stderr, "\nchecksum failed at %08x: returned %04x, expected %04x\n",
                                                addr,        flash_crc,     data_crc);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
+static adapter_t *bitbang_open(const char *port, int baud_rate, int binary);
+
 /*
  * Initialize bitbang adapter.
  * Return a pointer to a data structure, allocated dynamically.
  * When adapter not found, return 0.
  */
-adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
+adapter_t *adapter_open_bitbang(const char *port, int baud_rate, int alt_baud_rate)
 {
-    bitbang_adapter_t *a;
-
     printf("       (ascii ICSP coded by Robert Rozee)\n\n");
 
 //
@@ -1034,11 +1442,12 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
         int i, n;
         unsigned char buffer [140];                     // 0x80 + 12d (max used is 133)
         int bps[] = {0, 9600, 19200, 57600, 115200 };   // known arduino bootloader baud rates
+        serial_t *s;
 
-        if (serial_open(port, bps[baud_rate]) < 0) {
+        s = serial_open(port, bps[baud_rate]);
+        if (! s) {
             fprintf(stderr, "Unable to configure serial port %s\n", port);
-            serial_close();
-            exit(-1);
+            session_abort(-1);
         }
         printf("%i baud ", bps[baud_rate]);
         fflush(stdout);
@@ -1048,41 +1457,41 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
             buffer[0] = STK_GET_SYNC;                   // get synchronization
             buffer[1] = CRC_EOP;
 
-            serial_write(buffer, 2);
+            serial_write(s, buffer, 2);
             printf(".");
             fflush(stdout);
-            n = serial_read(buffer, 2, 100);
+            n = serial_read(s, buffer, 2, 100);
             if ((n == 2) && (buffer[0] == STK_INSYNC) && (buffer[1] == STK_OK))
                 i = 100;
         }
 
         if (i < 100) {
             fprintf(stderr, "\nFailed to find arduino/STK500 bootloader\n");
-            serial_close();
-            exit(-1);
+            serial_close(s);
+            session_abort(-1);
         }
         printf(" synchronized\n");
 
         buffer[0] = STK_ENTER_PROGMODE;                 // enter program mode (not needed)
         buffer[1] = CRC_EOP;
-        serial_write(buffer, 2);
-        n = serial_read(buffer, 2, 100);
+        serial_write(s, buffer, 2);
+        n = serial_read(s, buffer, 2, 100);
 
         if ((n != 2) || (buffer[0] != STK_INSYNC) || (buffer[1] != STK_OK)) {
             fprintf(stderr, "Failed to enter program mode\n");
-            serial_close();
-            exit(-1);
+            serial_close(s);
+            session_abort(-1);
         }
 
         buffer[0] = STK_READ_SIGN;                      // read signature bytes (3)
         buffer[1] = CRC_EOP;
-        serial_write(buffer, 2);
-        n = serial_read(buffer, 5, 100);
+        serial_write(s, buffer, 2);
+        n = serial_read(s, buffer, 5, 100);
 
         if ((n != 5) || (buffer[0] != STK_INSYNC) || (buffer[4] != STK_OK)) {
             fprintf(stderr, "Failed to get signature\n");
-            serial_close();
-            exit(-1);
+            serial_close(s);
+            session_abort(-1);
         }
         unsigned ID = (buffer[1] << 16) + (buffer[2] << 8) + buffer[3];
         printf("Signature = %06x   Device = %s\n", ID, ID == 0x1e950f ? "ATmega328P" : "(wrong uP)");
@@ -1100,13 +1509,13 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
             buffer[1] = (i >> 1) % 0x100;               // address low (word boundary)
             buffer[2] = (i >> 1) / 0x100;               // address high
             buffer[3] = CRC_EOP;
-            serial_write(buffer, 4);
-            n = serial_read(buffer, 2, 100);
+            serial_write(s, buffer, 4);
+            n = serial_read(s, buffer, 2, 100);
 
             if ((n != 2) || (buffer[0] != STK_INSYNC) || (buffer[1] != STK_OK)) {
                 fprintf(stderr, "\nFailed to load address %04x\n", i);
-                serial_close();
-                exit(-1);
+                serial_close(s);
+                session_abort(-1);
             }
 
             buffer[0] = STK_PROG_PAGE;                  // program page
@@ -1115,39 +1524,60 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
             buffer[3] = 'F';                            // memory type: 'E' = eeprom, 'F' = flash
             memcpy(&buffer[4], &ICSP[i], 0x80);         // data (128 bytes)
             buffer[4 + 0x80] = CRC_EOP;
-            serial_write(buffer, 4 + 0x80 + 1);
-            n = serial_read(buffer, 2, 100);
+            serial_write(s, buffer, 4 + 0x80 + 1);
+            n = serial_read(s, buffer, 2, 100);
 
             if ((n != 2) || (buffer[0] != STK_INSYNC) || (buffer[1] != STK_OK)) {
                 fprintf(stderr, "\nFailed to program page\n");
-                serial_close();
-                exit(-1);
+                serial_close(s);
+                session_abort(-1);
             }
         }
         printf("\n");
 
         buffer[0] = STK_LEAVE_PROGMODE;                 // leave program mode
         buffer[1] = CRC_EOP;
-        serial_write(buffer, 2);
-        n = serial_read(buffer, 2, 100);
+        serial_write(s, buffer, 2);
+        n = serial_read(s, buffer, 2, 100);
 
         if ((n != 2) || (buffer[0] != STK_INSYNC) || (buffer[1] != STK_OK)) {
             fprintf(stderr, "Failed to exit program mode\n");
-            serial_close();
-            exit(-1);
+            serial_close(s);
+            session_abort(-1);
         }
         printf("Firmware uploaded to 'ascii ICSP' adapter OK\n");
-        serial_close();
+        serial_close(s);
 #else
         printf("Firmware upload to arduino/STK500 not included\n");
 #endif
-        exit(0);                                       // finished performing function, exit program
+        session_abort(0);                              // finished performing function
     }
 
 //
 // carry on with normal startup
 //
 
+    return bitbang_open(port, baud_rate, 0);
+}
+
+/*
+ * Initialize bitbang adapter with binary framed protocol.
+ * The embedded firmware is ascii only, so no firmware upload here.
+ */
+adapter_t *adapter_open_bitbang2(const char *port, int baud_rate, int alt_baud_rate)
+{
+    printf("       (binary ICSP, based on ascii ICSP by Robert Rozee)\n\n");
+
+    return bitbang_open(port, baud_rate, 1);
+}
+
+/*
+ * Open serial port and find the programmer, ascii or binary.
+ */
+static adapter_t *bitbang_open(const char *port, int baud_rate, int binary)
+{
+    bitbang_adapter_t *a;
+
     a = calloc(1, sizeof(*a));
     if (! a) {
         fprintf(stderr, "Out of memory (in open)\n");
@@ -1155,10 +1585,10 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     }
 
     /* Open serial port */
-    if (serial_open(port, 115200) < 0) {
+    a->port = serial_open(port, 115200);
+    if (! a->port) {
         /* failed to open serial port */
         fprintf(stderr, "Unable to configure serial port %s\n", port);
-        serial_close();
         free(a);
         return 0;
     }
@@ -1174,21 +1604,21 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     unsigned char ch;
     for (i = 0; i < 40; i++) {
         ch = '>';
-        serial_write(&ch, 1);
+        serial_write(a->port, &ch, 1);
         ch = (i < 20 ? '.': ':');
         if (i == 20)
             for (n = 0; n < 20; n++ )
                 printf("\b");
         printf("%c", ch);
         fflush(stdout);
-        n = serial_read(&ch, 1, 250);
+        n = serial_read(a->port, &ch, 1, 250);
         if (n == 1 && ch == '<')
             i = 100;
     }
 
     if (i < 100) {
         fprintf(stderr, "\nNo response from 'ascii ICSP' adapter\n");
-        serial_close();
+        serial_close(a->port);
         free(a);
         return 0;
     }
@@ -1198,14 +1628,15 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     ch = '?';
     unsigned char buffer[15] = "..............\0";
                             // "ascii ICSP v1X"
-    serial_write(&ch, 1);
-    n = serial_read(buffer, 14, 250);
+    serial_write(a->port, &ch, 1);
+    n = serial_read(a->port, buffer, 14, 250);
 
-    if (n == 14 && memcmp(buffer, "ascii ICSP v1", 13) == 0)
+    // binary frames need version 2 of the programmer
+    if (n == 14 && memcmp(buffer, binary ? "ascii ICSP v2" : "ascii ICSP v1", 13) == 0)
         printf(" OK2 - %s\n", buffer);
     else {
         fprintf(stderr, "\nBad response from 'ascii ICSP' adapter\n");
-        serial_close();
+        serial_close(a->port);
         free(a);
         return 0;
     }
@@ -1224,6 +1655,24 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     a->TotalBitsReceived = 0;              // count of total # of TDO bits recieved
     a->MaxBufferedWrites = 0;              // maximum continuous write length (chars)
     a->RunningWriteCount = 0;              // running count of writes, reset by read
+    a->SyncedWriteCount = 0;               // writes up to pending handshake
+
+    //
+    // Size the write window after the Rx buffer of the programmer,
+    // with a margin for raw writes like delays and ICSP entry.
+    //
+    switch (CFG1) {
+    case 1:  a->BufferSize = 64;                        break;
+    case 2:  a->BufferSize = 512;                       break;
+    default: a->BufferSize = bitbang_measure_buffer(a); break;
+    }
+    if (a->BufferSize >= 256)
+        a->WriteWindow = a->BufferSize - 64;
+    else
+        a->WriteWindow = a->BufferSize * 3 / 4;
+    if (debug_level > 0)
+        fprintf(stderr, "programmer Rx buffer %u chars, write window %u chars\n",
+                                               a->BufferSize,   a->WriteWindow);
 
     a->WriteCount = 0;
     a->Read1Count = 0;
@@ -1235,6 +1684,10 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     a->use_executive = 0;
     a->serial_execution_mode = 0;
 
+    // whole-word fastdata codes were added in version 1F
+    a->fastword = (!binary && CFG3 && CFG5 && buffer[13] >= 'F');
+    a->binary = binary;
+
     //
     // It is at this point that we start talking to the target.
     //
@@ -1262,9 +1715,9 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
         bitbang_send(a, 0, 0, 8, MCHP_STATUS, 1);       /* Xfer data. */
         usleep(1000000);                                // allow 1 second for erase to complete
         bitbang_ICSP_enable(a, 0);                      // shut down target
-        serial_close();
+        serial_close(a->port);
         free(a);
-        exit(0);                                        // finished performing function, exit program
+        session_abort(0);                               // finished performing function
     }
 
     /* Reset the JTAG TAP controller: TMS 1-1-1-1-1-0.
@@ -1278,7 +1731,7 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
         if (debug_level > 0 || (idcode != 0 && idcode != 0xffffffff))
             fprintf(stderr, "incompatible CPU detected, IDCODE=%08x\n", idcode);
         bitbang_ICSP_enable(a, 0);                      // shut down target
-        serial_close();
+        serial_close(a->port);
         free(a);
         return 0;
     }
@@ -1305,7 +1758,7 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
 #endif
         fprintf(stderr, "invalid status = %04x (in open)\n", status);       // 5.
         bitbang_ICSP_enable(a, 0);                  // shut down target
-        serial_close();
+        serial_close(a->port);
         free(a);
         return 0;
     }
@@ -1330,8 +1783,12 @@ adapter_t *adapter_open_bitbang(const char *port, int baud_rate)
     a->adapter.read_word = bitbang_read_word;
     a->adapter.read_data = bitbang_read_data;
     a->adapter.verify_data = bitbang_verify_data;
+    a->adapter.get_crc = bitbang_get_crc;
+    a->adapter.blank_check = bitbang_blank_check;
     a->adapter.erase_chip = bitbang_erase_chip;
+    a->adapter.erase_page = bitbang_erase_page;
     a->adapter.program_word = bitbang_program_word;
     a->adapter.program_row = bitbang_program_row;
+    a->adapter.program_cluster = bitbang_program_cluster;
     return &a->adapter;
 }
@@ -84,11 +84,11 @@ static void hidboot_command(hidboot_adapter_t *a, unsigned char cmd,
     a->reply_len = hid_read_timeout(a->hiddev, a->reply, 64, 4000);
     if (a->reply_len == 0) {
         fprintf(stderr, "Timed out.\n");
-        exit(-1);
+        session_abort(-1);
     }
     if (a->reply_len != 64) {
         fprintf(stderr, "hidboot: error %d receiving packet\n", a->reply_len);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 0) {
         fprintf(stderr, "---Recv");
@@ -8,6 +8,9 @@
  *  - Bus Blaster v2 from Dangerous Prototypes
  *  - TinCanTools Flyswatter adapter
  *
+ * With -DMPSSE_SIM, the adapter is built against an emulated
+ * FT2232 with PIC32 target (mpsse-sim.c), instead of libusb.
+ *
  * Copyright (C) 2011-2013 Serge Vakulenko
  *
  * This file is part of PIC32PROG project, which is distributed
@@ -20,7 +23,10 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
-#if defined(__FreeBSD__) || defined(__DragonFly__) || defined(__APPLE__)
+#include <sys/time.h>
+#ifdef MPSSE_SIM
+#   include "mpsse-sim.h"
+#elif defined(__FreeBSD__) || defined(__DragonFly__) || defined(__APPLE__)
 #   include <libusb.h>
 #else
 #   include <libusb-1.0/libusb.h>
@@ -29,6 +35,20 @@
 #include "adapter.h"
 #include "pic32.h"
 
+/*
+ * Size of transmit buffer, and number of transmit buffers
+ * which can be in flight at the same time.
+ */
+#define OUTPUT_SIZE             (256*16)
+#define NOUTBUF                 3
+#define NINBUF                  4
+
+/*
+ * Max size of receive packet (FT2232H high speed).
+ * Every packet starts with two bytes of modem status.
+ */
+#define MAX_PACKET              512
+
 typedef struct {
     uint16_t vid;
     uint16_t pid;
@@ -49,6 +69,28 @@ typedef struct {
     uint16_t icsp_oe_inverted;
 } device_t;
 
+/*
+ * Prepared JTAG packet of MPSSE commands, with zero payload.
+ * Payload bits are patched in when the packet is sent.
+ */
+typedef struct {
+    unsigned char data [24];        /* Commands, max 23 bytes (6+8+3+3+3) */
+    unsigned char nbytes;           /* Length of packet */
+    unsigned char tdi_offset;       /* Offset of whole payload bytes */
+    unsigned char tdi_nbytes;       /* Number of whole payload bytes */
+    unsigned char part_offset;      /* Offset of partial payload byte */
+    unsigned char part_nbits;       /* Bits in partial byte, or 0 */
+    unsigned char last_offset;      /* Offset of last payload bit (TMS=1), or 0 */
+    unsigned char read_flag;
+
+    /* Decoding of the reply. */
+    int bytes_per_word;
+    unsigned long long fix_high_bit;
+    unsigned long long high_byte_mask;
+    unsigned long long high_bit_mask;
+    unsigned high_byte_bits;
+} mpsse_packet_t;
+
 typedef struct {
     /* Common part */
     adapter_t adapter;
@@ -59,18 +101,47 @@ typedef struct {
     libusb_context *context;
 
     /* Transmit buffer for MPSSE packet. */
-    unsigned char output [256*16];
+    unsigned char *output;
     int bytes_to_write;
 
+    /* Asynchronous transfers. Output buffers are used in turn,
+     * so the next packet is prepared while the previous ones
+     * are still clocked out by the adapter. */
+    unsigned char out_buf [NOUTBUF] [OUTPUT_SIZE];
+    struct libusb_transfer *out_xfer [NOUTBUF];
+    int out_busy [NOUTBUF];
+    int out_index;
+
+    /* Receive transfers, one USB packet each. They are submitted
+     * together with the output, and complete in order. */
+    unsigned char in_buf [NINBUF] [MAX_PACKET];
+    struct libusb_transfer *in_xfer [NINBUF];
+    int in_busy [NINBUF];
+    int sync_mode;                  /* Wait for every write to complete */
+
+    /* Statistics. */
+    unsigned stat_writes;
+    unsigned stat_reads;
+    unsigned long long stat_bytes;
+    unsigned long long stat_wait_usec;
+    struct timeval stat_start;
+
     /* Receive buffer. */
-    unsigned char input [256];  /* Increased for ICSP, just in case */
+    unsigned char input [256*8];    /* Enough for a batch of FASTDATA replies */
     int bytes_to_read;
+    int max_packet;                 /* Size of USB packet on receive endpoint */
     int bytes_per_word;
     unsigned long long fix_high_bit;
     unsigned long long high_byte_mask;
     unsigned long long high_bit_mask;
     unsigned high_byte_bits;
 
+    /* Packets of fixed shape, prepared once. */
+    mpsse_packet_t pkt_command;     /* 5-bit IR command */
+    mpsse_packet_t pkt_data;        /* 32-bit DR, no read */
+    mpsse_packet_t pkt_data_read;   /* 32-bit DR with read */
+    mpsse_packet_t pkt_fastdata;    /* 33-bit FASTDATA with read */
+
     /* Mapping of /TRST, /SYSRST and LED control signals. */
     unsigned trst_control, trst_inverted;
     unsigned sysrst_control, sysrst_inverted;
@@ -104,6 +175,24 @@ typedef struct {
 #define IN_EP                   0x02
 #define OUT_EP                  0x81
 
+/*
+ * Number of words sent to FASTDATA register in one USB transfer.
+ * Every word takes 16 bytes of output buffer and 5 bytes of reply.
+ */
+#define FASTDATA_BATCH          128
+
+/*
+ * Max number of words read without PE in one USB transfer.
+ * Every word takes up to 480 bytes of output buffer,
+ * so the actual batch is limited by the buffer size.
+ */
+#define READ_WORDS_BATCH        16
+
+/*
+ * Max number of words requested by one PE_READ command.
+ */
+#define READ_NWORDS             1024
+
 /* Requests */
 #define SIO_RESET               0 /* Reset the port */
 #define SIO_MODEM_CTRL          1 /* Set the modem control register */
@@ -184,7 +273,8 @@ static unsigned calculate_crc(unsigned crc, unsigned char *data, unsigned nbytes
 }
 
 /*
- * Send a packet to USB device.
+ * Send a packet to USB device and wait for completion.
+ * Used only at initialization, before asynchronous transfers start.
  */
 static void bulk_write(mpsse_adapter_t *a, unsigned char *output, int nbytes)
 {
@@ -204,51 +294,191 @@ static void bulk_write(mpsse_adapter_t *a, unsigned char *output, int nbytes)
     if (ret != 0) {
         fprintf(stderr, "usb bulk write failed: %d: %s\n",
             ret, libusb_strerror(ret));
-        exit(-1);
+        session_abort(-1);
     }
     if (bytes_written != nbytes)
         fprintf(stderr, "usb bulk written %d bytes of %d",
             bytes_written, nbytes);
 }
 
+/*
+ * Completion callback for asynchronous transfers.
+ */
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *xfer)
+{
+    int *busy = xfer->user_data;
+
+    *busy = 0;
+}
+
+/*
+ * Process USB events until the transfer is completed.
+ */
+static void wait_transfer(mpsse_adapter_t *a, int *busy)
+{
+    struct timeval t0, t1;
+
+    if (! *busy)
+        return;
+    gettimeofday(&t0, 0);
+    while (*busy) {
+        int ret = libusb_handle_events(a->context);
+        if (ret != 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+            fprintf(stderr, "usb handle events failed: %d: %s\n",
+                ret, libusb_strerror(ret));
+            session_abort(-1);
+        }
+    }
+    gettimeofday(&t1, 0);
+    a->stat_wait_usec += (t1.tv_sec - t0.tv_sec) * 1000000LL +
+        t1.tv_usec - t0.tv_usec;
+}
+
+/*
+ * Wait until the output buffer is sent to device.
+ */
+static void wait_output(mpsse_adapter_t *a, int i)
+{
+    struct libusb_transfer *xfer = a->out_xfer[i];
+
+    if (! a->out_busy[i])
+        return;
+    wait_transfer(a, &a->out_busy[i]);
+    if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        fprintf(stderr, "usb bulk write failed: status %d\n", xfer->status);
+        session_abort(-1);
+    }
+    if (xfer->actual_length != xfer->length)
+        fprintf(stderr, "usb bulk written %d bytes of %d",
+            xfer->actual_length, xfer->length);
+}
+
+/*
+ * Start sending the transmit buffer to device.
+ * Switch to the next transmit buffer, waiting until it is free.
+ */
+static void submit_output(mpsse_adapter_t *a)
+{
+    int i = a->out_index;
+    struct libusb_transfer *xfer = a->out_xfer[i];
+
+    if (debug_level > 1) {
+        int k;
+        fprintf(stderr, "usb bulk write %d bytes:", a->bytes_to_write);
+        for (k=0; k<a->bytes_to_write; k++)
+            fprintf(stderr, "%c%02x", k ? '-' : ' ', a->output[k]);
+        fprintf(stderr, "\n");
+    }
+    libusb_fill_bulk_transfer(xfer, a->usbdev, IN_EP, a->out_buf[i],
+        a->bytes_to_write, transfer_done, &a->out_busy[i], 1000);
+    a->out_busy[i] = 1;
+    int ret = libusb_submit_transfer(xfer);
+    if (ret != 0) {
+        fprintf(stderr, "usb bulk write failed: %d: %s\n",
+            ret, libusb_strerror(ret));
+        session_abort(-1);
+    }
+    a->stat_writes++;
+    a->stat_bytes += a->bytes_to_write;
+    a->bytes_to_write = 0;
+    if (a->sync_mode)
+        wait_output(a, i);
+
+    i = (i + 1) % NOUTBUF;
+    wait_output(a, i);
+    a->out_index = i;
+    a->output = a->out_buf[i];
+}
+
+/*
+ * Start receiving one packet from device.
+ * Never ask for more than one packet, otherwise the status
+ * bytes of the next packet would get mixed with the data.
+ */
+static void submit_input(mpsse_adapter_t *a, int i)
+{
+    libusb_fill_bulk_transfer(a->in_xfer[i], a->usbdev, OUT_EP, a->in_buf[i],
+        a->max_packet, transfer_done, &a->in_busy[i], 2000);
+    a->in_busy[i] = 1;
+    int ret = libusb_submit_transfer(a->in_xfer[i]);
+    if (ret != 0) {
+        fprintf(stderr, "usb bulk read failed: %d: %s\n",
+            ret, libusb_strerror(ret));
+        session_abort(-1);
+    }
+}
+
+/*
+ * Wait until a packet is received.
+ * Return the number of bytes received.
+ */
+static int wait_input(mpsse_adapter_t *a, int i)
+{
+    wait_transfer(a, &a->in_busy[i]);
+    if (a->in_xfer[i]->status != LIBUSB_TRANSFER_COMPLETED) {
+        fprintf(stderr, "usb bulk read failed\n");
+        session_abort(-1);
+    }
+    a->stat_reads++;
+    return a->in_xfer[i]->actual_length;
+}
+
+/*
+ * Wait until all output buffers are sent.
+ */
+static void mpsse_drain_output(mpsse_adapter_t *a)
+{
+    int i;
+
+    for (i=0; i<NOUTBUF; i++)
+        wait_output(a, i);
+}
+
 /*
  * If there are any data in transmit buffer -
  * send them to device.
+ * Replies come in the same order as requests, so when
+ * a read is pending, wait until all the data are received.
+ * Receive transfers are submitted right after the output,
+ * as many as needed for the reply in full packets, so a long
+ * reply does not wait a USB round trip per packet.  More
+ * are submitted when the adapter sends short packets.
  */
 static void mpsse_flush_output(mpsse_adapter_t *a)
 {
-    int bytes_read, n;
-    unsigned char reply [64];
+    int bytes_read, n, head, nin;
+    unsigned char *reply;
     uint64_t icspTemp = 0;
 
     if (a->bytes_to_write <= 0)
         return;
 
-    bulk_write(a, a->output, a->bytes_to_write);
-    a->bytes_to_write = 0;
+    submit_output(a);
     if (a->bytes_to_read <= 0)
         return;
 
     /* Get reply. */
     bytes_read = 0;
+    head = 0;
+    nin = 0;
     while (bytes_read < a->bytes_to_read) {
-        int ret = libusb_bulk_transfer(a->usbdev, OUT_EP, (unsigned char*) reply,
-            a->bytes_to_read - bytes_read + 2, &n, 2000);
-        if (ret != 0) {
-            fprintf(stderr, "usb bulk read failed\n");
-            exit(-1);
+        /* Never submit more packets than the rest of reply
+         * can take, or the next reply would be caught. */
+        while (nin < NINBUF && (nin == 0 || ! a->sync_mode) &&
+            nin * (a->max_packet - 2) < a->bytes_to_read - bytes_read) {
+            submit_input(a, (head + nin) % NINBUF);
+            nin++;
         }
+        n = wait_input(a, head);
+        reply = a->in_buf[head];
+        head = (head + 1) % NINBUF;
+        nin--;
         if (debug_level > 1) {
-            if (n != a->bytes_to_read + 2)
-                fprintf(stderr, "usb bulk read %d bytes of %d\n",
-                    n, a->bytes_to_read - bytes_read + 2);
-            else {
-                int i;
-                fprintf(stderr, "usb bulk read %d bytes:", n);
-                for (i=0; i<n; i++)
-                    fprintf(stderr, "%c%02x", i ? '-' : ' ', reply[i]);
-                fprintf(stderr, "\n");
-            }
+            int i;
+            fprintf(stderr, "usb bulk read %d bytes:", n);
+            for (i=0; i<n; i++)
+                fprintf(stderr, "%c%02x", i ? '-' : ' ', reply[i]);
+            fprintf(stderr, "\n");
         }
         if (n > 2) {
             if (INTERFACE_JTAG == a->interface || INTERFACE_DEFAULT == a->interface)
@@ -335,6 +565,165 @@ static void mpsse_setPins(mpsse_adapter_t *a, int sysrst, int led,
                         sysrst, led, icsp, icsp_oe, output, direction);
 }
 
+/*
+ * Prepare a JTAG packet of MPSSE commands.
+ */
+static void mpsse_build_packet(mpsse_packet_t *p,
+    unsigned tms_prolog_nbits, unsigned tms_prolog, unsigned tdi_nbits,
+    unsigned tms_epilog_nbits, unsigned tms_epilog, int read_flag)
+{
+    unsigned char *out = p->data;
+    unsigned n = 0;
+
+    memset(p, 0, sizeof(*p));
+    if (tms_prolog_nbits > 0) {
+        /* Prologue TMS, from 1 to 14 bits.
+         * 4b - Clock Data to TMS Pin (no Read) */
+        out [n++] = WTMS + BITMODE + CLKWNEG + LSB;
+        if (tms_prolog_nbits < 8) {
+            out [n++] = tms_prolog_nbits - 1;
+            out [n++] = tms_prolog;
+        } else {
+            out [n++] = 7 - 1;
+            out [n++] = tms_prolog & 0x7f;
+            out [n++] = WTMS + BITMODE + CLKWNEG + LSB;
+            out [n++] = tms_prolog_nbits - 7 - 1;
+            out [n++] = tms_prolog >> 7;
+        }
+    }
+    if (tdi_nbits > 0) {
+        /* Data, from 1 to 64 bits. */
+        if (tms_epilog_nbits > 0) {
+            /* Last bit should be accompanied with signal TMS=1. */
+            tdi_nbits--;
+        }
+        unsigned nbytes = tdi_nbits / 8;
+        unsigned last_byte_bits = tdi_nbits & 7;
+        if (read_flag) {
+            p->read_flag = 1;
+            p->high_byte_bits = last_byte_bits;
+            p->bytes_per_word = nbytes;
+            if (p->high_byte_bits > 0)
+                p->bytes_per_word++;
+        }
+        if (nbytes > 0) {
+            /* Whole bytes.
+             * 39 - Clock Data Bytes In and Out LSB First
+             * 19 - Clock Data Bytes Out LSB First (no Read) */
+            out [n++] = read_flag ?
+                (WTDI + RTDO + CLKWNEG + LSB) :
+                (WTDI + CLKWNEG + LSB);
+            out [n++] = nbytes - 1;
+            out [n++] = (nbytes - 1) >> 8;
+            p->tdi_offset = n;
+            p->tdi_nbytes = nbytes;
+            n += nbytes;
+        }
+        if (last_byte_bits) {
+            /* Last partial byte.
+             * 3b - Clock Data Bits In and Out LSB First
+             * 1b - Clock Data Bits Out LSB First (no Read) */
+            out [n++] = read_flag ?
+                (WTDI + RTDO + BITMODE + CLKWNEG + LSB) :
+                (WTDI + BITMODE + CLKWNEG + LSB);
+            out [n++] = last_byte_bits - 1;
+            p->part_offset = n++;
+            p->part_nbits = last_byte_bits;
+            p->high_byte_mask = 0xffULL << (p->bytes_per_word - 1) * 8;
+        }
+        if (tms_epilog_nbits > 0) {
+            /* Last bit (actually two bits).
+             * 6b - Clock Data to TMS Pin with Read
+             * 4b - Clock Data to TMS Pin (no Read) */
+            tdi_nbits++;
+            out [n++] = read_flag ?
+                (WTMS + RTDO + BITMODE + CLKWNEG + LSB) :
+                (WTMS + BITMODE + CLKWNEG + LSB);
+            out [n++] = 1;
+            p->last_offset = n;
+            out [n++] = 1 | tms_epilog << 1;
+            tms_epilog_nbits--;
+            tms_epilog >>= 1;
+            if (read_flag) {
+                /* Last bit wil come in next byte.
+                 * Compute a mask for correction. */
+                p->fix_high_bit = 0x40ULL << (p->bytes_per_word * 8);
+                p->bytes_per_word++;
+            }
+        }
+        if (read_flag)
+            p->high_bit_mask = 1ULL << (tdi_nbits - 1);
+    }
+    if (tms_epilog_nbits > 0) {
+        /* Epiloque TMS, from 1 to 7 bits.
+         * 4b - Clock Data to TMS Pin (no Read) */
+        out [n++] = WTMS + BITMODE + CLKWNEG + LSB;
+        out [n++] = tms_epilog_nbits - 1;
+        out [n++] = tms_epilog;
+    }
+    p->nbytes = n;
+}
+
+/*
+ * Append a prepared JTAG packet to the output buffer,
+ * with payload bits patched in.
+ */
+static void mpsse_send_packet(mpsse_adapter_t *a,
+    const mpsse_packet_t *p, unsigned long long tdi)
+{
+    unsigned char *out;
+    unsigned i;
+
+    /* Check that we have enough space in output buffer.
+     * The whole template is copied, to let the compiler
+     * use a fixed-size copy. */
+    if (a->bytes_to_write > OUTPUT_SIZE - (int) sizeof(p->data))
+        mpsse_flush_output(a);
+
+    out = a->output + a->bytes_to_write;
+    memcpy(out, p->data, sizeof(p->data));
+    a->bytes_to_write += p->nbytes;
+
+    for (i=0; i<p->tdi_nbytes; i++) {
+        out [p->tdi_offset + i] = tdi;
+        tdi >>= 8;
+    }
+    if (p->part_nbits) {
+        out [p->part_offset] = tdi;
+        tdi >>= p->part_nbits;
+    }
+    if (p->last_offset)
+        out [p->last_offset] |= tdi << 7;
+
+    if (p->read_flag) {
+        a->bytes_per_word = p->bytes_per_word;
+        a->fix_high_bit = p->fix_high_bit;
+        a->high_byte_mask = p->high_byte_mask;
+        a->high_bit_mask = p->high_bit_mask;
+        a->high_byte_bits = p->high_byte_bits;
+        a->bytes_to_read += p->bytes_per_word;
+    }
+}
+
+/*
+ * Prepare packets of fixed shape, used for most of JTAG transfers.
+ */
+static void mpsse_init_packets(mpsse_adapter_t *a)
+{
+    mpsse_build_packet(&a->pkt_command,
+        TMS_HEADER_COMMAND_NBITS, TMS_HEADER_COMMAND_VAL, ETAP_COMMAND_NBITS,
+        TMS_FOOTER_COMMAND_NBITS, TMS_FOOTER_COMMAND_VAL, 0);
+    mpsse_build_packet(&a->pkt_data,
+        TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL, 32,
+        TMS_FOOTER_XFERDATA_NBITS, TMS_FOOTER_XFERDATA_VAL, 0);
+    mpsse_build_packet(&a->pkt_data_read,
+        TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL, 32,
+        TMS_FOOTER_XFERDATA_NBITS, TMS_FOOTER_XFERDATA_VAL, 1);
+    mpsse_build_packet(&a->pkt_fastdata,
+        TMS_HEADER_XFERDATAFAST_NBITS, TMS_HEADER_XFERDATAFAST_VAL, 33,
+        TMS_FOOTER_XFERDATAFAST_NBITS, TMS_FOOTER_XFERDATAFAST_VAL, 1);
+}
+
 static void mpsse_send(mpsse_adapter_t *a,
     unsigned tms_prolog_nbits, unsigned tms_prolog,
     unsigned tdi_nbits, unsigned long long tdi,
@@ -343,100 +732,11 @@ static void mpsse_send(mpsse_adapter_t *a,
 
     if (INTERFACE_JTAG == a->interface || INTERFACE_DEFAULT == a->interface)
     {
-        /* Check that we have enough space in output buffer.
-         * Max size of one packet is 23 bytes (6+8+3+3+3). */
-        if (a->bytes_to_write > sizeof(a->output) - 23)
-            mpsse_flush_output(a);
+        mpsse_packet_t packet;
 
-        /* Prepare a packet of MPSSE commands. */
-        if (tms_prolog_nbits > 0) {
-            /* Prologue TMS, from 1 to 14 bits.
-             * 4b - Clock Data to TMS Pin (no Read) */
-            a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
-            if (tms_prolog_nbits < 8) {
-                a->output [a->bytes_to_write++] = tms_prolog_nbits - 1;
-                a->output [a->bytes_to_write++] = tms_prolog;
-            } else {
-                a->output [a->bytes_to_write++] = 7 - 1;
-                a->output [a->bytes_to_write++] = tms_prolog & 0x7f;
-                a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
-                a->output [a->bytes_to_write++] = tms_prolog_nbits - 7 - 1;
-                a->output [a->bytes_to_write++] = tms_prolog >> 7;
-            }
-        }
-        if (tdi_nbits > 0) {
-            /* Data, from 1 to 64 bits. */
-            if (tms_epilog_nbits > 0) {
-                /* Last bit should be accompanied with signal TMS=1. */
-                tdi_nbits--;
-            }
-            unsigned nbytes = tdi_nbits / 8;
-            unsigned last_byte_bits = tdi_nbits & 7;
-            if (read_flag) {
-                a->high_byte_bits = last_byte_bits;
-                a->fix_high_bit = 0;
-                a->high_byte_mask = 0;
-                a->bytes_per_word = nbytes;
-                if (a->high_byte_bits > 0)
-                    a->bytes_per_word++;
-                a->bytes_to_read += a->bytes_per_word;
-            }
-            if (nbytes > 0) {
-                /* Whole bytes.
-                 * 39 - Clock Data Bytes In and Out LSB First
-                 * 19 - Clock Data Bytes Out LSB First (no Read) */
-                a->output [a->bytes_to_write++] = read_flag ?
-                    (WTDI + RTDO + CLKWNEG + LSB) :
-                    (WTDI + CLKWNEG + LSB);
-                a->output [a->bytes_to_write++] = nbytes - 1;
-                a->output [a->bytes_to_write++] = (nbytes - 1) >> 8;
-                while (nbytes-- > 0) {
-                    a->output [a->bytes_to_write++] = tdi;
-                    tdi >>= 8;
-                }
-            }
-            if (last_byte_bits) {
-                /* Last partial byte.
-                 * 3b - Clock Data Bits In and Out LSB First
-                 * 1b - Clock Data Bits Out LSB First (no Read) */
-                a->output [a->bytes_to_write++] = read_flag ?
-                    (WTDI + RTDO + BITMODE + CLKWNEG + LSB) :
-                    (WTDI + BITMODE + CLKWNEG + LSB);
-                a->output [a->bytes_to_write++] = last_byte_bits - 1;
-                a->output [a->bytes_to_write++] = tdi;
-                tdi >>= last_byte_bits;
-                a->high_byte_mask = 0xffULL << (a->bytes_per_word - 1) * 8;
-            }
-            if (tms_epilog_nbits > 0) {
-                /* Last bit (actually two bits).
-                 * 6b - Clock Data to TMS Pin with Read
-                 * 4b - Clock Data to TMS Pin (no Read) */
-                tdi_nbits++;
-                a->output [a->bytes_to_write++] = read_flag ?
-                    (WTMS + RTDO + BITMODE + CLKWNEG + LSB) :
-                    (WTMS + BITMODE + CLKWNEG + LSB);
-                a->output [a->bytes_to_write++] = 1;
-                a->output [a->bytes_to_write++] = tdi << 7 | 1 | tms_epilog << 1;
-                tms_epilog_nbits--;
-                tms_epilog >>= 1;
-                if (read_flag) {
-                    /* Last bit wil come in next byte.
-                     * Compute a mask for correction. */
-                    a->fix_high_bit = 0x40ULL << (a->bytes_per_word * 8);
-                    a->bytes_per_word++;
-                    a->bytes_to_read++;
-                }
-            }
-            if (read_flag)
-                a->high_bit_mask = 1ULL << (tdi_nbits - 1);
-        }
-        if (tms_epilog_nbits > 0) {
-            /* Epiloque TMS, from 1 to 7 bits.
-             * 4b - Clock Data to TMS Pin (no Read) */
-            a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
-            a->output [a->bytes_to_write++] = tms_epilog_nbits - 1;
-            a->output [a->bytes_to_write++] = tms_epilog;
-        }
+        mpsse_build_packet(&packet, tms_prolog_nbits, tms_prolog,
+            tdi_nbits, tms_epilog_nbits, tms_epilog, read_flag);
+        mpsse_send_packet(a, &packet, tdi);
     }
     else{
         /* Else ICSP */
@@ -559,6 +859,28 @@ static unsigned long long mpsse_fix_data(mpsse_adapter_t *a, unsigned long long
     return word;
 }
 
+/*
+ * Decode a reply of 32-bit DR packet: three whole bytes,
+ * seven bits of the high byte, and the last bit in the next byte.
+ */
+static inline unsigned mpsse_fix_data32(unsigned long long word)
+{
+    unsigned data = (word & 0xffffff) | ((word >> 1) & 0x7f000000);
+
+    if (word & (0x40ULL << 32))
+        data |= 0x80000000;
+    return data;
+}
+
+/*
+ * Decode a reply of 33-bit FASTDATA packet: four whole bytes,
+ * and the last bit in the next byte.
+ */
+static inline unsigned long long mpsse_fix_fastdata(unsigned long long word)
+{
+    return (word & 0xffffffffULL) | ((word >> 6) & 0x100000000ULL);
+}
+
 static unsigned long long mpsse_recv(mpsse_adapter_t *a)
 {
     unsigned long long word;
@@ -608,7 +930,7 @@ static void mpsse_setMode(mpsse_adapter_t *a, uint32_t mode, uint32_t immediate)
     }
     else{
         fprintf(stderr, "mpsse_setMode called with invalid mode, quitting\n");
-        exit(-1);
+        session_abort(-1);
     }
     if (immediate){
         mpsse_flush_output(a);
@@ -623,10 +945,14 @@ static void mpsse_sendCommand(mpsse_adapter_t *a, uint32_t command, uint32_t imm
         && ETAP_CONTROL != command && ETAP_EJTAGBOOT != command // ETAP commands
         && ETAP_FASTDATA != command && ETAP_NORMALBOOT != command){ // ETAP commands
         fprintf(stderr, "mpsse_sendCommand called with invalid command 0x%02x, quitting\n", command);
-        exit(-1);   // TODO make exit procedure
+        session_abort(-1);
     }
 
-    if (MTAP_COMMAND != command && TAP_SW_MTAP != command
+    if (INTERFACE_JTAG == a->interface || INTERFACE_DEFAULT == a->interface) {
+        /* Both MTAP and ETAP commands are 5 bits long. */
+        mpsse_send_packet(a, &a->pkt_command, command);
+    }
+    else if (MTAP_COMMAND != command && TAP_SW_MTAP != command
         && TAP_SW_ETAP != command && MTAP_IDCODE != command){   // MTAP commands
         mpsse_send(a, TMS_HEADER_COMMAND_NBITS, TMS_HEADER_COMMAND_VAL,
                     MTAP_COMMAND_NBITS, command,
@@ -650,10 +976,15 @@ static void mpsse_sendCommand(mpsse_adapter_t *a, uint32_t command, uint32_t imm
 
 static uint64_t mpsse_xferData(mpsse_adapter_t *a, uint32_t nBits,
                 uint32_t iData, uint32_t readFlag, uint32_t immediate){
-    mpsse_send(a, TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL,
+    if (nBits == 32 &&
+        (INTERFACE_JTAG == a->interface || INTERFACE_DEFAULT == a->interface)) {
+        mpsse_send_packet(a, readFlag ? &a->pkt_data_read : &a->pkt_data, iData);
+    } else {
+        mpsse_send(a, TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL,
                     nBits, iData,
                     TMS_FOOTER_XFERDATA_NBITS, TMS_FOOTER_XFERDATA_VAL,
                     readFlag);
+    }
     if (readFlag){
         /* Flushes the output data, and returns the data */
         return mpsse_recv(a);
@@ -664,14 +995,28 @@ static uint64_t mpsse_xferData(mpsse_adapter_t *a, uint32_t nBits,
     return 0;
 }
 
-static uint64_t mpsse_xferFastData(mpsse_adapter_t *a, unsigned word, uint32_t readFlag, uint32_t immediate)
+/*
+ * Scan a word through FASTDATA register.
+ * Return the received value, with PrAcc in bit 0.
+ */
+static uint64_t mpsse_scanFastData(mpsse_adapter_t *a, unsigned word)
 {
-    uint64_t temp;
-    mpsse_send(a, TMS_HEADER_XFERDATAFAST_NBITS, TMS_HEADER_XFERDATAFAST_VAL,
+    if (INTERFACE_JTAG == a->interface || INTERFACE_DEFAULT == a->interface) {
+        mpsse_send_packet(a, &a->pkt_fastdata, (unsigned long long) word << 1);
+    } else {
+        mpsse_send(a, TMS_HEADER_XFERDATAFAST_NBITS, TMS_HEADER_XFERDATAFAST_VAL,
                     33, (unsigned long long) word << 1,
                     TMS_FOOTER_XFERDATAFAST_NBITS, TMS_FOOTER_XFERDATAFAST_VAL,
                     1);
-    temp = mpsse_recv(a);
+    }
+    return mpsse_recv(a);
+}
+
+static uint64_t mpsse_xferFastData(mpsse_adapter_t *a, unsigned word, uint32_t readFlag, uint32_t immediate)
+{
+    uint64_t temp;
+
+    temp = mpsse_scanFastData(a, word);
     if (!(temp & 0x01)){
         fprintf(stderr, "Warning: PrACC not set in xferFastData\n");
     }
@@ -681,6 +1026,81 @@ static uint64_t mpsse_xferFastData(mpsse_adapter_t *a, unsigned word, uint32_t r
     return 0;
 }
 
+/*
+ * Send a block of words to FASTDATA register.
+ * The words are queued in the output buffer and sent in batches,
+ * without waiting for a USB reply per word.
+ * PrAcc bits of the whole batch are checked when the reply comes back.
+ * A word with PrAcc not set was not taken by the processor.  When no
+ * later word of the batch was taken either, this word is resent alone
+ * until it is taken, and the block continues from the next word.
+ * Return the index of the first word, which could not be delivered
+ * in order, or -1 on success.
+ */
+static int mpsse_xferFastDataBlock(mpsse_adapter_t *a,
+    const unsigned *data, unsigned nwords)
+{
+    unsigned long long word;
+    unsigned done, n, i, k, retry;
+
+    if (INTERFACE_ICSP == a->interface) {
+        /* ICSP mode sends every word in a separate packet anyway. */
+        for (i=0; i<nwords; i++) {
+            if (! (mpsse_xferFastData(a, data[i], 1, 0) & 1))
+                return i;
+        }
+        return -1;
+    }
+
+    /* Replies are collected from the beginning of input buffer. */
+    mpsse_flush_output(a);
+
+    for (done=0; done<nwords; done+=n) {
+        n = nwords - done;
+        if (n > FASTDATA_BATCH)
+            n = FASTDATA_BATCH;
+
+        for (i=0; i<n; i++) {
+            mpsse_send_packet(a, &a->pkt_fastdata,
+                (unsigned long long) data[done+i] << 1);
+        }
+        mpsse_flush_output(a);
+
+        /* Check PrAcc bits of all words. */
+        for (i=0; i<n; i++) {
+            memcpy(&word, a->input + i * a->pkt_fastdata.bytes_per_word, sizeof(word));
+            if (! (mpsse_fix_fastdata(word) & 1))
+                break;
+        }
+        if (i >= n)
+            continue;
+
+        /* Words after the missed one must be missed too. */
+        for (k=i+1; k<n; k++) {
+            memcpy(&word, a->input + k * a->pkt_fastdata.bytes_per_word, sizeof(word));
+            if (mpsse_fix_fastdata(word) & 1)
+                return done + i;
+        }
+        if (debug_level > 0)
+            fprintf(stderr, "%s: PrAcc not set at word %u, resend\n",
+                a->name, done + i);
+
+        /* Processor is busy: resend the word until it is taken. */
+        for (retry=0; ; retry++) {
+            if (retry >= 1000)
+                return done + i;
+            mpsse_send_packet(a, &a->pkt_fastdata,
+                (unsigned long long) data[done+i] << 1);
+            mpsse_flush_output(a);
+            memcpy(&word, a->input, sizeof(word));
+            if (mpsse_fix_fastdata(word) & 1)
+                break;
+        }
+        n = i + 1;
+    }
+    return -1;
+}
+
 static void mpsse_xferInstruction(mpsse_adapter_t *a, unsigned instruction)
 {
     unsigned ctl;
@@ -704,7 +1124,7 @@ static void mpsse_xferInstruction(mpsse_adapter_t *a, unsigned instruction)
             maxCounter++;
             if (maxCounter > 40){
                 fprintf(stderr, "Processor still not ready. Quitting\n");
-                exit(-1);   // TODO exit procedure
+                session_abort(-1);
             }
             mdelay(1000);
         }
@@ -723,6 +1143,87 @@ static void mpsse_xferInstruction(mpsse_adapter_t *a, unsigned instruction)
     mpsse_xferData(a, 32, (CONTROL_PROBEN | CONTROL_PROBTRAP), 0, 1);   // Send data, no readback, immediate
 }
 
+/*
+ * Queue an instruction for execution in serial execution mode,
+ * without waiting for processor access.
+ * Control register is read back, to be checked later.
+ */
+static void mpsse_queue_instruction(mpsse_adapter_t *a, unsigned instruction)
+{
+    mpsse_send_packet(a, &a->pkt_command, ETAP_CONTROL);
+    mpsse_send_packet(a, &a->pkt_data_read,
+        CONTROL_PRACC | CONTROL_PROBEN | CONTROL_PROBTRAP | CONTROL_EJTAGBRK);
+    mpsse_send_packet(a, &a->pkt_command, ETAP_DATA);
+    mpsse_send_packet(a, &a->pkt_data, instruction);
+    mpsse_send_packet(a, &a->pkt_command, ETAP_CONTROL);
+    mpsse_send_packet(a, &a->pkt_data, CONTROL_PROBEN | CONTROL_PROBTRAP);
+}
+
+/*
+ * Check a control register value, read back by a queued instruction.
+ * For MK family, PrAcc is not reliable, like in mpsse_xferInstruction().
+ */
+static int mpsse_ctl_ready(mpsse_adapter_t *a, unsigned ctl)
+{
+    if (! (ctl & CONTROL_PROBEN))
+        return 0;
+    if (FAMILY_MK != a->adapter.family_name_short && ! (ctl & CONTROL_PRACC))
+        return 0;
+    return 1;
+}
+
+/*
+ * Execute a sequence of instructions in serial execution mode.
+ * Instructions are queued without waiting for processor access,
+ * a batch per USB transfer, and the control replies are checked
+ * once per batch.  When any check fails, the whole sequence is
+ * executed again in slow mode, so it must be safe to restart.
+ */
+static void mpsse_xferInstructionBlock(mpsse_adapter_t *a,
+    const unsigned *code, unsigned ninst)
+{
+    unsigned long long word;
+    unsigned insn_bytes, batch, done, n, i, ctl = 0;
+
+    if (INTERFACE_ICSP != a->interface) {
+        insn_bytes = 3 * a->pkt_command.nbytes + a->pkt_data_read.nbytes +
+            2 * a->pkt_data.nbytes;
+        batch = (OUTPUT_SIZE - sizeof(a->pkt_command.data)) / insn_bytes;
+
+        /* Replies are collected from the beginning of input buffer. */
+        mpsse_flush_output(a);
+
+        for (done=0; done<ninst; done+=n) {
+            n = ninst - done;
+            if (n > batch)
+                n = batch;
+
+            for (i=0; i<n; i++)
+                mpsse_queue_instruction(a, code[done+i]);
+            mpsse_flush_output(a);
+
+            for (i=0; i<n; i++) {
+                memcpy(&word, a->input + i * a->pkt_data_read.bytes_per_word, sizeof(word));
+                ctl = mpsse_fix_data32(word);
+                if (! mpsse_ctl_ready(a, ctl))
+                    break;
+            }
+            if (i < n)
+                break;
+        }
+        if (done >= ninst)
+            return;
+
+        if (debug_level > 0)
+            fprintf(stderr, "%s: instruction %u not accepted, ctl = %08x, retry in slow mode\n",
+                a->name, done + i, ctl);
+    }
+
+    /* ICSP mode sends every scan in a separate packet anyway. */
+    for (i=0; i<ninst; i++)
+        mpsse_xferInstruction(a, code[i]);
+}
+
 static void mpsse_speed(mpsse_adapter_t *a, int khz)
 {
     unsigned char output [3];
@@ -757,6 +1258,54 @@ static void mpsse_speed(mpsse_adapter_t *a, int khz)
     }
 }
 
+/*
+ * Allocate asynchronous transfers.
+ */
+static int mpsse_alloc_transfers(mpsse_adapter_t *a)
+{
+    int i;
+
+    for (i=0; i<NOUTBUF; i++) {
+        a->out_xfer[i] = libusb_alloc_transfer(0);
+        if (! a->out_xfer[i])
+            return 0;
+    }
+    for (i=0; i<NINBUF; i++) {
+        a->in_xfer[i] = libusb_alloc_transfer(0);
+        if (! a->in_xfer[i])
+            return 0;
+    }
+    a->out_index = 0;
+    a->output = a->out_buf[0];
+
+    /* Set PIC32PROG_MPSSE_SYNC=1 to wait for every USB write,
+     * to compare the speed with overlapped transfers. */
+    const char *env = getenv("PIC32PROG_MPSSE_SYNC");
+    a->sync_mode = (env != 0 && *env == '1');
+    gettimeofday(&a->stat_start, 0);
+    return 1;
+}
+
+/*
+ * Wait for pending transfers and free them.
+ */
+static void mpsse_free_transfers(mpsse_adapter_t *a)
+{
+    int i;
+
+    mpsse_drain_output(a);
+    for (i=0; i<NOUTBUF; i++) {
+        if (a->out_xfer[i])
+            libusb_free_transfer(a->out_xfer[i]);
+        a->out_xfer[i] = 0;
+    }
+    for (i=0; i<NINBUF; i++) {
+        if (a->in_xfer[i])
+            libusb_free_transfer(a->in_xfer[i]);
+        a->in_xfer[i] = 0;
+    }
+}
+
 static void mpsse_close(adapter_t *adapter, int power_on)
 {
     mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
@@ -769,7 +1318,22 @@ static void mpsse_close(adapter_t *adapter, int power_on)
     mpsse_setPins(a, 1, 1, 0, 0, 1); // Reset, LED, no ICSP, no ICSP_OE, immediate
     mdelay(100);    /* Hold in reset for a bit, so it auto-runs afterwards */
     mpsse_setPins(a, 0, 0, 0, 0, 1); // No Reset, no LED, no ICSP, no ICSP_OE, immediate
-
+    mpsse_drain_output(a);
+
+    if (debug_level > 0) {
+        struct timeval t1;
+        unsigned long long usec;
+
+        gettimeofday(&t1, 0);
+        usec = (t1.tv_sec - a->stat_start.tv_sec) * 1000000LL +
+            t1.tv_usec - a->stat_start.tv_usec;
+        fprintf(stderr, "%s: %u USB writes, %llu bytes, %u reads\n",
+            a->name, a->stat_writes, a->stat_bytes, a->stat_reads);
+        fprintf(stderr, "%s: waited for USB %.3f of %.3f seconds (%s mode)\n",
+            a->name, a->stat_wait_usec / 1000000.0, usec / 1000000.0,
+            a->sync_mode ? "sync" : "async");
+    }
+    mpsse_free_transfers(a);
     libusb_release_interface(a->usbdev, 0);
     libusb_close(a->usbdev);
     free(a);
@@ -856,7 +1420,7 @@ static void serial_execution(mpsse_adapter_t *a)
     uint64_t status = mpsse_xferData(a, MTAP_COMMAND_DR_NBITS, MCHP_STATUS, 1, 1);
     if(!(status & MCHP_STATUS_CPS)){
         fprintf(stderr, "CPS bit is SET, please erase MCU first. Status: 0x%08x\n", (uint32_t)status);
-        exit(-1);
+        session_abort(-1);
     }
 
     do{
@@ -939,7 +1503,7 @@ static void serial_execution(mpsse_adapter_t *a)
                 }
                 else{
                     fprintf(stderr, "In JTAG mode, only recovery is through a power-cycle, or reset via ICSP. Quitting.\n");
-                    exit(-1);
+                    session_abort(-1);
                 }
 
 				// Reset will be asserted in the beginning of the loop again.
@@ -991,16 +1555,155 @@ static unsigned get_pe_response(mpsse_adapter_t *a)
 }
 
 /*
- * Read a word from memory (without PE).
+ * Poll the control register for a pending processor access,
+ * without completing it.
  */
-static unsigned mpsse_read_word(adapter_t *adapter, unsigned addr)
+static unsigned mpsse_poll_pracc(mpsse_adapter_t *a)
 {
-    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
-    unsigned addr_lo = addr & 0xFFFF;
-    unsigned addr_hi = (addr >> 16) & 0xFFFF;
-    unsigned word = 0;
+    unsigned long long word;
 
-    /* Workaround for PIC32MM. If not in serial execution mode yet,
+    mpsse_send_packet(a, &a->pkt_command, ETAP_CONTROL);
+    mpsse_send_packet(a, &a->pkt_data_read,
+        CONTROL_PRACC | CONTROL_PROBEN | CONTROL_PROBTRAP | CONTROL_EJTAGBRK);
+    mpsse_flush_output(a);
+
+    memcpy(&word, a->input, sizeof(word));
+    return mpsse_fix_data32(word);
+}
+
+/*
+ * Read the address of the pending processor access.
+ */
+static unsigned mpsse_pracc_address(mpsse_adapter_t *a)
+{
+    unsigned long long word;
+
+    mpsse_send_packet(a, &a->pkt_command, ETAP_ADDRESS);
+    mpsse_send_packet(a, &a->pkt_data_read, 0);
+    mpsse_flush_output(a);
+
+    memcpy(&word, a->input, sizeof(word));
+    return mpsse_fix_data32(word);
+}
+
+/*
+ * Get a series of PE responses through the control register.
+ * PrAcc may be cleared only when it was seen set, otherwise
+ * a word, stored by PE in between, would be lost.  So when the
+ * access is pending, the data read, the access completion and
+ * the poll for the next word go in one USB transfer.  When the
+ * poll finds no access yet, wait for it with get_pe_response().
+ */
+static void get_pe_responses_slow(mpsse_adapter_t *a,
+    unsigned *data, unsigned nwords, unsigned ctl)
+{
+    unsigned long long word;
+
+    while (nwords > 0) {
+        if (! (ctl & CONTROL_PRACC)) {
+            /* PE is not ready yet. */
+            *data++ = get_pe_response(a);
+            nwords--;
+            if (nwords > 0)
+                ctl = mpsse_poll_pracc(a);
+            continue;
+        }
+
+        mpsse_send_packet(a, &a->pkt_command, ETAP_DATA);
+        mpsse_send_packet(a, &a->pkt_data_read, 0);
+        mpsse_send_packet(a, &a->pkt_command, ETAP_CONTROL);
+        mpsse_send_packet(a, &a->pkt_data, CONTROL_PROBEN | CONTROL_PROBTRAP);
+        if (nwords > 1)
+            mpsse_send_packet(a, &a->pkt_data_read,
+                CONTROL_PRACC | CONTROL_PROBEN | CONTROL_PROBTRAP | CONTROL_EJTAGBRK);
+        mpsse_flush_output(a);
+
+        memcpy(&word, a->input, sizeof(word));
+        *data++ = mpsse_fix_data32(word);
+        nwords--;
+        if (nwords > 0) {
+            memcpy(&word, a->input + a->pkt_data_read.bytes_per_word, sizeof(word));
+            ctl = mpsse_fix_data32(word);
+        }
+    }
+}
+
+/*
+ * Get a series of PE responses, a batch of FASTDATA scans
+ * per USB transfer.  PE stores the responses to FASTDATA area,
+ * and a FASTDATA scan completes such a store only when it is
+ * pending, with PrAcc returned in bit 0.  So the words with
+ * PrAcc clear were not taken, and come in the next scans.
+ * Scans never outnumber the words still expected: an extra one
+ * would complete the load of next command by PE.
+ * When the store goes elsewhere, use the control register.
+ */
+static void get_pe_responses(mpsse_adapter_t *a, unsigned *data, unsigned nwords)
+{
+    unsigned long long word;
+    unsigned ctl, n, i, idle_scans;
+
+    if (INTERFACE_ICSP == a->interface) {
+        /* ICSP mode sends every scan in a separate packet anyway. */
+        while (nwords-- > 0)
+            *data++ = get_pe_response(a);
+        return;
+    }
+
+    /* Replies are collected from the beginning of input buffer. */
+    mpsse_flush_output(a);
+
+    /* Wait for the first response, and find where it goes. */
+    do {
+        ctl = mpsse_poll_pracc(a);
+    } while (! (ctl & CONTROL_PRACC));
+    if (! (ctl & CONTROL_PRNW) ||
+        (mpsse_pracc_address(a) & ~0xf) != 0xff200000) {
+        get_pe_responses_slow(a, data, nwords, ctl);
+        return;
+    }
+
+    mpsse_sendCommand(a, ETAP_FASTDATA, 1);
+    for (idle_scans=0; nwords > 0; ) {
+        n = nwords;
+        if (n > FASTDATA_BATCH)
+            n = FASTDATA_BATCH;
+
+        for (i=0; i<n; i++)
+            mpsse_send_packet(a, &a->pkt_fastdata, 0);
+        mpsse_flush_output(a);
+
+        for (i=0; i<n; i++) {
+            memcpy(&word, a->input + i * a->pkt_fastdata.bytes_per_word, sizeof(word));
+            word = mpsse_fix_fastdata(word);
+            if (! (word & 1)) {
+                /* PE is not ready yet. */
+                idle_scans++;
+                continue;
+            }
+            *data++ = word >> 1;
+            nwords--;
+            idle_scans = 0;
+        }
+        if (idle_scans >= 100000) {
+            fprintf(stderr, "%s: PE stopped responding, %u words left\n",
+                a->name, nwords);
+            session_abort(-1);
+        }
+    }
+}
+
+/*
+ * Read a word from memory (without PE).
+ */
+static unsigned mpsse_read_word(adapter_t *adapter, unsigned addr)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+    unsigned addr_lo = addr & 0xFFFF;
+    unsigned addr_hi = (addr >> 16) & 0xFFFF;
+    unsigned word = 0;
+
+    /* Workaround for PIC32MM. If not in serial execution mode yet,
      * read word twice after enering serial execution,
      * as first word will be garbage. */
     unsigned times = (a->serial_execution_mode)?0:1;
@@ -1052,6 +1755,110 @@ static unsigned mpsse_read_word(adapter_t *adapter, unsigned addr)
     return word;
 }
 
+/*
+ * Read a series of words from memory (without PE).
+ * Instructions for a batch of words are queued into one USB transfer.
+ * FASTDATA address is loaded once per batch, and the base address
+ * is reloaded only when the word is out of reach of lw offset.
+ * When any reply of the batch is bad, the batch is read
+ * again word by word.
+ */
+static void mpsse_read_words(adapter_t *adapter,
+    const unsigned *addr, unsigned nwords, unsigned *data)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+    unsigned char reload [READ_WORDS_BATCH];
+    unsigned long long word;
+    unsigned insn_bytes, word_bytes, batch, done, n, i, k, offset, base, ctl = 0;
+    int ok;
+
+    if (nwords == 0)
+        return;
+    if (! a->serial_execution_mode) {
+        /* First read after entering serial execution
+         * needs a workaround for PIC32MM. */
+        *data++ = mpsse_read_word(adapter, *addr++);
+        nwords--;
+    }
+    if (INTERFACE_ICSP == a->interface ||
+        FAMILY_MM == a->adapter.family_name_short) {
+        /* ICSP mode sends every scan in a separate packet anyway.
+         * PIC32MM needs exact timing of NOPs after the load. */
+        for (i=0; i<nwords; i++)
+            data[i] = mpsse_read_word(adapter, addr[i]);
+        return;
+    }
+
+    /* Every word takes up to five instructions and a FASTDATA scan. */
+    insn_bytes = 3 * a->pkt_command.nbytes + a->pkt_data_read.nbytes +
+        2 * a->pkt_data.nbytes;
+    word_bytes = 5 * insn_bytes + a->pkt_command.nbytes + a->pkt_fastdata.nbytes;
+    batch = (OUTPUT_SIZE - sizeof(a->pkt_command.data) - insn_bytes) / word_bytes;
+    if (batch > READ_WORDS_BATCH)
+        batch = READ_WORDS_BATCH;
+
+    /* Replies are collected from the beginning of input buffer. */
+    mpsse_flush_output(a);
+
+    for (done=0; done<nwords; done+=n) {
+        n = nwords - done;
+        if (n > batch)
+            n = batch;
+
+        mpsse_queue_instruction(a, 0x3c13ff20);             // lui s3, FASTDATA_REG_ADDR(31:16)
+        base = 0;
+        for (i=0; i<n; i++) {
+            unsigned addr_i = addr[done+i];
+
+            reload[i] = (i == 0 || addr_i < base || addr_i - base >= 0x8000);
+            if (reload[i]) {
+                base = addr_i;
+                mpsse_queue_instruction(a, 0x3c080000 | (base >> 16));     // lui t0, addr_hi
+                mpsse_queue_instruction(a, 0x35080000 | (base & 0xFFFF));  // ori t0, addr_lo
+            }
+            mpsse_queue_instruction(a, 0x8d090000 | (addr_i - base)); // lw t1, offset(t0)
+            mpsse_queue_instruction(a, 0xae690000);             // sw t1, 0(s3)
+            mpsse_queue_instruction(a, 0);                      // NOP - necessary!
+            mpsse_send_packet(a, &a->pkt_command, ETAP_FASTDATA);
+            mpsse_send_packet(a, &a->pkt_fastdata, 0);
+        }
+        mpsse_flush_output(a);
+
+        /* Decode replies: control word for every instruction,
+         * and FASTDATA word with PrAcc bit for every data word. */
+        ok = 1;
+        offset = 0;
+        for (i=0; i<n && ok; i++) {
+            unsigned ninsn = (i == 0) + (reload[i] ? 2 : 0) + 3;
+
+            for (k=0; k<ninsn; k++) {
+                memcpy(&word, a->input + offset, sizeof(word));
+                offset += a->pkt_data_read.bytes_per_word;
+                ctl = mpsse_fix_data32(word);
+                if (! mpsse_ctl_ready(a, ctl))
+                    ok = 0;
+            }
+            memcpy(&word, a->input + offset, sizeof(word));
+            offset += a->pkt_fastdata.bytes_per_word;
+            word = mpsse_fix_fastdata(word);
+            if (! (word & 1))
+                ok = 0;
+            data[done+i] = word >> 1;
+        }
+        if (! ok) {
+            if (debug_level > 0)
+                fprintf(stderr, "%s: batch read failed, ctl = %08x\n",
+                    a->name, ctl);
+            for (i=0; i<n; i++)
+                data[done+i] = mpsse_read_word(adapter, addr[done+i]);
+        }
+    }
+    if (debug_level > 0)
+        for (i=0; i<nwords; i++)
+            fprintf(stderr, "%s: read word at %08x -> %08x\n",
+                a->name, addr[i], data[i]);
+}
+
 /*
  * Read a memory block.
  */
@@ -1059,38 +1866,85 @@ static void mpsse_read_data(adapter_t *adapter,
     unsigned addr, unsigned nwords, unsigned *data)
 {
     mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
-    unsigned words_read, i;
+    unsigned n, i;
 
     //fprintf(stderr, "%s: read %d bytes from %08x\n", a->name, nwords*4, addr);
     if (! a->use_executive) {
         /* Without PE. */
-        for (; nwords > 0; nwords--) {
-            *data++ = mpsse_read_word(adapter, addr);
-            addr += 4;
+        unsigned addrs [READ_WORDS_BATCH];
+
+        for (; nwords > 0; nwords -= n) {
+            n = nwords;
+            if (n > READ_WORDS_BATCH)
+                n = READ_WORDS_BATCH;
+            for (i=0; i<n; i++)
+                addrs[i] = addr + i*4;
+            mpsse_read_words(adapter, addrs, n, data);
+            data += n;
+            addr += n*4;
         }
         return;
     }
 
     /* Use PE to read memory. */
-    for (words_read = 0; words_read < nwords; words_read += 32) {
+    for (; nwords > 0; nwords -= n) {
+        n = nwords;
+        if (n > READ_NWORDS)
+            n = READ_NWORDS;
 
         mpsse_sendCommand(a, ETAP_FASTDATA, 1);
-        mpsse_xferFastData(a, PE_READ << 16 | 32, 0, 1);       /* Read 32 words */  // Data, don't read, immediate
+        mpsse_xferFastData(a, PE_READ << 16 | n, 0, 1);        /* Read n words */   // Data, don't read, immediate
         mpsse_xferFastData(a, addr, 0, 1);                     /* Address */        // Data, don't read, immediate
 
         unsigned response = get_pe_response(a);     /* Get response */
         if (response != PE_READ << 16) {
             fprintf(stderr, "%s: bad READ response = %08x, expected %08x\n",
                 a->name, response, PE_READ << 16);
-            exit(-1);
-        }
-        for (i=0; i<32; i++) {
-            *data++ = get_pe_response(a);           /* Get data */
+            session_abort(-1);
         }
-        addr += 32*4;
+        get_pe_responses(a, data, n);               /* Get data */
+        data += n;
+        addr += n*4;
     }
 }
 
+static int mpsse_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes);
+
+/*
+ * Check whether the PE, downloaded before, is still running.
+ * The PE must accept EXEC_VERSION command on FASTDATA
+ * and return the expected version, and the checksum of its
+ * image in RAM must match the code.
+ */
+static int mpsse_pe_resident(mpsse_adapter_t *a,
+    const unsigned *pe, unsigned nwords, unsigned pe_version)
+{
+    unsigned pe_addr, version, crc;
+
+    /* A waiting PE completes the FASTDATA access at once;
+     * otherwise PrAcc is not set and nothing is executed. */
+    mpsse_sendCommand(a, ETAP_FASTDATA, 1);
+    if (! (mpsse_scanFastData(a, PE_EXEC_VERSION << 16) & 1))
+        return 0;
+
+    version = get_pe_response(a);
+    if (version != (PE_EXEC_VERSION << 16 | pe_version)) {
+        if (debug_level > 0)
+            fprintf(stderr, "%s: stale PE version = %08x\n", a->name, version);
+        return 0;
+    }
+
+    /* Physical address of the PE code in RAM. */
+    pe_addr = (a->adapter.family_name_short == FAMILY_MM) ? 0x300 : 0x900;
+    crc = mpsse_get_crc(&a->adapter, pe_addr, nwords * 4);
+    if (crc != calculate_crc(0xffff, (unsigned char*) pe, nwords * 4)) {
+        if (debug_level > 0)
+            fprintf(stderr, "%s: stale PE image, crc = %04x\n", a->name, crc);
+        return 0;
+    }
+    return 1;
+}
+
 /*
  * Download programming executive (PE).
  */
@@ -1099,6 +1953,18 @@ static void mpsse_load_executive(adapter_t *adapter,
 {
     mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
 
+    /* PE, downloaded in this session, can still be running:
+     * serial execution mode has not been entered again. */
+    if (a->use_executive && a->serial_execution_mode) {
+        if (mpsse_pe_resident(a, pe, nwords, pe_version)) {
+            if (debug_level > 0)
+                fprintf(stderr, "%s: PE is already running\n", a->name);
+            return;
+        }
+        /* Board was reset: enter serial execution again. */
+        a->serial_execution_mode = 0;
+    }
+
     a->use_executive = 1;
     serial_execution(a);
 
@@ -1110,38 +1976,38 @@ static void mpsse_load_executive(adapter_t *adapter,
         || a->adapter.family_name_short == FAMILY_MK
         || a->adapter.family_name_short == FAMILY_MZ)
     {
+        unsigned code [12 + PIC32_PE_LOADER_LEN*2], n = 0;
+        int i;
+
         /* Step 1. */
-        mpsse_xferInstruction(a, 0x3c04bf88);    // lui a0, 0xbf88
-        mpsse_xferInstruction(a, 0x34842000);    // ori a0, 0x2000 - address of BMXCON
-        mpsse_xferInstruction(a, 0x3c05001f);    // lui a1, 0x1f
-        mpsse_xferInstruction(a, 0x34a50040);    // ori a1, 0x40   - a1 has 001f0040
-        mpsse_xferInstruction(a, 0xac850000);    // sw  a1, 0(a0)  - BMXCON initialized
+        code[n++] = 0x3c04bf88;     // lui a0, 0xbf88
+        code[n++] = 0x34842000;     // ori a0, 0x2000 - address of BMXCON
+        code[n++] = 0x3c05001f;     // lui a1, 0x1f
+        code[n++] = 0x34a50040;     // ori a1, 0x40   - a1 has 001f0040
+        code[n++] = 0xac850000;     // sw  a1, 0(a0)  - BMXCON initialized
 
         /* Step 2. */
-        mpsse_xferInstruction(a, 0x34050800);    // li  a1, 0x800  - a1 has 00000800
-        mpsse_xferInstruction(a, 0xac850010);    // sw  a1, 16(a0) - BMXDKPBA initialized
+        code[n++] = 0x34050800;     // li  a1, 0x800  - a1 has 00000800
+        code[n++] = 0xac850010;     // sw  a1, 16(a0) - BMXDKPBA initialized
 
         /* Step 3. */
-        mpsse_xferInstruction(a, 0x8c850040);    // lw  a1, 64(a0) - load BMXDMSZ
-        mpsse_xferInstruction(a, 0xac850020);    // sw  a1, 32(a0) - BMXDUDBA initialized
-        mpsse_xferInstruction(a, 0xac850030);    // sw  a1, 48(a0) - BMXDUPBA initialized
+        code[n++] = 0x8c850040;     // lw  a1, 64(a0) - load BMXDMSZ
+        code[n++] = 0xac850020;     // sw  a1, 32(a0) - BMXDUDBA initialized
+        code[n++] = 0xac850030;     // sw  a1, 48(a0) - BMXDUPBA initialized
 
         /* Step 4. */
-        mpsse_xferInstruction(a, 0x3c04a000);    // lui a0, 0xa000
-        mpsse_xferInstruction(a, 0x34840800);    // ori a0, 0x800  - a0 has a0000800
+        code[n++] = 0x3c04a000;     // lui a0, 0xa000
+        code[n++] = 0x34840800;     // ori a0, 0x800  - a0 has a0000800
 
         /* Download the PE loader. */
-        int i;
         for (i=0; i<PIC32_PE_LOADER_LEN; i+=2) {
             /* Step 5. */
-            unsigned opcode1 = 0x3c060000 | pic32_pe_loader[i];
-            unsigned opcode2 = 0x34c60000 | pic32_pe_loader[i+1];
-
-            mpsse_xferInstruction(a, opcode1);       // lui a2, PE_loader_hi++
-            mpsse_xferInstruction(a, opcode2);       // ori a2, PE_loader_lo++
-            mpsse_xferInstruction(a, 0xac860000);    // sw  a2, 0(a0)
-            mpsse_xferInstruction(a, 0x24840004);    // addiu a0, 4
+            code[n++] = 0x3c060000 | pic32_pe_loader[i];    // lui a2, PE_loader_hi++
+            code[n++] = 0x34c60000 | pic32_pe_loader[i+1];  // ori a2, PE_loader_lo++
+            code[n++] = 0xac860000;                         // sw  a2, 0(a0)
+            code[n++] = 0x24840004;                         // addiu a0, 4
         }
+        mpsse_xferInstructionBlock(a, code, n);
 
         /* Jump to PE loader (step 6). */
         mpsse_xferInstruction(a, 0x3c19a000);    // lui t9, 0xa000
@@ -1165,10 +2031,9 @@ static void mpsse_load_executive(adapter_t *adapter,
         /* Download the PE itself (step 7-B). */
         if (debug_level > 0)
             fprintf(stderr, "%s: download PE\n", a->name);
-        for (i=0; i<nwords; i++) {
-            mpsse_xferFastData(a, *pe++, 0, 0);     /* Don't read, not immediate */
-        }
-        mpsse_flush_output(a);
+        i = mpsse_xferFastDataBlock(a, pe, nwords);
+        if (i >= 0)
+            fprintf(stderr, "%s: PrAcc not set at PE word %d\n", a->name, i);
         mdelay(10);
 
         /* Download the PE instructions. */
@@ -1180,21 +2045,20 @@ static void mpsse_load_executive(adapter_t *adapter,
     }
     else{
         /* Else MM family */
-        // Step 1. Setup PIC32MM RAM address for the PE
-		mpsse_xferInstruction(a, 0xa00041a4);    // lui a0, 0xa000
-		mpsse_xferInstruction(a, 0x02005084);    // ori a0, a0, 0x200 A total of 0xa000_0200
+		unsigned code [2 + PIC32_PEMM_LOADER_LEN/2*3], n = 0;
+		int i;
+
+		// Step 1. Setup PIC32MM RAM address for the PE
+		code[n++] = 0xa00041a4;     // lui a0, 0xa000
+		code[n++] = 0x02005084;     // ori a0, a0, 0x200 A total of 0xa000_0200
 
 		// Step 2. Load the PE_loader.
-		int i;
 		for (i=0; i<PIC32_PEMM_LOADER_LEN; i+=2) {
-		    /* Step 5. */
-		    unsigned opcode1 = 0x41A6 | (pic32_pemm_loader[i] << 16);
-		    unsigned opcode2 = 0x50C6 | (pic32_pemm_loader[i+1] << 16);
-
-		    mpsse_xferInstruction(a, opcode1);       // lui a2, PE_loader_hi++
-		    mpsse_xferInstruction(a, opcode2);       // ori a2, a2, PE_loader_lo++
-		    mpsse_xferInstruction(a, 0x6E42EB40);    // sw  a2, 0(a0); addiu a0, a0, 4;
+		    code[n++] = 0x41A6 | (pic32_pemm_loader[i] << 16);     // lui a2, PE_loader_hi++
+		    code[n++] = 0x50C6 | (pic32_pemm_loader[i+1] << 16);   // ori a2, a2, PE_loader_lo++
+		    code[n++] = 0x6E42EB40;                                // sw  a2, 0(a0); addiu a0, a0, 4;
 		}
+		mpsse_xferInstructionBlock(a, code, n);
 
 		// Step 3. Jump to the PE_Loader
 		mpsse_xferInstruction(a, 0xA00041B9);       // lui t9, 0xa000
@@ -1224,10 +2088,9 @@ static void mpsse_load_executive(adapter_t *adapter,
 			fprintf(stderr, "%s: download PE, nwords = %d\n", a->name, nwords);
 			//mdelay(3000);
 		}
-		for (i=0; i<nwords; i++) {
-			mpsse_xferFastData(a, *pe++, 0, 0);     // Data, don't read, no immediate
-		}
-		mpsse_flush_output(a);
+		i = mpsse_xferFastDataBlock(a, pe, nwords);
+		if (i >= 0)
+			fprintf(stderr, "%s: PrAcc not set at PE word %d\n", a->name, i);
 		mdelay(10);
 
 		// Step 5, Jump to the PE.
@@ -1244,7 +2107,7 @@ static void mpsse_load_executive(adapter_t *adapter,
     if (version != (PE_EXEC_VERSION << 16 | pe_version)) {
         fprintf(stderr, "%s: bad PE version = %08x, expected %08x\n",
             a->name, version, PE_EXEC_VERSION << 16 | pe_version);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 0)
         fprintf(stderr, "%s: PE version = %04x\n",
@@ -1285,6 +2148,40 @@ static void mpsse_erase_chip(adapter_t *adapter)
 
     mpsse_setMode(a, SET_MODE_TAP_RESET, 1);
     mdelay(25);
+
+    /* Chip erase resets the processor: serial execution
+     * mode and the PE are lost. */
+    a->serial_execution_mode = 0;
+    a->use_executive = 0;
+}
+
+/*
+ * Erase pages of flash memory.
+ */
+static void mpsse_erase_page(adapter_t *adapter, unsigned addr, unsigned npages)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+
+    if (debug_level > 0)
+        fprintf(stderr, "%s: erase %u pages at %08x\n", a->name, npages, addr);
+    if (! a->use_executive) {
+        /* Without PE. */
+        fprintf(stderr, "%s: page erase without PE not implemented.\n", a->name);
+        session_abort(-1);
+    }
+
+    /* Send command. */
+    mpsse_sendCommand(a, ETAP_FASTDATA, 1);
+
+    mpsse_xferFastData(a, PE_PAGE_ERASE << 16 | npages, 0, 1);  // Data, don't read, immediate
+    mpsse_xferFastData(a, addr, 0, 1);  /* Send address. */     // Data, don't read, immediate
+
+    unsigned response = get_pe_response(a);
+    if (response != (PE_PAGE_ERASE << 16)) {
+        fprintf(stderr, "%s: failed to erase %u pages at %08x, reply = %08x\n",
+            a->name, npages, addr, response);
+        session_abort(-1);
+    }
 }
 
 /*
@@ -1304,7 +2201,7 @@ static void mpsse_program_word(adapter_t *adapter,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
 
     /* Use PE to write flash memory. */
@@ -1319,7 +2216,7 @@ static void mpsse_program_word(adapter_t *adapter,
     if (response != (PE_WORD_PROGRAM << 16)) {
         fprintf(stderr, "%s: failed to program word %08x at %08x, reply = %08x\n",
             a->name, word, addr, response);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -1336,7 +2233,7 @@ static void mpsse_program_double_word(adapter_t *adapter, unsigned addr, unsigne
 	if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
 
 	 /* Use PE to write flash memory. */
@@ -1352,7 +2249,7 @@ static void mpsse_program_double_word(adapter_t *adapter, unsigned addr, unsigne
     if (response != (PE_DOUBLE_WORD_PGRM << 16)) {
         fprintf(stderr, "%s: failed to program double words 0x%08x 0x%08x at 0x%08x, reply = %08x\n",
             a->name, word0, word1, addr, response);
-        exit(-1);
+        session_abort(-1);
     }
 
 }
@@ -1373,7 +2270,7 @@ static void mpsse_program_quad_word(adapter_t *adapter, unsigned addr,
 	if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
 
 	 /* Use PE to write flash memory. */
@@ -1391,7 +2288,7 @@ static void mpsse_program_quad_word(adapter_t *adapter, unsigned addr,
     if (response != (PE_QUAD_WORD_PGRM << 16)) {
         fprintf(stderr, "%s: failed to program quad words 0x%08x 0x%08x 0x%08x 0x%08x at 0x%08x, reply = %08x\n",
             a->name, word0, word1, word2, word3, addr, response);
-        exit(-1);
+        session_abort(-1);
     }
 
 }
@@ -1411,7 +2308,7 @@ static void mpsse_program_row(adapter_t *adapter, unsigned addr,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
 
     /* Use PE to write flash memory. */
@@ -1422,38 +2319,71 @@ static void mpsse_program_row(adapter_t *adapter, unsigned addr,
     mpsse_xferFastData(a, addr, 0, 1);  /* Send address. */             // Data, don't read, immediate
 
     /* Download data. */
-    for (i = 0; i < words_per_row; i++) {
-        if ((i & 7) == 0)
-            mpsse_flush_output(a);
-        mpsse_xferFastData(a, *data++, 0, 0);   /* Send word. Don't read, not immediate */
-    }
-    mpsse_flush_output(a);
+    i = mpsse_xferFastDataBlock(a, data, words_per_row);
+    if (i >= 0)
+        fprintf(stderr, "%s: PrAcc not set at word %d (address %08x)\n",
+            a->name, i, addr + i*4);
 
     unsigned response = get_pe_response(a);
     if (response != (PE_ROW_PROGRAM << 16)) {
         fprintf(stderr, "%s: failed to program row at %08x, reply = %08x\n",
             a->name, addr, response);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
 /*
- * Verify a block of memory.
+ * Program a contiguous run of rows by one PE command.
  */
-static void mpsse_verify_data(adapter_t *adapter,
-    unsigned addr, unsigned nwords, unsigned *data)
+static void mpsse_program_cluster(adapter_t *adapter, unsigned addr,
+    unsigned *data, unsigned nwords)
 {
     mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
-    unsigned data_crc, flash_crc;
+    int i;
 
-    //fprintf(stderr, "%s: verify %d words at %08x\n", a->name, nwords, addr);
+    if (debug_level > 0)
+        fprintf(stderr, "%s: cluster program %u words at %08x\n",
+            a->name, nwords, addr);
     if (! a->use_executive) {
         /* Without PE. */
-        fprintf(stderr, "%s: slow verify not implemented yet.\n", a->name);
-        exit(-1);
+        fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
+        session_abort(-1);
     }
 
-    /* Use PE to get CRC of flash memory. */
+    /* Send command. */
+    mpsse_sendCommand(a, ETAP_FASTDATA, 1);
+
+    mpsse_xferFastData(a, PE_PROGRAM_CLUSTER << 16, 0, 1);  // Data, don't read, immediate
+    mpsse_xferFastData(a, addr, 0, 1);  /* Send address. */  // Data, don't read, immediate
+    mpsse_xferFastData(a, nwords * 4, 0, 1);  /* Send length. */
+
+    /* Download data. */
+    i = mpsse_xferFastDataBlock(a, data, nwords);
+    if (i >= 0) {
+        fprintf(stderr, "%s: failed to program cluster at %08x, PrAcc not set at word %d (address %08x)\n",
+            a->name, addr, i, addr + i*4);
+        session_abort(-1);
+    }
+
+    unsigned response = get_pe_response(a);
+    if (response != (PE_PROGRAM_CLUSTER << 16)) {
+        fprintf(stderr, "%s: failed to program cluster at %08x, reply = %08x\n",
+            a->name, addr, response);
+        session_abort(-1);
+    }
+}
+
+/*
+ * Get checksum of flash memory, computed by PE.
+ * Return -1 when PE is not available.
+ */
+static int mpsse_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+
+    if (! a->use_executive)
+        return -1;
+
     /* Send command. */
     mpsse_sendCommand(a, ETAP_FASTDATA, 1);
 
@@ -1461,15 +2391,64 @@ static void mpsse_verify_data(adapter_t *adapter,
      /* Send address. */
     mpsse_xferFastData(a, addr, 0, 1);              // Data, don't read, immediate
     /* Send length. */
-    mpsse_xferFastData(a, nwords * 4, 0, 1);        // Data, don't read, immediate
+    mpsse_xferFastData(a, nbytes, 0, 1);            // Data, don't read, immediate
 
     unsigned response = get_pe_response(a);
     if (response != (PE_GET_CRC << 16)) {
-        fprintf(stderr, "%s: failed to verify %d words at %08x, reply = %08x\n",
-            a->name, nwords, addr, response);
-        exit(-1);
+        fprintf(stderr, "%s: failed to verify %d bytes at %08x, reply = %08x\n",
+            a->name, nbytes, addr, response);
+        session_abort(-1);
+    }
+    return get_pe_response(a) & 0xffff;
+}
+
+/*
+ * Check that memory is erased, using PE.
+ * Return 1 when blank, 0 when not blank, -1 without PE.
+ */
+static int mpsse_blank_check(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+
+    if (! a->use_executive)
+        return -1;
+
+    /* Send command. */
+    mpsse_sendCommand(a, ETAP_FASTDATA, 1);
+
+    mpsse_xferFastData(a, PE_BLANK_CHECK << 16, 0, 1);  // Data, don't read, immediate
+    /* Send address. */
+    mpsse_xferFastData(a, addr, 0, 1);                  // Data, don't read, immediate
+    /* Send length. */
+    mpsse_xferFastData(a, nbytes, 0, 1);                // Data, don't read, immediate
+
+    unsigned response = get_pe_response(a);
+    if ((response >> 16) != PE_BLANK_CHECK) {
+        fprintf(stderr, "%s: failed to blank check %d bytes at %08x, reply = %08x\n",
+            a->name, nbytes, addr, response);
+        session_abort(-1);
+    }
+    return (response & 0xffff) == 0;
+}
+
+/*
+ * Verify a block of memory.
+ */
+static void mpsse_verify_data(adapter_t *adapter,
+    unsigned addr, unsigned nwords, unsigned *data)
+{
+    mpsse_adapter_t *a = (mpsse_adapter_t*) adapter;
+    unsigned data_crc, flash_crc;
+
+    //fprintf(stderr, "%s: verify %d words at %08x\n", a->name, nwords, addr);
+    if (! a->use_executive) {
+        /* Without PE. */
+        fprintf(stderr, "%s: slow verify not implemented yet.\n", a->name);
+        session_abort(-1);
     }
-    flash_crc = get_pe_response(a) & 0xffff;
+
+    /* Use PE to get CRC of flash memory. */
+    flash_crc = mpsse_get_crc(adapter, addr, nwords * 4);
     data_crc = calculate_crc(0xffff, (unsigned char*) data, nwords * 4);
     if (flash_crc != data_crc) {
         fprintf(stderr, "%s: checksum failed at %08x: sum=%04x, expected=%04x\n",
@@ -1496,13 +2475,14 @@ adapter_t *adapter_open_mpsse(int vid, int pid, const char *serial,
         fprintf(stderr, "adapter_open_mpsse: out of memory\n");
         return 0;
     }
+    mpsse_init_packets(a);
     a->context = NULL;
     int ret = libusb_init(&a->context);
 
     if (ret != 0) {
         fprintf(stderr, "libusb init failed: %d: %s\n",
             ret, libusb_strerror(ret));
-        exit(-1);
+        session_abort(-1);
     }
 
     for (i = 0; devlist[i].vid; i++) {
@@ -1561,12 +2541,25 @@ found:
             fprintf(stderr, "Error detaching kernel driver: %d: %s\n",
                 ret, libusb_strerror(ret));
             libusb_close(a->usbdev);
-            exit(-1);
+            session_abort(-1);
         }
     }
 
     libusb_claim_interface(a->usbdev, 0);
 
+    if (! mpsse_alloc_transfers(a)) {
+        fprintf(stderr, "%s: out of memory\n", a->name);
+        mpsse_free_transfers(a);
+        libusb_release_interface(a->usbdev, 0);
+        libusb_close(a->usbdev);
+        free(a);
+        return 0;
+    }
+
+    a->max_packet = libusb_get_max_packet_size(libusb_get_device(a->usbdev), OUT_EP);
+    if (a->max_packet <= 2 || a->max_packet > MAX_PACKET)
+        a->max_packet = 64;
+
     /* Reset the ftdi device. */
     if (libusb_control_transfer(a->usbdev,
         LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_OUT,
@@ -1575,7 +2568,8 @@ found:
             fprintf(stderr, "%s: superuser privileges needed.\n", a->name);
         else
             fprintf(stderr, "%s: FTDI reset failed\n", a->name);
-failed: libusb_release_interface(a->usbdev, 0);
+failed: mpsse_free_transfers(a);
+        libusb_release_interface(a->usbdev, 0);
         libusb_close(a->usbdev);
         free(a);
         return 0;
@@ -1696,12 +2690,265 @@ failed: libusb_release_interface(a->usbdev, 0);
     a->adapter.get_idcode = mpsse_get_idcode;
     a->adapter.load_executive = mpsse_load_executive;
     a->adapter.read_word = mpsse_read_word;
+    a->adapter.read_words = mpsse_read_words;
     a->adapter.read_data = mpsse_read_data;
     a->adapter.verify_data = mpsse_verify_data;
+    a->adapter.get_crc = mpsse_get_crc;
+    a->adapter.blank_check = mpsse_blank_check;
     a->adapter.erase_chip = mpsse_erase_chip;
+    a->adapter.erase_page = mpsse_erase_page;
     a->adapter.program_word = mpsse_program_word;
     a->adapter.program_row = mpsse_program_row;
+    a->adapter.program_cluster = mpsse_program_cluster;
     a->adapter.program_double_word = mpsse_program_double_word;
     a->adapter.program_quad_word = mpsse_program_quad_word;
     return &a->adapter;
 }
+
+#ifdef STANDALONE
+/*
+ * Microbenchmark of packet construction: measure host CPU time
+ * spent to build the JTAG packets by the original builder,
+ * by generic mpsse_send(), and by prepared packet templates.
+ * No adapter is needed.
+ */
+__thread int debug_level;
+
+void mdelay(unsigned msec)
+{
+    usleep(msec * 1000);
+}
+
+void session_abort(int status)
+{
+    exit(status);
+}
+
+static mpsse_adapter_t bench;
+
+static void bench_reset(void)
+{
+    if (bench.bytes_to_write > OUTPUT_SIZE - 64) {
+        bench.bytes_to_write = 0;
+        bench.bytes_to_read = 0;
+    }
+}
+
+static double bench_nsec(struct timeval *t0, unsigned count)
+{
+    struct timeval t1;
+
+    gettimeofday(&t1, 0);
+    return ((t1.tv_sec - t0->tv_sec) * 1e9 +
+        (t1.tv_usec - t0->tv_usec) * 1e3) / count;
+}
+
+/*
+ * Packet builder of JTAG mode before the templates, kept as
+ * the baseline of the benchmark.
+ */
+static void bench_send_orig(mpsse_adapter_t *a,
+    unsigned tms_prolog_nbits, unsigned tms_prolog,
+    unsigned tdi_nbits, unsigned long long tdi,
+    unsigned tms_epilog_nbits, unsigned tms_epilog, int read_flag)
+{
+    /* Check that we have enough space in output buffer.
+     * Max size of one packet is 23 bytes (6+8+3+3+3). */
+    if (a->bytes_to_write > OUTPUT_SIZE - 23)
+        mpsse_flush_output(a);
+
+    /* Prepare a packet of MPSSE commands. */
+    if (tms_prolog_nbits > 0) {
+        /* Prologue TMS, from 1 to 14 bits.
+         * 4b - Clock Data to TMS Pin (no Read) */
+        a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
+        if (tms_prolog_nbits < 8) {
+            a->output [a->bytes_to_write++] = tms_prolog_nbits - 1;
+            a->output [a->bytes_to_write++] = tms_prolog;
+        } else {
+            a->output [a->bytes_to_write++] = 7 - 1;
+            a->output [a->bytes_to_write++] = tms_prolog & 0x7f;
+            a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
+            a->output [a->bytes_to_write++] = tms_prolog_nbits - 7 - 1;
+            a->output [a->bytes_to_write++] = tms_prolog >> 7;
+        }
+    }
+    if (tdi_nbits > 0) {
+        /* Data, from 1 to 64 bits. */
+        if (tms_epilog_nbits > 0) {
+            /* Last bit should be accompanied with signal TMS=1. */
+            tdi_nbits--;
+        }
+        unsigned nbytes = tdi_nbits / 8;
+        unsigned last_byte_bits = tdi_nbits & 7;
+        if (read_flag) {
+            a->high_byte_bits = last_byte_bits;
+            a->fix_high_bit = 0;
+            a->high_byte_mask = 0;
+            a->bytes_per_word = nbytes;
+            if (a->high_byte_bits > 0)
+                a->bytes_per_word++;
+            a->bytes_to_read += a->bytes_per_word;
+        }
+        if (nbytes > 0) {
+            /* Whole bytes.
+             * 39 - Clock Data Bytes In and Out LSB First
+             * 19 - Clock Data Bytes Out LSB First (no Read) */
+            a->output [a->bytes_to_write++] = read_flag ?
+                (WTDI + RTDO + CLKWNEG + LSB) :
+                (WTDI + CLKWNEG + LSB);
+            a->output [a->bytes_to_write++] = nbytes - 1;
+            a->output [a->bytes_to_write++] = (nbytes - 1) >> 8;
+            while (nbytes-- > 0) {
+                a->output [a->bytes_to_write++] = tdi;
+                tdi >>= 8;
+            }
+        }
+        if (last_byte_bits) {
+            /* Last partial byte.
+             * 3b - Clock Data Bits In and Out LSB First
+             * 1b - Clock Data Bits Out LSB First (no Read) */
+            a->output [a->bytes_to_write++] = read_flag ?
+                (WTDI + RTDO + BITMODE + CLKWNEG + LSB) :
+                (WTDI + BITMODE + CLKWNEG + LSB);
+            a->output [a->bytes_to_write++] = last_byte_bits - 1;
+            a->output [a->bytes_to_write++] = tdi;
+            tdi >>= last_byte_bits;
+            a->high_byte_mask = 0xffULL << (a->bytes_per_word - 1) * 8;
+        }
+        if (tms_epilog_nbits > 0) {
+            /* Last bit (actually two bits).
+             * 6b - Clock Data to TMS Pin with Read
+             * 4b - Clock Data to TMS Pin (no Read) */
+            tdi_nbits++;
+            a->output [a->bytes_to_write++] = read_flag ?
+                (WTMS + RTDO + BITMODE + CLKWNEG + LSB) :
+                (WTMS + BITMODE + CLKWNEG + LSB);
+            a->output [a->bytes_to_write++] = 1;
+            a->output [a->bytes_to_write++] = tdi << 7 | 1 | tms_epilog << 1;
+            tms_epilog_nbits--;
+            tms_epilog >>= 1;
+            if (read_flag) {
+                /* Last bit wil come in next byte.
+                 * Compute a mask for correction. */
+                a->fix_high_bit = 0x40ULL << (a->bytes_per_word * 8);
+                a->bytes_per_word++;
+                a->bytes_to_read++;
+            }
+        }
+        if (read_flag)
+            a->high_bit_mask = 1ULL << (tdi_nbits - 1);
+    }
+    if (tms_epilog_nbits > 0) {
+        /* Epiloque TMS, from 1 to 7 bits.
+         * 4b - Clock Data to TMS Pin (no Read) */
+        a->output [a->bytes_to_write++] = WTMS + BITMODE + CLKWNEG + LSB;
+        a->output [a->bytes_to_write++] = tms_epilog_nbits - 1;
+        a->output [a->bytes_to_write++] = tms_epilog;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = (argc > 1) ? strtoul(argv[1], 0, 0) : 10000000;
+    unsigned long long word, sum = 0;
+    struct timeval t0;
+    double orig, generic, template;
+    unsigned i;
+
+    bench.output = bench.out_buf[0];
+    bench.interface = INTERFACE_JTAG;
+    mpsse_init_packets(&bench);
+
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        bench_send_orig(&bench, TMS_HEADER_COMMAND_NBITS, TMS_HEADER_COMMAND_VAL,
+            ETAP_COMMAND_NBITS, ETAP_FASTDATA,
+            TMS_FOOTER_COMMAND_NBITS, TMS_FOOTER_COMMAND_VAL, 0);
+    }
+    orig = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send(&bench, TMS_HEADER_COMMAND_NBITS, TMS_HEADER_COMMAND_VAL,
+            ETAP_COMMAND_NBITS, ETAP_FASTDATA,
+            TMS_FOOTER_COMMAND_NBITS, TMS_FOOTER_COMMAND_VAL, 0);
+    }
+    generic = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send_packet(&bench, &bench.pkt_command, ETAP_FASTDATA);
+    }
+    template = bench_nsec(&t0, count);
+    printf("IR command:      original %6.1f, generic %6.1f, template %6.1f nsec\n",
+        orig, generic, template);
+
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        bench_send_orig(&bench, TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL,
+            32, i, TMS_FOOTER_XFERDATA_NBITS, TMS_FOOTER_XFERDATA_VAL, 1);
+    }
+    orig = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send(&bench, TMS_HEADER_XFERDATA_NBITS, TMS_HEADER_XFERDATA_VAL,
+            32, i, TMS_FOOTER_XFERDATA_NBITS, TMS_FOOTER_XFERDATA_VAL, 1);
+    }
+    generic = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send_packet(&bench, &bench.pkt_data_read, i);
+    }
+    template = bench_nsec(&t0, count);
+    printf("32-bit DR:       original %6.1f, generic %6.1f, template %6.1f nsec\n",
+        orig, generic, template);
+
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        bench_send_orig(&bench, TMS_HEADER_XFERDATAFAST_NBITS, TMS_HEADER_XFERDATAFAST_VAL,
+            33, (unsigned long long) i << 1,
+            TMS_FOOTER_XFERDATAFAST_NBITS, TMS_FOOTER_XFERDATAFAST_VAL, 1);
+    }
+    orig = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send(&bench, TMS_HEADER_XFERDATAFAST_NBITS, TMS_HEADER_XFERDATAFAST_VAL,
+            33, (unsigned long long) i << 1,
+            TMS_FOOTER_XFERDATAFAST_NBITS, TMS_FOOTER_XFERDATAFAST_VAL, 1);
+    }
+    generic = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        bench_reset();
+        mpsse_send_packet(&bench, &bench.pkt_fastdata, (unsigned long long) i << 1);
+    }
+    template = bench_nsec(&t0, count);
+    printf("33-bit FASTDATA: original %6.1f, generic %6.1f, template %6.1f nsec\n",
+        orig, generic, template);
+
+    /* Reply decoding: the state is left from the last FASTDATA packet. */
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        word = (unsigned long long) i * 0x9e3779b97f4a7c15ULL;
+        sum += mpsse_fix_data(&bench, word);
+    }
+    generic = bench_nsec(&t0, count);
+    gettimeofday(&t0, 0);
+    for (i=0; i<count; i++) {
+        word = (unsigned long long) i * 0x9e3779b97f4a7c15ULL;
+        sum -= mpsse_fix_fastdata(word);
+    }
+    template = bench_nsec(&t0, count);
+    printf("Decode FASTDATA: generic %6.1f nsec, special  %6.1f nsec\n", generic, template);
+    if (sum != 0)
+        printf("Decoders disagree!\n");
+    return 0;
+}
+#endif /* STANDALONE */
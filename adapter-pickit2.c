@@ -16,12 +16,36 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/time.h>
 
 #include "adapter.h"
 #include "hidapi.h"
 #include "pickit2.h"
 #include "pic32.h"
 
+/*
+ * Max number of PE responses, kept in upload buffer
+ * while the next rows are programmed.
+ */
+#define PENDING_ROWS            8
+
+/*
+ * Max number of replies in flight, when reading memory.
+ * Hidapi keeps a queue of about 30 input reports.
+ */
+#define READ_INFLIGHT           16
+
+/*
+ * Number of PE_READ script runs in one report.
+ */
+#define READ_RUNS_PER_REPORT    2
+
+/*
+ * Max number of words read without PE in one upload.
+ * Every word takes 8 bytes of upload buffer.
+ */
+#define READ_WORDS_BATCH        7
+
 typedef struct {
     /* Common part */
     adapter_t adapter;
@@ -35,6 +59,14 @@ typedef struct {
     unsigned use_executive;
     unsigned serial_execution_mode;
 
+    /* Queue of commands, packed into one report. */
+    unsigned char queue [64];
+    unsigned queue_len;
+
+    /* Rows programmed, with PE responses not collected yet. */
+    unsigned pending_rows;
+    unsigned pending_addr [PENDING_ROWS];
+
 } pickit_adapter_t;
 
 /*
@@ -68,7 +100,9 @@ typedef struct {
                           (unsigned char) ((w) >> 16), \
                           (unsigned char) ((w) >> 24)
 
-static void pickit_send_buf(pickit_adapter_t *a, unsigned char *buf, unsigned nbytes)
+static void pickit_finish_rows(pickit_adapter_t *a);
+
+static void pickit_write(pickit_adapter_t *a, unsigned char *buf, unsigned nbytes)
 {
     if (debug_level > 1) {
         int k;
@@ -83,6 +117,71 @@ static void pickit_send_buf(pickit_adapter_t *a, unsigned char *buf, unsigned nb
     hid_write(a->hiddev, buf, 64);
 }
 
+/*
+ * Send the queued commands.
+ */
+static void pickit_queue_flush(pickit_adapter_t *a)
+{
+    if (a->queue_len == 0)
+        return;
+    memset(a->queue + a->queue_len, CMD_END_OF_BUFFER, 64 - a->queue_len);
+    pickit_write(a, a->queue, a->queue_len);
+    a->queue_len = 0;
+}
+
+/*
+ * Add a command to the queue.
+ * A command is never split between reports.
+ */
+static void pickit_queue(pickit_adapter_t *a, unsigned argc, ...)
+{
+    va_list ap;
+    unsigned i;
+
+    if (a->queue_len + argc > 64)
+        pickit_queue_flush(a);
+    va_start(ap, argc);
+    for (i=0; i<argc; ++i)
+        a->queue[a->queue_len++] = va_arg(ap, int);
+    va_end(ap);
+}
+
+/*
+ * Add data for download buffer to the queue.
+ * Every report is filled up to the end.
+ */
+static void pickit_queue_data(pickit_adapter_t *a,
+    unsigned *data, unsigned nwords)
+{
+    unsigned i, n;
+
+    while (nwords > 0) {
+        if (a->queue_len + 2 + 4 > 64)
+            pickit_queue_flush(a);
+        n = (64 - a->queue_len - 2) / 4;
+        if (n > nwords)
+            n = nwords;
+        a->queue[a->queue_len++] = CMD_DOWNLOAD_DATA;
+        a->queue[a->queue_len++] = n * 4;
+        for (i=0; i<n; i++) {
+            unsigned word = *data++;
+            a->queue[a->queue_len++] = word;
+            a->queue[a->queue_len++] = word >> 8;
+            a->queue[a->queue_len++] = word >> 16;
+            a->queue[a->queue_len++] = word >> 24;
+        }
+        nwords -= n;
+    }
+}
+
+static void pickit_send_buf(pickit_adapter_t *a, unsigned char *buf, unsigned nbytes)
+{
+    /* Complete the queued row programming first. */
+    pickit_finish_rows(a);
+    pickit_queue_flush(a);
+    pickit_write(a, buf, nbytes);
+}
+
 static void pickit_send(pickit_adapter_t *a, unsigned argc, ...)
 {
     va_list ap;
@@ -101,7 +200,7 @@ static void pickit_recv(pickit_adapter_t *a)
 {
     if (hid_read(a->hiddev, a->reply, 64) != 64) {
         fprintf(stderr, "%s: error receiving packet\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 1) {
         int k;
@@ -115,17 +214,22 @@ static void pickit_recv(pickit_adapter_t *a)
     }
 }
 
+static unsigned read_status(pickit_adapter_t *a)
+{
+    pickit_send(a, 1, CMD_READ_STATUS);
+    pickit_recv(a);
+    return a->reply[0] | a->reply[1] << 8;
+}
+
 static void check_timeout(pickit_adapter_t *a, const char *message)
 {
     unsigned status;
 
-    pickit_send(a, 1, CMD_READ_STATUS);
-    pickit_recv(a);
-    status = a->reply[0] | a->reply[1] << 8;
+    status = read_status(a);
     if (status & STATUS_ICD_TIMEOUT) {
         fprintf(stderr, "%s: timed out at %s, status = %04x\n",
             a->name, message, status);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -307,6 +411,54 @@ step1_6_mz(pickit_adapter_t *a, unsigned nwords)
 /*
  * Download programming executive (PE).
  */
+static int pe_get_crc(pickit_adapter_t *a,
+    unsigned int start, unsigned int nbytes);
+
+/*
+ * Check whether the PE, downloaded before, is still running.
+ * The PE must accept EXEC_VERSION command on FASTDATA
+ * and return the expected version, and the checksum of its
+ * image in RAM must match the code.
+ */
+static int pe_resident(pickit_adapter_t *a,
+    const unsigned *pe, unsigned nwords, unsigned pe_version)
+{
+    unsigned version, pe_addr;
+    int crc;
+
+    /* When no PE is waiting for a command, the FASTDATA
+     * transfer times out, and nothing is executed. */
+    pickit_send(a, 11, CMD_CLEAR_UPLOAD_BUFFER,
+        CMD_EXECUTE_SCRIPT, 8,
+            SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
+            SCRIPT_JT2_XFRFASTDAT_LIT,
+                0x00, 0x00,                     // length = 0
+                0x07, 0x00,                     // EXEC_VERSION
+            SCRIPT_JT2_GET_PE_RESP);
+    if (read_status(a) & STATUS_ICD_TIMEOUT)
+        return 0;
+    pickit_send(a, 1, CMD_UPLOAD_DATA);
+    pickit_recv(a);
+
+    version = a->reply[1] | (a->reply[2] << 8);
+    if ((a->reply[3] | (a->reply[4] << 8)) != 0x0007 ||
+        version != pe_version) {
+        if (debug_level > 0)
+            fprintf(stderr, "%s: stale PE version = %04x\n", a->name, version);
+        return 0;
+    }
+
+    /* Physical address of the PE code in RAM. */
+    pe_addr = (a->adapter.family_name_short == FAMILY_MM) ? 0x300 : 0x900;
+    crc = pe_get_crc(a, pe_addr, nwords * 4);
+    if (crc != pic32_crc16(0xffff, (unsigned char*) pe, nwords * 4)) {
+        if (debug_level > 0)
+            fprintf(stderr, "%s: stale PE image, crc = %04x\n", a->name, crc);
+        return 0;
+    }
+    return 1;
+}
+
 static void pickit_load_executive(adapter_t *adapter,
     const unsigned *pe, unsigned nwords,
     unsigned pe_version)
@@ -316,6 +468,18 @@ static void pickit_load_executive(adapter_t *adapter,
 
     a->name = a->adapter.family_name;
     //fprintf(stderr, "%s: load_executive\n", a->name);
+
+    /* PE, downloaded in this session, can still be running:
+     * serial execution mode has not been entered again. */
+    if (a->use_executive && a->serial_execution_mode) {
+        if (pe_resident(a, pe, nwords, pe_version)) {
+            if (debug_level > 0)
+                fprintf(stderr, "%s: PE is already running\n", a->name);
+            return;
+        }
+        /* Board was reset: enter serial execution again. */
+        a->serial_execution_mode = 0;
+    }
     a->use_executive = 1;
     serial_execution(a);
 
@@ -385,20 +549,23 @@ static void pickit_load_executive(adapter_t *adapter,
     unsigned version = a->reply[3] | (a->reply[4] << 8);
     if (version != 0x0007) {                    // command echo
         fprintf(stderr, "%s: bad PE reply = %04x\n", a->name, version);
-        exit(-1);
+        session_abort(-1);
     }
     version = a->reply[1] | (a->reply[2] << 8);
     if (version != pe_version) {
         fprintf(stderr, "%s: bad PE version = %04x, expected %04x\n",
             a->name, version, pe_version);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 0)
         fprintf(stderr, "%s: PE version = %04x\n", a->name, version);
 }
 
-#if 0
-int pe_blank_check(pickit_adapter_t *a,
+/*
+ * Check that flash memory is erased, using PE.
+ * Return 1 when blank, 0 when not blank.
+ */
+static int pe_blank_check(pickit_adapter_t *a,
     unsigned int start, unsigned int nbytes)
 {
     pickit_send(a, 21, CMD_CLEAR_UPLOAD_BUFFER, CMD_EXECUTE_SCRIPT, 18,
@@ -420,13 +587,22 @@ int pe_blank_check(pickit_adapter_t *a,
     check_timeout(a, "BLANK_CHECK");
     pickit_send(a, 1, CMD_UPLOAD_DATA);
     pickit_recv(a);
-    if (a->reply[3] != 6 || a->reply[1] != 0) { // response code 0 = success
+    if (a->reply[3] != PE_BLANK_CHECK) {
+        fprintf(stderr, "%s: failed to blank check %d bytes at %08x\n",
+            a->name, nbytes, start);
+        session_abort(-1);
+    }
+    if (a->reply[1] != 0 || a->reply[2] != 0) { // response code 0 = blank
         return 0;
     }
     return 1;
 }
 
-int pe_get_crc(pickit_adapter_t *a,
+/*
+ * Get CRC of flash memory, computed by PE.
+ * Return -1 on failure.
+ */
+static int pe_get_crc(pickit_adapter_t *a,
     unsigned int start, unsigned int nbytes)
 {
     pickit_send(a, 22, CMD_CLEAR_UPLOAD_BUFFER, CMD_EXECUTE_SCRIPT, 19,
@@ -450,13 +626,12 @@ int pe_get_crc(pickit_adapter_t *a,
     pickit_send(a, 1, CMD_UPLOAD_DATA);
     pickit_recv(a);
     if (a->reply[3] != 8 || a->reply[1] != 0) { // response code 0 = success
-        return 0;
+        return -1;
     }
 
     int crc = a->reply[5] | (a->reply[6] << 8);
     return crc;
 }
-#endif
 
 static void pickit_finish(pickit_adapter_t *a, int power_on)
 {
@@ -566,7 +741,7 @@ static unsigned pickit_read_word(adapter_t *adapter, unsigned addr)
 		    if (a->reply[0] != 4) {
 		        fprintf(stderr, "%s: read word %08x: bad reply length=%u\n",
 		            a->name, addr, a->reply[0]);
-		        exit(-1);
+		        session_abort(-1);
 		    }
 		    word1 = a->reply[1] | (a->reply[2] << 8) |
 		           (a->reply[3] << 16) | (a->reply[4] << 24);
@@ -634,7 +809,7 @@ static unsigned pickit_read_word(adapter_t *adapter, unsigned addr)
 		    if (a->reply[0] != 4) {
 		        fprintf(stderr, "%s: read word %08x: bad reply length=%u\n",
 		            a->name, addr, a->reply[0]);
-		        exit(-1);
+		        session_abort(-1);
 		    }
 		    word1 = a->reply[1] | (a->reply[2] << 8) |
 		           (a->reply[3] << 16) | (a->reply[4] << 24);
@@ -668,7 +843,7 @@ static unsigned pickit_read_word(adapter_t *adapter, unsigned addr)
 		    if (a->reply[0] != 4) {
 		        fprintf(stderr, "%s: read word %08x: bad reply length=%u\n",
 		            a->name, addr, a->reply[0]);
-		        exit(-1);
+		        session_abort(-1);
 		    }
 		    word2 = a->reply[1] | (a->reply[2] << 8) |
 		           (a->reply[3] << 16) | (a->reply[4] << 24);
@@ -681,7 +856,7 @@ static unsigned pickit_read_word(adapter_t *adapter, unsigned addr)
     if (a->reply[0] != 4) {
         fprintf(stderr, "%s: read word %08x: bad reply length=%u\n",
             a->name, addr, a->reply[0]);
-        exit(-1);
+        session_abort(-1);
     }
 
     if (debug_level > 0)
@@ -689,6 +864,128 @@ static unsigned pickit_read_word(adapter_t *adapter, unsigned addr)
     return value;
 }
 
+/*
+ * Queue a script, which executes instructions from download buffer,
+ * and appends FASTDATA register to upload buffer.
+ */
+static void pickit_queue_read_script(pickit_adapter_t *a,
+    unsigned *code, unsigned ninst)
+{
+    unsigned i;
+
+    pickit_queue(a, 1, CMD_CLEAR_DOWNLOAD_BUFFER);
+    pickit_queue_data(a, code, ninst);
+
+    if (a->queue_len + 14 + ninst > 64)
+        pickit_queue_flush(a);
+    a->queue[a->queue_len++] = CMD_EXECUTE_SCRIPT;
+    a->queue[a->queue_len++] = 12 + ninst;
+    a->queue[a->queue_len++] = SCRIPT_JT2_SENDCMD;
+    a->queue[a->queue_len++] = TAP_SW_ETAP;
+    a->queue[a->queue_len++] = SCRIPT_JT2_SETMODE;
+    a->queue[a->queue_len++] = 6;
+    a->queue[a->queue_len++] = 0x1F;
+    for (i=0; i<ninst; i++)
+        a->queue[a->queue_len++] = SCRIPT_JT2_XFERINST_BUF;
+    a->queue[a->queue_len++] = SCRIPT_JT2_SENDCMD;
+    a->queue[a->queue_len++] = ETAP_FASTDATA;           // read FastData
+    a->queue[a->queue_len++] = SCRIPT_JT2_XFERDATA32_LIT;
+    a->queue[a->queue_len++] = 0;
+    a->queue[a->queue_len++] = 0;
+    a->queue[a->queue_len++] = 0;
+    a->queue[a->queue_len++] = 0;
+}
+
+/*
+ * Read a series of words from memory (without PE).
+ * Scripts for a batch of words are packed into as few reports
+ * as possible, and all the values are fetched by one upload.
+ */
+static void pickit_read_words(adapter_t *adapter,
+    const unsigned *addr, unsigned nwords, unsigned *data)
+{
+    pickit_adapter_t *a = (pickit_adapter_t*) adapter;
+    unsigned code1 [8], code2 [8], n1, n2, done, n, i;
+    unsigned char *p;
+
+    if (nwords == 0)
+        return;
+    if (! a->serial_execution_mode) {
+        /* First read after entering serial execution
+         * needs a workaround for PIC32MM. */
+        *data++ = pickit_read_word(adapter, *addr++);
+        nwords--;
+    }
+
+    pickit_finish_rows(a);
+    for (done=0; done<nwords; done+=n) {
+        n = nwords - done;
+        if (n > READ_WORDS_BATCH)
+            n = READ_WORDS_BATCH;
+
+        pickit_queue(a, 1, CMD_CLEAR_UPLOAD_BUFFER);
+        for (i=0; i<n; i++) {
+            unsigned addr_lo = addr[done+i] & 0xFFFF;
+            unsigned addr_hi = (addr[done+i] >> 16) & 0xFFFF;
+
+            /* Same instructions as in pickit_read_word(). */
+            if (FAMILY_MM != a->adapter.family_name_short) {
+                code1[0] = 0x3c13ff20;                  // lui s3, 0xFF20
+                code1[1] = 0x3c080000 | addr_hi;        // lui t0, addr_hi
+                code1[2] = 0x35080000 | addr_lo;        // ori t0, addr_lo
+                code1[3] = 0x8d090000;                  // lw t1, 0(t0)
+                memcpy(code2, code1, 4 * sizeof(unsigned));
+                code1[4] = 0xae690000;                  // sw t1, 0(s3)
+                code1[5] = 0;                           // nop
+                n1 = 6;
+                code2[4] = 0x00094842;                  // srl t1, 1
+                code2[5] = 0xae690004;                  // sw t1, 4(s3)
+                code2[6] = 0;                           // nop
+                n2 = 7;
+            } else {
+                code1[0] = 0xFF2041B3;                  // lui s3, FAST_DATA_REG(32:16)
+                code1[1] = 0x000041A8 | (addr_hi<<16);  // lui t0, DATA_ADDRESS(31:16)
+                code1[2] = 0x00005108 | (addr_lo<<16);  // ori t0, DATA_ADDRESS(15:0)
+                code1[3] = 0x0000FD28;                  // lw t1, 0(t0)
+                memcpy(code2, code1, 4 * sizeof(unsigned));
+                code1[4] = 0x0000F933;                  // sw t1, 0(s3)
+                code1[5] = 0x0c000c00;                  // nop
+                code1[6] = 0x0c000c00;                  // nop
+                n1 = 7;
+                code2[4] = 0x08400129;                  // srl t1, 1
+                code2[5] = 0x0000F933;                  // sw t1, 0(s3)
+                code2[6] = 0x0c000c00;                  // nop
+                code2[7] = 0x0c000c00;                  // nop
+                n2 = 8;
+            }
+            pickit_queue_read_script(a, code1, n1);
+            pickit_queue_read_script(a, code2, n2);
+        }
+        pickit_queue(a, 1, CMD_UPLOAD_DATA);
+        pickit_queue_flush(a);
+        pickit_recv(a);
+        if (a->reply[0] != n * 8) {
+            fprintf(stderr, "%s: read words at %08x: bad reply length=%u\n",
+                a->name, addr[done], a->reply[0]);
+            session_abort(-1);
+        }
+
+        /* First word of every pair contains 31 bits of value in MSB;
+         * LSB bit is garbage. Second word contains the MSB bit of the value. */
+        for (i=0; i<n; i++) {
+            unsigned word1, word2;
+
+            p = a->reply + 1 + i*8;
+            word1 = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+            word2 = p[4] | (p[5] << 8) | (p[6] << 16) | (p[7] << 24);
+            data[done+i] = (word1 >> 1) | (word2 & 0x80000000);
+            if (debug_level > 0)
+                fprintf(stderr, "%s: %08x -> %08x\n", __func__,
+                    addr[done+i], data[done+i]);
+        }
+    }
+}
+
 /*
  * Read a block of memory, multiple of 1 kbyte.
  */
@@ -696,87 +993,152 @@ static void pickit_read_data(adapter_t *adapter,
     unsigned addr, unsigned nwords, unsigned *data)
 {
     pickit_adapter_t *a = (pickit_adapter_t*) adapter;
-    unsigned char buf [64];
-    unsigned words_read;
+    unsigned nruns, run, got, i, n;
+    struct timeval t0, t1;
 
 //fprintf(stderr, "%s: read %d bytes from %08x\n", a->name, nwords*4, addr);
     if (! a->use_executive) {
         /* Without PE. */
-        for (; nwords > 0; nwords--) {
-            *data++ = pickit_read_word(adapter, addr);
-            addr += 4;
+        unsigned addrs [READ_WORDS_BATCH];
+
+        for (; nwords > 0; nwords -= n) {
+            n = nwords;
+            if (n > READ_WORDS_BATCH)
+                n = READ_WORDS_BATCH;
+            for (i=0; i<n; i++)
+                addrs[i] = addr + i*4;
+            pickit_read_words(adapter, addrs, n, data);
+            data += n;
+            addr += n*4;
         }
         return;
     }
 
-    /* Use PE to read memory. */
-    for (words_read = 0; words_read < nwords; ) {
-        /* Download addresses for 8 script runs. */
-        unsigned i, k = 0;
-        memset(buf, CMD_END_OF_BUFFER, 64);
-        buf[k++] = CMD_CLEAR_DOWNLOAD_BUFFER;
-        buf[k++] = CMD_DOWNLOAD_DATA;
-        buf[k++] = 8 * 4;
-        for (i = 0; i < 8; i++) {
-            unsigned address = addr + words_read*4 + i*32*4;
-            buf[k++] = address;
-            buf[k++] = address >> 8;
-            buf[k++] = address >> 16;
-            buf[k++] = address >> 24;
+    /* Use PE to read memory.
+     * Every script run reads 32 words into the upload buffer,
+     * which is emptied by two UPLOAD_DATA_NOLEN replies.
+     * Reports with next runs are sent ahead, while the replies
+     * of the previous runs are still being read. */
+    pickit_finish_rows(a);
+    gettimeofday(&t0, 0);
+    nruns = (nwords + 31) / 32;
+    for (run = 0, got = 0; got < 2*nruns; ) {
+        if (run < nruns &&
+            2*run - got + 2*READ_RUNS_PER_REPORT <= READ_INFLIGHT) {
+            /* Send a report with next runs. */
+            for (i = 0; i < READ_RUNS_PER_REPORT && run < nruns; i++, run++) {
+                unsigned address = addr + run*32*4;
+
+                pickit_queue(a, 22, CMD_CLEAR_UPLOAD_BUFFER,
+                    CMD_EXECUTE_SCRIPT, 17,
+                        SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
+                        SCRIPT_JT2_XFRFASTDAT_LIT,
+                            0x20, 0, 1, 0,      // READ
+                        SCRIPT_JT2_XFRFASTDAT_LIT,
+                            WORD_AS_BYTES(address),
+                        SCRIPT_JT2_WAIT_PE_RESP,
+                        SCRIPT_JT2_GET_PE_RESP,
+                        SCRIPT_LOOP, 1, 31,
+                    CMD_UPLOAD_DATA_NOLEN,
+                    CMD_UPLOAD_DATA_NOLEN);
+            }
+            pickit_queue_flush(a);
+            continue;
+        }
+
+        /* Get next half of upload buffer. */
+        if (hid_read_timeout(a->hiddev, a->reply, 64, TIMO_MSEC) != 64) {
+            fprintf(stderr, "%s: error receiving data at %08x\n",
+                a->name, addr + got*64);
+            session_abort(-1);
         }
-        pickit_send_buf(a, buf, k);
-
-        for (k = 0; k < 8; k++) {
-            /* Read progmem. */
-            pickit_send(a, 17, CMD_CLEAR_UPLOAD_BUFFER,
-                CMD_EXECUTE_SCRIPT, 13,
-                    SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
-                    SCRIPT_JT2_XFRFASTDAT_LIT,
-                        0x20, 0, 1, 0,          // READ
-                    SCRIPT_JT2_XFRFASTDAT_BUF,
-                    SCRIPT_JT2_WAIT_PE_RESP,
-                    SCRIPT_JT2_GET_PE_RESP,
-                    SCRIPT_LOOP, 1, 31,
-                CMD_UPLOAD_DATA_NOLEN);
-            pickit_recv(a);
-            memcpy(data, a->reply, 64);
-//fprintf(stderr, "   ...%08x...\n", data[0]);
-            data += 64/4;
-            words_read += 64/4;
-
-            /* Get second half of upload buffer. */
-            pickit_send(a, 1, CMD_UPLOAD_DATA_NOLEN);
-            pickit_recv(a);
-            memcpy(data, a->reply, 64);
-            data += 64/4;
-            words_read += 64/4;
+        if (got*16 < nwords) {
+            n = nwords - got*16;
+            if (n > 16)
+                n = 16;
+            memcpy(data + got*16, a->reply, n*4);
         }
+        got++;
+    }
+
+    if (debug_level > 0) {
+        unsigned usec;
+
+        gettimeofday(&t1, 0);
+        usec = (t1.tv_sec - t0.tv_sec) * 1000000 + t1.tv_usec - t0.tv_usec;
+        fprintf(stderr, "%s: read %u bytes at %08x, %u bytes per second\n",
+            a->name, nwords*4, addr, usec ? (unsigned) (nwords*4*1000000ULL / usec) : 0);
     }
 }
 
 /*
- * Put data to download buffer.
- * Max 15 words (60 bytes).
+ * Get checksum of flash memory, computed by PE.
+ * Return -1 when PE is not available.
  */
-static void download_data(pickit_adapter_t *a,
-    unsigned *data, unsigned nwords, int clear_flag)
+static int pickit_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes)
 {
-    unsigned char buf [64];
-    unsigned i, k = 0;
+    pickit_adapter_t *a = (pickit_adapter_t*) adapter;
+    int crc;
 
-    memset(buf, CMD_END_OF_BUFFER, 64);
-    if (clear_flag)
-        buf[k++] = CMD_CLEAR_DOWNLOAD_BUFFER;
-    buf[k++] = CMD_DOWNLOAD_DATA;
-    buf[k++] = nwords * 4;
-    for (i=0; i<nwords; i++) {
-        unsigned word = *data++;
-        buf[k++] = word;
-        buf[k++] = word >> 8;
-        buf[k++] = word >> 16;
-        buf[k++] = word >> 24;
+    if (! a->use_executive)
+        return -1;
+
+    crc = pe_get_crc(a, addr, nbytes);
+    if (crc < 0) {
+        fprintf(stderr, "%s: failed to get checksum of %d bytes at %08x\n",
+            a->name, nbytes, addr);
+        session_abort(-1);
+    }
+    return crc;
+}
+
+static int pickit_blank_check(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    pickit_adapter_t *a = (pickit_adapter_t*) adapter;
+
+    if (! a->use_executive)
+        return -1;
+
+    return pe_blank_check(a, addr, nbytes);
+}
+
+/*
+ * Verify a block of memory.
+ * With PE, compare the checksum instead of reading the data back.
+ */
+static void pickit_verify_data(adapter_t *adapter,
+    unsigned addr, unsigned nwords, unsigned *data)
+{
+    pickit_adapter_t *a = (pickit_adapter_t*) adapter;
+    unsigned data_crc, word, i;
+    int flash_crc;
+
+    if (! a->use_executive) {
+        /* Without PE. */
+        for (i=0; i<nwords; i++) {
+            word = pickit_read_word(adapter, addr + i*4);
+            if (word != data[i]) {
+                printf("\nerror at address %08X: file=%08X, mem=%08X\n",
+                    addr + i*4, data[i], word);
+                session_abort(1);
+            }
+        }
+        return;
+    }
+
+    /* Use PE to get CRC of flash memory. */
+    flash_crc = pe_get_crc(a, addr, nwords * 4);
+    if (flash_crc < 0) {
+        fprintf(stderr, "%s: failed to verify %d words at %08x\n",
+            a->name, nwords, addr);
+        session_abort(-1);
+    }
+    data_crc = pic32_crc16(0xffff, (unsigned char*) data, nwords * 4);
+    if (flash_crc != data_crc) {
+        fprintf(stderr, "%s: checksum failed at %08x: sum=%04x, expected=%04x\n",
+            a->name, addr, flash_crc, data_crc);
+        session_abort(-1);
     }
-    pickit_send_buf(a, buf, k);
 }
 
 /*
@@ -792,7 +1154,7 @@ static void pickit_program_word(adapter_t *adapter,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
     /* Use PE to write flash memory. */
     pickit_send(a, 22, CMD_CLEAR_UPLOAD_BUFFER,
@@ -818,7 +1180,7 @@ static void pickit_program_word(adapter_t *adapter,
     if (a->reply[0] != 4 || a->reply[1] != 0) { // response code 0 = success
         fprintf(stderr, "%s: failed to program word %08x at %08x, reply = %02x-%02x-%02x-%02x-%02x\n",
             a->name, word, addr, a->reply[0], a->reply[1], a->reply[2], a->reply[3], a->reply[4]);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -835,7 +1197,7 @@ static void pickit_program_double_word(adapter_t *adapter,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
     /* Use PE to write flash memory. */
     pickit_send(a, 27, CMD_CLEAR_UPLOAD_BUFFER,
@@ -866,7 +1228,7 @@ static void pickit_program_double_word(adapter_t *adapter,
     if (a->reply[0] != 4 || a->reply[1] != 0) { // response code 0 = success
         fprintf(stderr, "%s: failed to program words %08x %08x at %08x, reply = %02x-%02x-%02x-%02x-%02x\n",
             a->name, word0, word1, addr, a->reply[0], a->reply[1], a->reply[2], a->reply[3], a->reply[4]);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -884,7 +1246,7 @@ static void pickit_program_quad_word(adapter_t *adapter, unsigned addr,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
 
     /* Use PE to write flash memory. */
@@ -926,18 +1288,56 @@ static void pickit_program_quad_word(adapter_t *adapter, unsigned addr,
     if (a->reply[0] != 4 || a->reply[1] != 0) { // response code 0 = success
         fprintf(stderr, "%s: failed to program quad word at %08x, reply = %02x-%02x-%02x-%02x-%02x\n",
             a->name, addr, a->reply[0], a->reply[1], a->reply[2], a->reply[3], a->reply[4]);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
 /*
- * Flash write row of memory.
+ * Collect PE responses of the programmed rows.
+ */
+static void pickit_finish_rows(pickit_adapter_t *a)
+{
+    unsigned i, n = a->pending_rows;
+    unsigned char *resp;
+
+    if (n == 0)
+        return;
+    a->pending_rows = 0;
+
+    /* Get response of the last row, and upload all responses. */
+    pickit_queue(a, 4, CMD_EXECUTE_SCRIPT, 1,
+            SCRIPT_JT2_GET_PE_RESP,
+        CMD_UPLOAD_DATA);
+    pickit_queue_flush(a);
+
+    pickit_recv(a);
+    if (a->reply[0] != 4*n) {
+        fprintf(stderr, "%s: failed to program row flash memory at %08x, got %u bytes of PE responses\n",
+            a->name, a->pending_addr[0], a->reply[0]);
+        session_abort(-1);
+    }
+    for (i=0; i<n; i++) {
+        resp = a->reply + 1 + 4*i;
+        if (resp[0] != 0 || resp[1] != 0) {     // response code 0 = success
+            fprintf(stderr, "%s: failed to program row flash memory at %08x, reply = %02x-%02x-%02x-%02x\n",
+                a->name, a->pending_addr[i], resp[0], resp[1], resp[2], resp[3]);
+            session_abort(-1);
+        }
+    }
+}
+
+/*
+ * Write a row of flash memory.
+ * Commands and data are packed tightly into reports.
+ * The response of a row is fetched by the script, which starts
+ * the next row, and the responses are uploaded in one report
+ * after a few rows, or when any other command is sent.
  */
 static void pickit_program_row(adapter_t *adapter, unsigned addr,
     unsigned *data, unsigned words_per_row)
 {
     pickit_adapter_t *a = (pickit_adapter_t*) adapter;
-    unsigned i;
+    unsigned i, n;
 
     if (debug_level > 0)
         fprintf(stderr, "%s: row program %u words at %08x\n",
@@ -945,71 +1345,46 @@ static void pickit_program_row(adapter_t *adapter, unsigned addr,
     if (! a->use_executive) {
         /* Without PE. */
         fprintf(stderr, "%s: slow flash write not implemented yet.\n", a->name);
-        exit(-1);
+        session_abort(-1);
     }
     /* Use PE to write flash memory. */
+    if (a->pending_rows >= PENDING_ROWS)
+        pickit_finish_rows(a);
 
-    pickit_send(a, 15, CMD_CLEAR_UPLOAD_BUFFER,
-        CMD_EXECUTE_SCRIPT, 12,
-            SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
-            SCRIPT_JT2_XFRFASTDAT_LIT,
-                words_per_row, 0, 0, 0,         // PROGRAM ROW
-            SCRIPT_JT2_XFRFASTDAT_LIT,
-                (unsigned char) addr,
-                (unsigned char) (addr >> 8),
-                (unsigned char) (addr >> 16),
-                (unsigned char) (addr >> 24));
-
-    /* Download data. */
-    if (words_per_row == 32) {
-        /* MX1/2 family. */
-        download_data(a, data, 15, 1);
-        download_data(a, data+15, 15, 0);
-
-        pickit_send(a, 18,
-            CMD_DOWNLOAD_DATA, 2*4,
-                WORD_AS_BYTES(data[30]),
-                WORD_AS_BYTES(data[31]),
-            CMD_EXECUTE_SCRIPT, 6,              // execute
+    if (a->pending_rows == 0) {
+        pickit_queue(a, 15, CMD_CLEAR_UPLOAD_BUFFER,
+            CMD_EXECUTE_SCRIPT, 12,
                 SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
-                SCRIPT_JT2_XFRFASTDAT_BUF,
-                SCRIPT_LOOP, 1, 31);
+                SCRIPT_JT2_XFRFASTDAT_LIT,
+                    words_per_row, 0, 0, 0,     // PROGRAM ROW
+                SCRIPT_JT2_XFRFASTDAT_LIT,
+                    WORD_AS_BYTES(addr));
     } else {
-        /* MX3/4/5/6/7 or MZ family. */
-        for (i = 0; i < words_per_row/64; i++) {
-            /* Download 256 bytes of data. */
-            download_data(a, data, 15, 1);
-            download_data(a, data+15, 15, 0);
-            download_data(a, data+30, 15, 0);
-            download_data(a, data+45, 15, 0);
-
-            pickit_send(a, 26,
-                CMD_DOWNLOAD_DATA, 4*4,
-                    WORD_AS_BYTES(data[60]),
-                    WORD_AS_BYTES(data[61]),
-                    WORD_AS_BYTES(data[62]),
-                    WORD_AS_BYTES(data[63]),
-                CMD_EXECUTE_SCRIPT, 6,              // execute
-                    SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
-                    SCRIPT_JT2_XFRFASTDAT_BUF,
-                    SCRIPT_LOOP, 1, 63);
-
-            data += 64;
-        }
+        /* Get response of the previous row. */
+        pickit_queue(a, 15,
+            CMD_EXECUTE_SCRIPT, 13,
+                SCRIPT_JT2_GET_PE_RESP,
+                SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
+                SCRIPT_JT2_XFRFASTDAT_LIT,
+                    words_per_row, 0, 0, 0,     // PROGRAM ROW
+                SCRIPT_JT2_XFRFASTDAT_LIT,
+                    WORD_AS_BYTES(addr));
     }
-
-    pickit_send(a, 5, CMD_CLEAR_UPLOAD_BUFFER,
-        CMD_EXECUTE_SCRIPT, 1,
-            SCRIPT_JT2_GET_PE_RESP,
-        CMD_UPLOAD_DATA);
-
-    pickit_recv(a);
-    //fprintf(stderr, "%s: program PE response %u bytes: %02x...\n",
-    //  a->name, a->reply[0], a->reply[1]);
-    if (a->reply[0] != 4 || a->reply[1] != 0) { // response code 0 = success
-        fprintf(stderr, "%s: failed to program row flash memory at %08x, reply = %02x-%02x-%02x-%02x-%02x\n",
-            a->name, addr, a->reply[0], a->reply[1], a->reply[2], a->reply[3], a->reply[4]);
-        exit(-1);
+    a->pending_addr [a->pending_rows++] = addr;
+
+    /* Download data, by 256 bytes (MX3/4/5/6/7 or MZ family)
+     * or by 128 bytes (MX1/2 family). */
+    for (i = 0; i < words_per_row; i += n) {
+        n = words_per_row - i;
+        if (n > 64)
+            n = 64;
+        pickit_queue(a, 1, CMD_CLEAR_DOWNLOAD_BUFFER);
+        pickit_queue_data(a, data + i, n);
+        pickit_queue(a, 8,
+            CMD_EXECUTE_SCRIPT, 6,              // execute
+                SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
+                SCRIPT_JT2_XFRFASTDAT_BUF,
+                SCRIPT_LOOP, 1, n - 1);
     }
 }
 
@@ -1027,6 +1402,43 @@ static void pickit_erase_chip(adapter_t *adapter)
         SCRIPT_JT2_XFERDATA8_LIT, MCHP_ERASE,
         SCRIPT_DELAY_LONG, 74);                 // 400 msec
     check_timeout(a, "chip erase");
+
+    /* Chip erase resets the processor: serial execution
+     * mode and the PE are lost. */
+    a->serial_execution_mode = 0;
+    a->use_executive = 0;
+}
+
+/*
+ * Erase pages of flash memory.
+ */
+static void pickit_erase_page(adapter_t *adapter, unsigned addr, unsigned npages)
+{
+    pickit_adapter_t *a = (pickit_adapter_t*) adapter;
+
+    if (debug_level > 0)
+        fprintf(stderr, "%s: erase %u pages at %08x\n", a->name, npages, addr);
+    if (! a->use_executive) {
+        /* Without PE. */
+        fprintf(stderr, "%s: page erase without PE not implemented.\n", a->name);
+        session_abort(-1);
+    }
+    pickit_send(a, 17, CMD_CLEAR_UPLOAD_BUFFER,
+        CMD_EXECUTE_SCRIPT, 13,
+            SCRIPT_JT2_SENDCMD, ETAP_FASTDATA,
+            SCRIPT_JT2_XFRFASTDAT_LIT,
+                WORD_AS_BYTES(PE_PAGE_ERASE << 16 | npages),
+            SCRIPT_JT2_XFRFASTDAT_LIT,
+                WORD_AS_BYTES(addr),
+            SCRIPT_JT2_GET_PE_RESP,
+        CMD_UPLOAD_DATA);
+    pickit_recv(a);
+    if (a->reply[0] != 4 || a->reply[1] != 0 ||  // response code 0 = success
+        a->reply[3] != PE_PAGE_ERASE) {
+        fprintf(stderr, "%s: failed to erase %u pages at %08x, reply = %02x-%02x-%02x-%02x-%02x\n",
+            a->name, npages, addr, a->reply[0], a->reply[1], a->reply[2], a->reply[3], a->reply[4]);
+        session_abort(-1);
+    }
 }
 
 /*
@@ -1212,8 +1624,13 @@ static adapter_t *open_pickit(hid_device *hiddev, int is_pk3)
     a->adapter.get_idcode = pickit_get_idcode;
     a->adapter.load_executive = pickit_load_executive;
     a->adapter.read_word = pickit_read_word;
+    a->adapter.read_words = pickit_read_words;
     a->adapter.read_data = pickit_read_data;
+    a->adapter.verify_data = pickit_verify_data;
+    a->adapter.get_crc = pickit_get_crc;
+    a->adapter.blank_check = pickit_blank_check;
     a->adapter.erase_chip = pickit_erase_chip;
+    a->adapter.erase_page = pickit_erase_page;
     a->adapter.program_word = pickit_program_word;
     a->adapter.program_double_word = pickit_program_double_word;
     a->adapter.program_row = pickit_program_row;
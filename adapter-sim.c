@@ -0,0 +1,548 @@
+/*
+ * Simulated adapter: a PIC32 with flash memory in RAM.
+ * Allows to run the programming, reading and verification
+ * without hardware, and to measure the host-side costs.
+ *
+ * Port name:
+ *      sim:[cpu][,latency=usec][,rate=bytes_per_sec][,reset=msec][,file=image]
+ *
+ * cpu      - name of chip variant, or CPUID in hex; default MX795F512L
+ * latency  - delay added to every transaction with the target
+ * rate     - bandwidth of the link to the target, unlimited by default
+ * reset    - processor is reset when the link is idle that long,
+ *            like a board reset between jobs of the daemon
+ * file     - load memory from the image file at open, save at close
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+
+#include "target.h"
+#include "pic32.h"
+
+#define FLASH_BASE      0x1d000000
+#define BOOT_BASE       0x1fc00000
+#define BOOT_NBYTES     (512 * 1024)    /* Boot flash 1 and 2 of MK family */
+
+typedef struct {
+    /* Common part */
+    adapter_t adapter;
+
+    const variant_t *variant;
+    const family_t *family;
+
+    unsigned char *flash;               /* User flash, erased to 0xff */
+    unsigned char *boot;                /* Boot flash */
+    unsigned flash_nbytes;
+    char *filename;
+
+    /* Processor model */
+    int cpu_debug;                      /* Processor is in debug mode */
+    int pe_running;                     /* Processor runs the PE */
+
+    /* Adapter state, like in the real adapters */
+    int serial_execution_mode;
+    int use_executive;
+
+    /* Link model */
+    unsigned latency_usec;              /* Per transaction */
+    unsigned rate;                      /* Bytes per second, 0 - no limit */
+    unsigned reset_msec;                /* Idle time until reset, 0 - never */
+    struct timeval t_last;              /* End of last transaction */
+
+    /* Statistics */
+    unsigned ntransactions;
+    unsigned long long nbytes;
+    unsigned long long sim_usec;
+    struct timeval t0;
+} sim_adapter_t;
+
+/*
+ * Reset the processor when the link was idle too long:
+ * PE and debug mode are gone.
+ */
+static void sim_idle_reset(sim_adapter_t *a)
+{
+    struct timeval t1;
+
+    if (a->reset_msec == 0)
+        return;
+    gettimeofday(&t1, 0);
+    if ((t1.tv_sec - a->t_last.tv_sec) * 1000 +
+        (t1.tv_usec - a->t_last.tv_usec) / 1000 >= a->reset_msec) {
+        a->cpu_debug = 0;
+        a->pe_running = 0;
+    }
+}
+
+/*
+ * Account for one transaction with the target,
+ * carrying the given number of bytes over the link.
+ */
+static void sim_transaction(sim_adapter_t *a, unsigned nbytes)
+{
+    unsigned usec = a->latency_usec;
+
+    sim_idle_reset(a);
+    if (a->rate > 0)
+        usec += (unsigned long long) nbytes * 1000000 / a->rate;
+    a->ntransactions++;
+    a->nbytes += nbytes;
+    a->sim_usec += usec;
+    if (usec > 0)
+        usleep(usec);
+    if (a->reset_msec > 0)
+        gettimeofday(&a->t_last, 0);
+}
+
+/*
+ * Find memory for the given physical address range.
+ * Stop on access outside of flash memory, like a real PE would fail.
+ */
+static unsigned char *sim_memory(sim_adapter_t *a, unsigned addr, unsigned nbytes)
+{
+    addr &= 0x1fffffff;
+    if (addr >= FLASH_BASE && addr + nbytes <= FLASH_BASE + a->flash_nbytes)
+        return a->flash + addr - FLASH_BASE;
+    if (addr >= BOOT_BASE && addr + nbytes <= BOOT_BASE + BOOT_NBYTES)
+        return a->boot + addr - BOOT_BASE;
+
+    fprintf(stderr, "\nsim: bad address range %08x-%08x\n",
+        addr, addr + nbytes - 1);
+    session_abort(-1);
+}
+
+/*
+ * Write words to flash. Programming can only clear bits,
+ * so the memory must be erased before.
+ */
+static void sim_write(sim_adapter_t *a, unsigned addr,
+    unsigned *data, unsigned nwords)
+{
+    unsigned char *mem = sim_memory(a, addr, nwords * 4);
+    unsigned i, word;
+
+    for (i=0; i<nwords; i++) {
+        memcpy(&word, mem, 4);
+        if (debug_level > 0 && (word & data[i]) != data[i])
+            fprintf(stderr, "sim: write to non-erased word at %08x\n", addr + i*4);
+        word &= data[i];
+        memcpy(mem, &word, 4);
+        mem += 4;
+    }
+}
+
+/*
+ * Enter serial execution mode: reset the processor
+ * with EJTAGBOOT, so that it stops in debug mode.
+ */
+static void serial_execution(sim_adapter_t *a)
+{
+    if (a->serial_execution_mode)
+        return;
+    a->serial_execution_mode = 1;
+
+    sim_transaction(a, 4);
+    a->cpu_debug = 1;
+    a->pe_running = 0;
+}
+
+/*
+ * Execute instructions from the probe.
+ * Fail when the processor is not in debug mode,
+ * like a real one would not respond.
+ */
+static void sim_need_debug(sim_adapter_t *a, const char *op)
+{
+    sim_idle_reset(a);
+    if (! a->cpu_debug) {
+        fprintf(stderr, "\nsim: %s, but processor is not in debug mode\n", op);
+        session_abort(-1);
+    }
+}
+
+static void sim_need_pe(sim_adapter_t *a, const char *op)
+{
+    sim_idle_reset(a);
+    if (! a->pe_running) {
+        fprintf(stderr, "\nsim: %s without PE\n", op);
+        session_abort(-1);
+    }
+}
+
+static void sim_close(adapter_t *adapter, int power_on)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    struct timeval t1;
+    FILE *fd;
+    int failed = 0;
+
+    gettimeofday(&t1, 0);
+    if (a->filename) {
+        fd = fopen(a->filename, "wb");
+        if (! fd) {
+            failed = 1;
+        } else {
+            if (fwrite(a->flash, 1, a->flash_nbytes, fd) != a->flash_nbytes ||
+                fwrite(a->boot, 1, BOOT_NBYTES, fd) != BOOT_NBYTES)
+                failed = 1;
+            if (fclose(fd) != 0)
+                failed = 1;
+        }
+        if (failed)
+            fprintf(stderr, "sim: cannot save image %s: %s\n",
+                a->filename, strerror(errno));
+    }
+
+    printf("sim: %u transactions, %llu bytes, link time %llu.%03llu sec, total %lu.%03lu sec\n",
+        a->ntransactions, a->nbytes, a->sim_usec / 1000000, a->sim_usec / 1000 % 1000,
+        (long) (t1.tv_sec - a->t0.tv_sec - (t1.tv_usec < a->t0.tv_usec)),
+        (long) ((t1.tv_usec - a->t0.tv_usec + 1000000) % 1000000 / 1000));
+    free(a->flash);
+    free(a->boot);
+    free(a->filename);
+    free(a);
+    if (failed)
+        session_abort(-1);
+}
+
+/*
+ * Return the Device Identification code.
+ */
+static unsigned sim_get_idcode(adapter_t *adapter)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    sim_transaction(a, 4);
+    return a->variant->devid;
+}
+
+/*
+ * Download the programming executive: PE words over the link.
+ */
+static void sim_load_executive(adapter_t *adapter,
+    const unsigned *pe, unsigned nwords, unsigned pe_version)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    /* PE, downloaded in this session, can still be running:
+     * check it with EXEC_VERSION and GET_CRC. */
+    if (a->use_executive && a->serial_execution_mode) {
+        sim_transaction(a, 8);
+        if (a->pe_running) {
+            printf("   Loading PE: already running\n");
+            return;
+        }
+        /* Board was reset: enter serial execution again. */
+        a->serial_execution_mode = 0;
+    }
+    a->use_executive = 1;
+    serial_execution(a);
+
+    printf("   Loading PE: ");
+    fflush(stdout);
+    sim_need_debug(a, "PE download");
+    sim_transaction(a, nwords * 4);
+    a->cpu_debug = 0;
+    a->pe_running = 1;
+    printf("v%04x\n", pe_version);
+}
+
+/*
+ * Read a word from memory (without PE).
+ */
+static unsigned sim_read_word(adapter_t *adapter, unsigned addr)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    unsigned word;
+
+    serial_execution(a);
+    sim_need_debug(a, "read word");
+    sim_transaction(a, 8);
+    memcpy(&word, sim_memory(a, addr, 4), 4);
+    if (debug_level > 0)
+        fprintf(stderr, "sim: read word at %08x -> %08x\n", addr, word);
+    return word;
+}
+
+/*
+ * Read a memory block.
+ */
+static void sim_read_data(adapter_t *adapter,
+    unsigned addr, unsigned nwords, unsigned *data)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    if (a->use_executive) {
+        sim_need_pe(a, "read data");
+    } else {
+        serial_execution(a);
+        sim_need_debug(a, "read data");
+    }
+    sim_transaction(a, 8 + nwords * 4);
+    memcpy(data, sim_memory(a, addr, nwords * 4), nwords * 4);
+}
+
+/*
+ * Get checksum of memory, computed by PE.
+ */
+static int sim_get_crc(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    if (! a->use_executive)
+        return -1;
+    sim_need_pe(a, "get crc");
+    sim_transaction(a, 12 + 4);
+    return pic32_crc16(0xffff, sim_memory(a, addr, nbytes), nbytes);
+}
+
+/*
+ * Check that memory is erased, using PE.
+ */
+static int sim_blank_check(adapter_t *adapter, unsigned addr, unsigned nbytes)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    unsigned char *mem;
+
+    if (! a->use_executive)
+        return -1;
+    sim_need_pe(a, "blank check");
+    sim_transaction(a, 12 + 4);
+    mem = sim_memory(a, addr, nbytes);
+    while (nbytes-- > 0)
+        if (*mem++ != 0xff)
+            return 0;
+    return 1;
+}
+
+/*
+ * Erase all flash memory. The processor is reset, so PE is lost.
+ */
+static void sim_erase_chip(adapter_t *adapter)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    sim_transaction(a, 4);
+    memset(a->flash, 0xff, a->flash_nbytes);
+    memset(a->boot, 0xff, BOOT_NBYTES);
+
+    /* Processor is reset: it leaves debug mode, and the PE is lost. */
+    a->cpu_debug = 0;
+    a->pe_running = 0;
+    a->serial_execution_mode = 0;
+    a->use_executive = 0;
+}
+
+/*
+ * Erase pages of flash memory, in units of family page size.
+ */
+static void sim_erase_page(adapter_t *adapter, unsigned addr, unsigned npages)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    unsigned page_bytes = a->family->page_bytes;
+
+    sim_need_pe(a, "page erase");
+    if (addr % page_bytes != 0) {
+        fprintf(stderr, "\nsim: unaligned page erase at %08x\n", addr);
+        session_abort(-1);
+    }
+    sim_transaction(a, 8 + 4);
+    memset(sim_memory(a, addr, npages * page_bytes), 0xff, npages * page_bytes);
+}
+
+/*
+ * Write a row of flash memory, of family row size.
+ */
+static void sim_program_row(adapter_t *adapter, unsigned addr,
+    unsigned *data, unsigned words_per_row)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    sim_need_pe(a, "row program");
+    if (words_per_row * 4 != a->family->bytes_per_row ||
+        addr % a->family->bytes_per_row != 0) {
+        fprintf(stderr, "\nsim: bad row program of %u words at %08x\n",
+            words_per_row, addr);
+        session_abort(-1);
+    }
+    sim_transaction(a, 8 + words_per_row * 4 + 4);
+    sim_write(a, addr, data, words_per_row);
+}
+
+/*
+ * Program a contiguous run of rows by one PE command.
+ */
+static void sim_program_cluster(adapter_t *adapter, unsigned addr,
+    unsigned *data, unsigned nwords)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    sim_need_pe(a, "cluster program");
+    if (! a->family->pe_cluster) {
+        fprintf(stderr, "\nsim: no PROGRAM_CLUSTER in PE of %s family\n",
+            a->family->name);
+        session_abort(-1);
+    }
+    sim_transaction(a, 12 + nwords * 4 + 4);
+    sim_write(a, addr, data, nwords);
+}
+
+static void sim_program_word(adapter_t *adapter,
+    unsigned addr, unsigned word)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+
+    sim_need_pe(a, "word program");
+    sim_transaction(a, 12 + 4);
+    sim_write(a, addr, &word, 1);
+}
+
+static void sim_program_double_word(adapter_t *adapter,
+    unsigned addr, unsigned word0, unsigned word1)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    unsigned data[2] = { word0, word1 };
+
+    sim_need_pe(a, "double word program");
+    sim_transaction(a, 16 + 4);
+    sim_write(a, addr, data, 2);
+}
+
+static void sim_program_quad_word(adapter_t *adapter, unsigned addr,
+    unsigned word0, unsigned word1, unsigned word2, unsigned word3)
+{
+    sim_adapter_t *a = (sim_adapter_t*) adapter;
+    unsigned data[4] = { word0, word1, word2, word3 };
+
+    sim_need_pe(a, "quad word program");
+    sim_transaction(a, 24 + 4);
+    sim_write(a, addr, data, 4);
+}
+
+/*
+ * Parse the port name and find the chip variant.
+ */
+static int sim_configure(sim_adapter_t *a, const char *spec, const variant_t *tab)
+{
+    char buf[256], *p, *next;
+    const char *cpu = "MX795F512L";
+    unsigned id = 0;
+    int i;
+
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    for (p = buf; p; p = next) {
+        next = strchr(p, ',');
+        if (next)
+            *next++ = 0;
+
+        if (strncmp(p, "latency=", 8) == 0)
+            a->latency_usec = strtoul(p + 8, 0, 0);
+        else if (strncmp(p, "rate=", 5) == 0)
+            a->rate = strtoul(p + 5, 0, 0);
+        else if (strncmp(p, "reset=", 6) == 0)
+            a->reset_msec = strtoul(p + 6, 0, 0);
+        else if (strncmp(p, "file=", 5) == 0)
+            a->filename = strdup(p + 5);
+        else if (*p)
+            cpu = p;
+    }
+    if (strchr(cpu, '=')) {
+        fprintf(stderr, "sim: unknown option '%s'\n", cpu);
+        return 0;
+    }
+    if (cpu[0] >= '0' && cpu[0] <= '9')
+        id = strtoul(cpu, 0, 16);
+
+    for (i=0; tab[i].devid != 0; i++) {
+        if (id ? ((id ^ tab[i].devid) & 0x0fffffff) == 0 :
+                 strcasecmp(cpu, tab[i].name) == 0)
+            break;
+    }
+    if (tab[i].devid == 0 || tab[i].flash_kbytes == 0) {
+        fprintf(stderr, "sim: unknown processor '%s'\n", cpu);
+        return 0;
+    }
+    a->variant = &tab[i];
+    a->family = tab[i].family;
+    a->flash_nbytes = tab[i].flash_kbytes * 1024;
+    return 1;
+}
+
+/*
+ * Create a simulated target.
+ * Return a pointer to a data structure, allocated dynamically.
+ * On error, return 0.
+ */
+adapter_t *adapter_open_sim(const char *spec, const variant_t *tab)
+{
+    sim_adapter_t *a;
+    FILE *fd;
+
+    a = calloc(1, sizeof(*a));
+    if (! a) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    if (! sim_configure(a, spec, tab)) {
+        free(a->filename);
+        free(a);
+        return 0;
+    }
+    a->flash = malloc(a->flash_nbytes);
+    a->boot = malloc(BOOT_NBYTES);
+    if (! a->flash || ! a->boot) {
+        fprintf(stderr, "Out of memory\n");
+        session_abort(-1);
+    }
+    memset(a->flash, 0xff, a->flash_nbytes);
+    memset(a->boot, 0xff, BOOT_NBYTES);
+
+    if (a->filename) {
+        fd = fopen(a->filename, "rb");
+        if (fd) {
+            if (fread(a->flash, 1, a->flash_nbytes, fd) != a->flash_nbytes ||
+                fread(a->boot, 1, BOOT_NBYTES, fd) != BOOT_NBYTES)
+                fprintf(stderr, "sim: %s: short image\n", a->filename);
+            fclose(fd);
+        }
+    }
+    gettimeofday(&a->t0, 0);
+
+    printf("      Adapter: Simulator, %s family, row %u bytes, page %u bytes\n",
+        a->family->name, a->family->bytes_per_row, a->family->page_bytes);
+    if (a->rate)
+        printf("         Link: latency %u usec, rate %u bytes/sec\n",
+            a->latency_usec, a->rate);
+    else if (a->latency_usec)
+        printf("         Link: latency %u usec\n", a->latency_usec);
+
+    a->adapter.block_override = 0;
+    a->adapter.flags = AD_PROBE | AD_ERASE | AD_READ | AD_WRITE;
+
+    /* User functions. */
+    a->adapter.close = sim_close;
+    a->adapter.get_idcode = sim_get_idcode;
+    a->adapter.load_executive = sim_load_executive;
+    a->adapter.read_word = sim_read_word;
+    a->adapter.read_data = sim_read_data;
+    a->adapter.get_crc = sim_get_crc;
+    a->adapter.blank_check = sim_blank_check;
+    a->adapter.erase_chip = sim_erase_chip;
+    a->adapter.erase_page = sim_erase_page;
+    a->adapter.program_row = sim_program_row;
+    a->adapter.program_cluster = sim_program_cluster;
+    a->adapter.program_word = sim_program_word;
+    a->adapter.program_double_word = sim_program_double_word;
+    a->adapter.program_quad_word = sim_program_quad_word;
+    return &a->adapter;
+}
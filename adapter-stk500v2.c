@@ -52,62 +52,90 @@
 
 #define PAGE_NBYTES             256     /* Write packet sise */
 #define READ_NBYTES             256     /* Read packet size */
+#define CMD_NBYTES              (10+PAGE_NBYTES) /* Max command size */
 
-extern unsigned int alternate_speed;
+#define WINDOW                  3       /* Max commands in flight */
 
 typedef struct {
     /* Common part */
     adapter_t adapter;
 
+    serial_t        *port;
     int             first_time;
     int             timeout_msec;
     unsigned        baud;
+    unsigned        alt_baud;           /* Requested alternate baud rate */
     unsigned char   sequence_number;
     unsigned char   page_addr_fetched;
     unsigned        page_addr;
     unsigned        last_load_addr;
     unsigned char   page [PAGE_NBYTES];
 
+    /* Commands sent ahead, with reply not received yet */
+    int             window;             /* Max in flight, 1 for stop-and-wait */
+    int             npending;
+    struct {
+        unsigned char   seq;
+        int             cmdlen;
+        unsigned        addr;
+        unsigned char   cmd [CMD_NBYTES];
+    } pending [WINDOW];
 } stk_adapter_t;
 
 /*
- * Send the command sequence and get back a response.
+ * Send a command, assembled into one frame with header and checksum.
+ * Return the sequence number.
  */
-static int send_receive(stk_adapter_t *a, unsigned char *cmd, int cmdlen,
-    unsigned char *response, int reply_len)
+static unsigned char stk_send(stk_adapter_t *a, unsigned char *cmd, int cmdlen)
 {
-    unsigned char *p, sum, hdr [5];
-    int len, i, got, rlen, retry = 0;
-again:
-    /*
-     * Prepare header and checksum.
-     */
-    hdr[0] = MESSAGE_START;
-    hdr[1] = ++a->sequence_number;
-    hdr[2] = cmdlen >> 8;
-    hdr[3] = cmdlen;
-    hdr[4] = TOKEN;
-    sum = hdr[0] ^ hdr[1] ^ hdr[2] ^ hdr[3] ^ hdr[4];
-    for (i=0; i<cmdlen; ++i)
-        sum ^= cmd[i];
+    unsigned char frame [5+CMD_NBYTES+1], sum;
+    int i;
+
+    frame[0] = MESSAGE_START;
+    frame[1] = ++a->sequence_number;
+    frame[2] = cmdlen >> 8;
+    frame[3] = cmdlen;
+    frame[4] = TOKEN;
+    memcpy(frame+5, cmd, cmdlen);
+    sum = 0;
+    for (i=0; i<5+cmdlen; ++i)
+        sum ^= frame[i];
+    frame[5+cmdlen] = sum;
 
-    /*
-     * Send command.
-     */
     if (debug_level > 1) {
         printf("send [%d] %x-%x-%x-%x-%x",
-            5 + cmdlen + 1, hdr[0], hdr[1], hdr[2], hdr[3], hdr[4]);
+            5 + cmdlen + 1, frame[0], frame[1], frame[2], frame[3], frame[4]);
         for (i=0; i<cmdlen; ++i)
             printf("-%x", cmd[i]);
         printf("-%x\n", sum);
     }
 
-    if (serial_write(hdr, 5) < 0 ||
-        serial_write(cmd, cmdlen) < 0 ||
-        serial_write(&sum, 1) < 0) {
+    if (serial_write(a->port, frame, 5 + cmdlen + 1) < 0) {
         fprintf(stderr, "stk-send: write error\n");
-        exit(-1);
+        session_abort(-1);
     }
+    return frame[1];
+}
+
+/*
+ * Skip all incoming data.
+ */
+static void stk_flush_input(stk_adapter_t *a)
+{
+    unsigned char buf [300];
+
+    serial_read(a->port, buf, sizeof(buf), a->timeout_msec);
+}
+
+/*
+ * Get a reply with the given sequence number.
+ * Return 0 on timeout or invalid reply.
+ */
+static int stk_recv(stk_adapter_t *a, unsigned char seq,
+    unsigned char *response, int reply_len)
+{
+    unsigned char *p, sum, hdr [5];
+    int len, i, got, rlen;
 
     /*
      * Get header.
@@ -115,34 +143,26 @@ again:
     p = hdr;
     len = 0;
     while (len < 5) {
-        got = serial_read(p, 5 - len, a->timeout_msec);
+        got = serial_read(a->port, p, 5 - len, a->timeout_msec);
         if (! got)
             return 0;
 
         p += got;
         len += got;
     }
-    if (hdr[0] != MESSAGE_START || hdr[1] != a->sequence_number ||
-        hdr[4] != TOKEN) {
-        /* Skip all incoming data. */
-        unsigned char buf [300];
-
-        if (retry)
+    if (hdr[0] != MESSAGE_START || hdr[1] != seq || hdr[4] != TOKEN) {
+        if (debug_level > 1)
             printf("got invalid header: %x-%x-%x-%x-%x\n",
                 hdr[0], hdr[1], hdr[2], hdr[3], hdr[4]);
-flush_input:
-        serial_read(buf, sizeof(buf), a->timeout_msec);
-        if (retry) {
-            retry = 1;
-            goto again;
-        }
+        stk_flush_input(a);
         return 0;
     }
     rlen = hdr[2] << 8 | hdr[3];
     if (rlen == 0 || rlen > reply_len) {
         printf("invalid reply length=%d, expecting %d bytes\n",
             rlen, reply_len);
-        goto flush_input;
+        stk_flush_input(a);
+        return 0;
     }
 
     /*
@@ -151,7 +171,7 @@ flush_input:
     p = response;
     len = 0;
     while (len < rlen) {
-        got = serial_read(p, rlen - len, a->timeout_msec);
+        got = serial_read(a->port, p, rlen - len, a->timeout_msec);
         if (! got)
             return 0;
 
@@ -165,7 +185,7 @@ flush_input:
     p = &sum;
     len = 0;
     while (len < 1) {
-        got = serial_read(p, 1, a->timeout_msec);
+        got = serial_read(a->port, p, 1, a->timeout_msec);
         if (! got)
             return 0;
         ++len;
@@ -185,22 +205,198 @@ flush_input:
         sum ^= response[i];
     if (sum != 0) {
         printf("invalid reply checksum\n");
-        goto flush_input;
+        stk_flush_input(a);
+        return 0;
     }
     return 1;
 }
 
+/*
+ * Check a reply to the command, which was sent ahead.
+ * Stop on error, the same way as in stop-and-wait mode.
+ */
+static void stk_check_reply(stk_adapter_t *a, int i, unsigned char *response)
+{
+    unsigned char *cmd = a->pending[i].cmd;
+
+    if (response[0] != cmd[0]) {
+        if (cmd[0] == CMD_LOAD_ADDRESS)
+            fprintf(stderr, "Load address failed.\n");
+        else
+            fprintf(stderr, "Program flash failed.\n");
+        session_abort(-1);
+    }
+    if (response[1] != STATUS_CMD_OK) {
+        if (cmd[0] == CMD_LOAD_ADDRESS) {
+            fprintf(stderr, "Load address failed.\n");
+            session_abort(-1);
+        }
+        printf("Programming flash: timeout at %#x\n", a->pending[i].addr);
+    }
+}
+
+/*
+ * Send the command sequence and get back a response,
+ * waiting for the reply.
+ */
+static int stk_exchange(stk_adapter_t *a, unsigned char *cmd, int cmdlen,
+    unsigned char *response, int reply_len)
+{
+    unsigned char seq;
+
+    seq = stk_send(a, cmd, cmdlen);
+    return stk_recv(a, seq, response, reply_len);
+}
+
+/*
+ * Make a load address command for the given word address.
+ * Return the address, converted into a flash relative one.
+ */
+static unsigned load_address_command(unsigned char *cmd, unsigned addr)
+{
+    // Convert an absolute address into a flash relative address
+    if (addr >= (0x1D000000 >> 1)) {
+        if (debug_level > 2)
+            printf("Adjusting address 0x%08x to ", addr << 1);
+        addr -= (0x1D000000 >> 1);
+        if (debug_level > 2)
+            printf("0x%08x\n", addr << 1);
+    }
+    cmd[0] = CMD_LOAD_ADDRESS;
+    cmd[1] = addr >> 24;
+    cmd[2] = addr >> 16;
+    cmd[3] = addr >> 8;
+    cmd[4] = addr;
+    return addr;
+}
+
+/*
+ * Get a reply to the oldest command in flight.
+ * When the bootloader loses commands sent ahead, switch to
+ * stop-and-wait mode and repeat all the commands in flight.
+ */
+static void stk_complete(stk_adapter_t *a)
+{
+    unsigned char response [2], load_cmd [5];
+    int i;
+
+    if (stk_recv(a, a->pending[0].seq, response, 2)) {
+        stk_check_reply(a, 0, response);
+        a->npending--;
+        memmove(&a->pending[0], &a->pending[1],
+            a->npending * sizeof(a->pending[0]));
+        return;
+    }
+
+    printf("stk: no reply to pipelined command, using stop-and-wait mode\n");
+    a->window = 1;
+    stk_flush_input(a);
+    for (i=0; i<a->npending; i++) {
+        if (a->pending[i].cmd[0] == CMD_LOAD_ADDRESS) {
+            /* Needed for the page, which is not queued yet. */
+            if (! stk_exchange(a, a->pending[i].cmd, a->pending[i].cmdlen,
+                response, 2)) {
+                fprintf(stderr, "Load address failed.\n");
+                session_abort(-1);
+            }
+            stk_check_reply(a, i, response);
+            continue;
+        }
+
+        /* The bootloader has lost track of the address:
+         * load it again for every page. */
+        load_address_command(load_cmd, a->pending[i].addr >> 1);
+        if (! stk_exchange(a, load_cmd, 5, response, 2) ||
+            response[0] != CMD_LOAD_ADDRESS ||
+            response[1] != STATUS_CMD_OK) {
+            fprintf(stderr, "Load address failed.\n");
+            session_abort(-1);
+        }
+        if (! stk_exchange(a, a->pending[i].cmd, a->pending[i].cmdlen,
+            response, 2)) {
+            fprintf(stderr, "Program flash failed.\n");
+            session_abort(-1);
+        }
+        stk_check_reply(a, i, response);
+    }
+    a->npending = 0;
+    a->last_load_addr = -1;
+}
+
+/*
+ * Get replies to all commands in flight.
+ */
+static void stk_drain(stk_adapter_t *a)
+{
+    while (a->npending > 0)
+        stk_complete(a);
+}
+
+/*
+ * Send the command sequence and get back a response.
+ */
+static int send_receive(stk_adapter_t *a, unsigned char *cmd, int cmdlen,
+    unsigned char *response, int reply_len)
+{
+    stk_drain(a);
+    return stk_exchange(a, cmd, cmdlen, response, reply_len);
+}
+
+/*
+ * Send a command with two-byte reply, without waiting for it.
+ * The reply is checked later, when the window of commands
+ * in flight is full, or before the next send_receive().
+ */
+static void stk_queue(stk_adapter_t *a, unsigned char *cmd, int cmdlen,
+    unsigned addr)
+{
+    int i;
+
+    if (a->npending >= a->window)
+        stk_complete(a);
+    i = a->npending++;
+    memcpy(a->pending[i].cmd, cmd, cmdlen);
+    a->pending[i].cmdlen = cmdlen;
+    a->pending[i].addr = addr;
+    a->pending[i].seq = stk_send(a, cmd, cmdlen);
+
+    /* In stop-and-wait mode, get the reply right now. */
+    if (a->window <= 1)
+        stk_complete(a);
+}
+
+/*
+ * Check whether the bootloader accepts commands sent ahead:
+ * send two sign-on commands at once, and expect both replies.
+ */
+static void stk_probe_window(stk_adapter_t *a)
+{
+    unsigned char response [11], seq1, seq2;
+
+    seq1 = stk_send(a, (unsigned char*)"\1", 1);
+    seq2 = stk_send(a, (unsigned char*)"\1", 1);
+    if (stk_recv(a, seq1, response, 11) &&
+        stk_recv(a, seq2, response, 11)) {
+        a->window = WINDOW;
+    } else {
+        a->window = 1;
+        stk_flush_input(a);
+    }
+    if (debug_level > 0)
+        printf("stk: %d commands in flight\n", a->window);
+}
+
 static void switch_baud(stk_adapter_t *a)
 {
     unsigned char cmd [5] = { CMD_SET_BAUD,
-        (alternate_speed) & 0xFF,
-        (alternate_speed >> 8) & 0xFF,
-        (alternate_speed >> 16) & 0xFF,
-        (alternate_speed >> 24) & 0xFF,
+        (a->alt_baud) & 0xFF,
+        (a->alt_baud >> 8) & 0xFF,
+        (a->alt_baud >> 16) & 0xFF,
+        (a->alt_baud >> 24) & 0xFF,
     };
     unsigned char response [6];
 
-    if (alternate_speed != a->baud) {
+    if (a->alt_baud != a->baud) {
         if (send_receive(a, cmd, 5, response, 6) &&
             response[0] == cmd[0] &&
             response[1] == STATUS_CMD_OK &&
@@ -209,8 +405,8 @@ static void switch_baud(stk_adapter_t *a)
             response[4] == cmd[3] &&
             response[5] == cmd[4])
         {
-            serial_baud(alternate_speed);
-            printf("    Baud rate: %d bps\n", alternate_speed);
+            serial_baud(a->port, a->alt_baud);
+            printf("    Baud rate: %d bps\n", a->alt_baud);
         } else {
             printf("    Baud rate: %d bps\n", a->baud);
         }
@@ -226,7 +422,7 @@ static unsigned char get_parameter(stk_adapter_t *a, unsigned char param) {
 
     if (! send_receive(a, cmd, 2, response, 3) || response[0] != cmd[0] || response[1] != STATUS_CMD_OK) {
         fprintf(stderr, "Error fetching parameter %d\n", param);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 1)
         printf("Value %x\n", response[2]);
@@ -242,7 +438,7 @@ static void set_parameter(stk_adapter_t *a, unsigned char param, int val) {
 
     if (! send_receive(a, cmd, 3, response, 2) || response[0] != cmd[0] || response[1] != STATUS_CMD_OK) {
         fprintf(stderr, "Error setting parameter %d\n", param);
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -263,7 +459,7 @@ static void prog_enable(stk_adapter_t *a)
     if (! send_receive(a, cmd, 12, response, 2) || response[0] != cmd[0] ||
         response[1] != STATUS_CMD_OK) {
         fprintf(stderr, "Cannot enter programming mode.\n");
-        exit(-1);
+        session_abort(-1);
     }
 }
 
@@ -290,8 +486,8 @@ static void prog_disable(stk_adapter_t *a)
     unsigned char response [2];
 
     /* Skip all incoming data. */
-    unsigned char buf [300];
-    serial_read(buf, sizeof(buf), a->timeout_msec);
+    stk_drain(a);
+    stk_flush_input(a);
 
     /* Leave programming mode; ignore errors. */
     send_receive(a, cmd, 3, response, 2);
@@ -299,36 +495,23 @@ static void prog_disable(stk_adapter_t *a)
 
 static void load_address(stk_adapter_t *a, unsigned addr)
 {
-    // Convert an absolute address into a flash relative address
-    if (addr >= (0x1D000000 >> 1)) {
-        if (debug_level > 2)
-            printf("Adjusting address 0x%08x to ", addr << 1);
-        addr -= (0x1D000000 >> 1);
-        if (debug_level > 2)
-            printf("0x%08x\n", addr << 1);
-    }
-
-    unsigned char cmd [5] = { CMD_LOAD_ADDRESS,
-        (addr >> 24), (addr >> 16), addr >> 8, addr, };
-    unsigned char response [2];
+    unsigned char cmd [5];
 
+    addr = load_address_command(cmd, addr);
     if (a->last_load_addr == addr)
         return;
 
     if (debug_level > 1)
         printf("Load address: %#x\n", addr << 1); // & 0x7f0000);
 
-    if (! send_receive(a, cmd, 5, response, 2) || response[0] != cmd[0] ||
-        response[1] != STATUS_CMD_OK) {
-        fprintf(stderr, "Load address failed.\n");
-        exit(-1);
-    }
+    /* Checked later, with the next reply. */
+    stk_queue(a, cmd, 5, addr << 1);
     a->last_load_addr = addr;
 }
 
 static void flush_write_buffer(stk_adapter_t *a)
 {
-    unsigned char cmd [10+PAGE_NBYTES] = { CMD_PROGRAM_FLASH_ISP,
+    unsigned char cmd [CMD_NBYTES] = { CMD_PROGRAM_FLASH_ISP,
         PAGE_NBYTES >> 8, PAGE_NBYTES & 0xff, 0, 0, 0, 0, 0, 0, 0 };
     unsigned char response [2];
 
@@ -344,26 +527,29 @@ static void flush_write_buffer(stk_adapter_t *a)
      * to be at least this long so that PIC32Prog will not timeout
      * during the erase cycle on that version of bootloader.
      */
+    if (debug_level > 1)
+        printf("Programming page: %#x\n", a->page_addr);
+    memcpy(cmd+10, a->page, PAGE_NBYTES);
     if (a->first_time) {
+        /* Nothing is sent ahead of the first page,
+         * and its reply is awaited. */
         a->timeout_msec = 5000;
         a->first_time = 0;
-    } else {
+        if (! send_receive(a, cmd, CMD_NBYTES, response, 2) ||
+            response[0] != cmd[0]) {
+            fprintf(stderr, "Program flash failed.\n");
+            session_abort(-1);
+        }
+        if (response[1] != STATUS_CMD_OK)
+            printf("Programming flash: timeout at %#x\n", a->page_addr);
         a->timeout_msec = 1000;
+    } else {
+        stk_queue(a, cmd, CMD_NBYTES, a->page_addr);
     }
 
-    if (debug_level > 1)
-        printf("Programming page: %#x\n", a->page_addr);
-    memcpy(cmd+10, a->page, PAGE_NBYTES);
-    if (! send_receive(a, cmd, 10+PAGE_NBYTES, response, 2) ||
-        response[0] != cmd[0]) {
-        fprintf(stderr, "Program flash failed.\n");
-        exit(-1);
-    }
-    if (response[1] != STATUS_CMD_OK)
-        printf("Programming flash: timeout at %#x\n", a->page_addr);
-
     a->page_addr_fetched = 0;
-    a->last_load_addr += PAGE_NBYTES / 2;
+    if (a->last_load_addr != (unsigned) -1)
+        a->last_load_addr += PAGE_NBYTES / 2;
 }
 
 /*
@@ -408,10 +594,11 @@ static void read_page(stk_adapter_t *a, unsigned addr,
         response[1] != STATUS_CMD_OK ||
         response[2+READ_NBYTES] != STATUS_CMD_OK) {
         fprintf(stderr, "Read page failed.\n");
-        exit(-1);
+        session_abort(-1);
     }
     memcpy(buf, response+2, READ_NBYTES);
-    a->last_load_addr += READ_NBYTES / 2;
+    if (a->last_load_addr != (unsigned) -1)
+        a->last_load_addr += READ_NBYTES / 2;
 }
 
 static void stk_close(adapter_t *adapter, int power_on)
@@ -421,7 +608,7 @@ static void stk_close(adapter_t *adapter, int power_on)
     prog_disable(a);
 
     /* restore and close serial port */
-    serial_close();
+    serial_close(a->port);
     free(a);
 }
 
@@ -476,7 +663,7 @@ static unsigned stk_read_word(adapter_t *adapter, unsigned addr)
     if (! send_receive(a, cmd, 4, response, 7) || response[0] != cmd[0] ||
         response[1] != STATUS_CMD_OK || response[6] != STATUS_CMD_OK) {
         fprintf(stderr, "Read word failed.\n");
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 1)
         printf("Read request done\n");
@@ -527,7 +714,7 @@ static void stk_verify_data(adapter_t *adapter,
         if (word != expected) {
             printf("\nerror at address %08X: file=%08X, mem=%08X\n",
                 addr + i*4, expected, word);
-            exit(1);
+            session_abort(1);
         }
     }
 }
@@ -550,7 +737,7 @@ static void stk_program_block(adapter_t *adapter,
     flush_write_buffer(a);
 }
 
-adapter_t *adapter_open_stk500v2(const char *port, int baud_rate)
+adapter_t *adapter_open_stk500v2(const char *port, int baud_rate, int alt_baud_rate)
 {
     stk_adapter_t *a;
 
@@ -560,11 +747,13 @@ adapter_t *adapter_open_stk500v2(const char *port, int baud_rate)
         return 0;
     }
     a->baud = baud_rate;
+    a->alt_baud = alt_baud_rate;
     a->first_time = 1;
     a->timeout_msec = 1000;
 
     /* Open serial port */
-    if (serial_open(port, baud_rate) < 0) {
+    a->port = serial_open(port, baud_rate);
+    if (! a->port) {
         /* failed to open serial port */
         free(a);
         return 0;
@@ -599,19 +788,24 @@ adapter_t *adapter_open_stk500v2(const char *port, int baud_rate)
         if (retry_count >= 3) {
             /* Bad reply or no device connected */
             retry_count = 0;
-            serial_close();
+            serial_close(a->port);
             usleep(200000);
-            serial_open(port, baud_rate);
+            a->port = serial_open(port, baud_rate);
+            if (! a->port) {
+                free(a);
+                return 0;
+            }
             outer_retry++;
         }
         if (outer_retry >= 2) {
+            serial_close(a->port);
             free(a);
-            serial_close();
             return 0;
         }
     }
 
     switch_baud(a);
+    stk_probe_window(a);
 
     prog_enable(a);
     a->last_load_addr = -1;
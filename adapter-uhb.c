@@ -123,11 +123,11 @@ static void uhb_command(uhb_adapter_t *a, unsigned char cmd,
     reply_len = hid_read_timeout(a->hiddev, a->reply, 64, 500);
     if (reply_len == 0) {
         fprintf(stderr, "Timed out.\n");
-        exit(-1);
+        session_abort(-1);
     }
     if (reply_len != 64) {
         fprintf(stderr, "uhb: error %d receiving packet\n", reply_len);
-        exit(-1);
+        session_abort(-1);
     }
     if (debug_level > 0) {
         fprintf(stderr, "---Recv");
@@ -41,14 +41,19 @@ struct _adapter_t {
         const unsigned *pe, unsigned nwords, unsigned pe_version);
     void (*read_data)(adapter_t *a, unsigned addr, unsigned nwords, unsigned *data);
     void (*verify_data)(adapter_t *a, unsigned addr, unsigned nwords, unsigned *data);
+    int (*get_crc)(adapter_t *a, unsigned addr, unsigned nbytes);
+    int (*blank_check)(adapter_t *a, unsigned addr, unsigned nbytes);
     void (*program_block)(adapter_t *a, unsigned addr, unsigned *data);
     void (*program_quad_word)(adapter_t *a, unsigned addr, unsigned word0,
         unsigned word1, unsigned word2, unsigned word3);
     void (*program_row)(adapter_t *a, unsigned addr, unsigned *data, unsigned words_per_row);
+    void (*program_cluster)(adapter_t *a, unsigned addr, unsigned *data, unsigned nwords);
     void (*program_word)(adapter_t *a, unsigned addr, unsigned word);
     void (*program_double_word)(adapter_t *a, unsigned addr, unsigned word0, unsigned word1);
     unsigned (*read_word)(adapter_t *a, unsigned addr);
+    void (*read_words)(adapter_t *a, const unsigned *addr, unsigned nwords, unsigned *data);
     void (*erase_chip)(adapter_t *a);
+    void (*erase_page)(adapter_t *a, unsigned addr, unsigned npages);
 };
 
 adapter_t *adapter_open_pickit2(int vid, int pid, const char *serial);
@@ -56,12 +61,25 @@ adapter_t *adapter_open_pickit3(int vid, int pid, const char *serial);
 adapter_t *adapter_open_an1388(int vid, int pid, const char *serial);
 adapter_t *adapter_open_hidboot(int vid, int pid, const char *serial);
 adapter_t *adapter_open_mpsse(int vid, int pid, const char *serial, int interface, int speed);
-adapter_t *adapter_open_bitbang(const char *port, int baud_rate);
-adapter_t *adapter_open_an1388_uart(const char *port, int baud_rate);
-adapter_t *adapter_open_stk500v2(const char *port, int baud_rate);
+adapter_t *adapter_open_bitbang(const char *port, int baud_rate, int alt_baud_rate);
+adapter_t *adapter_open_bitbang2(const char *port, int baud_rate, int alt_baud_rate);
+adapter_t *adapter_open_an1388_uart(const char *port, int baud_rate, int alt_baud_rate);
+adapter_t *adapter_open_stk500v2(const char *port, int baud_rate, int alt_baud_rate);
 adapter_t *adapter_open_uhb(int vid, int pid, const char *serial);
 
 void mdelay(unsigned msec);
-extern int debug_level;
+
+/*
+ * Stop the operation: return to the caller of the library
+ * with the given status (0 when the work is complete),
+ * or exit the program when no library call is active.
+ */
+void session_abort(int status) __attribute__((noreturn));
+
+/*
+ * Trace level of adapter protocols, taken from the session,
+ * which runs in this thread.
+ */
+extern __thread int debug_level;
 
 #endif
@@ -43,6 +43,9 @@
  * '@' : return A0..A5 inputs as 6 lines of text, null terminated after last line
  * '?' : return ID string, "ascii ICSP v1X"
  *
+ * '#' : XferFastData of a whole word, packed into the next 6 characters
+ * '*' : XferFastData of a run of 0xFFFFFFFF words, count in next character
+ *
  * note 1: version number is a single numeric digit followed by single UC letter
  *         if backwards compatibility preserved then only letter needs to change
  *         if compatibility is broken then digit should increment, ie 1D -> 2A
@@ -69,6 +72,18 @@
  #
  # the above additions first introduced in version 1E
  # 4-bit encoding reduces the symbol stream length by around 70%
+ #
+ # addendum: '#' encodes a whole XferFastData word: header 'edd' with PrAcc
+ #           accumulated on the last bit, 33 TDI bits (a 0, then 32 data bits
+ #           with TMS = 1 on the last one) and footer 'ed'. the 32 data bits
+ #           follow as 6 characters '0'..'o', 6 bits per symbol, LSB first
+ #           '*' encodes a run of XferFastData words of 0xFFFFFFFF, as above.
+ #           the run length minus one follows as a single character '0'..'o'
+ #           '=' also returns PrAcc accumulated by '#' and '*'
+ #
+ # the above additions first introduced in version 1F
+ # a data word takes 7 symbols instead of 11, a run of up to 64 erased
+ # words takes 2 symbols
 
 
 Interface pins on Arduino:
@@ -257,6 +272,31 @@ int clock4( int TDI, int TMS)
 }
 
 
+int nextchar()                      // wait for an operand character
+{
+  while (!Serial.available());
+  return Serial.read();
+}
+
+
+void fastword(unsigned long W)      // XferFastData of one 32-bit word
+{
+  clock4(0, 1);                                 // header 1-0-0
+  clock4(0, 0);
+  if (!clock4(0, 0)) PrAcc = 0;                 // remember if any error ('0')
+
+  clock4(0, 0);                                 // TDI = 0 for PrAcc bit
+  for (int i = 0; i < 32; i++)
+  {
+    clock4(W & 1, i == 31);                     // TMS = 1 on last bit
+    W >>= 1;
+  }
+
+  clock4(0, 1);                                 // footer 1-0
+  clock4(0, 0);
+}
+
+
 void loop()
 {
 
@@ -349,6 +389,22 @@ void loop()
         if (!clock4(0, 0)) PrAcc = 0;           // remember if any error ('0')
       break;
 
+      case '#':                                 // whole XferFastData word
+      {
+        unsigned long W = 0;
+        for (int i = 0; i < 36; i += 6)         // 6 symbols, LSB first
+          W |= (unsigned long)((nextchar() - '0') & 0x3F) << i;
+        fastword(W);
+      }
+      break;
+
+      case '*':                                 // run of 0xFFFFFFFF words
+      {
+        int N = ((nextchar() - '0') & 0x3F) + 1;
+        while (N--) fastword(0xFFFFFFFF);
+      }
+      break;
+
 // '>', '.', '=': handshake and formatting commands, placed here for possible speed
 
       case '>':                                 // request a sync response of '<'
@@ -452,7 +508,7 @@ void loop()
       break;
 
       case '?':                                 // return ID string, "ascii ICSP v1X"
-        Serial.print("ascii ICSP v1E");
+        Serial.print("ascii ICSP v1F");
       break;
 
       default: tone(SPKR, 440, 1000);           // invalid input - beep on pin 10
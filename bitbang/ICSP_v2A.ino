@@ -0,0 +1,431 @@
+//
+// NOTE: this code requires that SERIAL_RX_BUFFER_SIZE be set to 1024 in
+// C:\Program Files\Arduino\hardware\arduino\avr\cores\arduino\HardwareSerial.h
+//
+
+/* binary ICSP implementation for the Arduino NANO
+ * based on ascii ICSP (c) Robert Rozee  2015
+ *
+ * reference firmware for the "bitbang2:" protocol of pic32prog. TMS/TDI
+ * sequences are sent as bit-packed binary frames, and TDO is returned as
+ * raw bits. other commands are the same single characters as in ascii ICSP
+ *
+ * binary shift frame (all opcodes are below 0x20, all ascii commands above):
+ *
+ * 0x10 + R, Ntms, TMS bytes, Ntdi, TDI bytes
+ *
+ *   Ntms  : number of TMS bits (TDI = 0), sent first
+ *   Ntdi  : number of TDI bits; if not zero, they are sent with header
+ *           TMS = 1-0-0 before and footer TMS = 1-0 after, TMS = 1 on the
+ *           last TDI bit (the same as 'a', 'i'..'x', 'z' in ascii ICSP)
+ *   bytes : (N + 7) / 8 bytes each, LSB first
+ *
+ *   R = 0 : no response
+ *   R = 1 : respond with TDO of the last header bit and of the first Ntdi-1
+ *           TDI bits, packed LSB first into (Ntdi + 7) / 8 bytes
+ *   R = 2 : respond with one byte, TDO of the last header bit (PrAcc)
+ *   R = 3 : accumulate TDO of the last header bit into PrAcc, no response
+ *
+ * other commands:
+ *
+ * '.' : no operation, used for formatting
+ * '>' : request a sync response of '<'
+ * '=' : retrieve accumulated PrAcc value as '0' or '1', then set PrAcc = 1
+ *
+ * '0' : clock out a 0 on PGD pin
+ * '1' : clock out a 1 on PGD pin
+ * '-' : clock in single PGD bit	(*** for other device families)
+ *
+ * '2' : set MCLR low
+ * '3' : set MCLR hi-Z
+ *
+ * '4' : turn Vcc (power to target) OFF
+ * '5' : turn Vcc (power to target) ON
+ *
+ * '6' : turn Vpp OFF, RST ON		(*** for other device families)
+ * '7' : turn RST OFF, Vpp ON		(*** for other device families)
+
+ * '8' : insert 10mS delay
+ * '@' : return A0..A5 inputs in millivolts as 6 lines of text, null terminated
+ * '?' : return ID string, "ascii ICSP v2A"
+ *
+ * note 1: version number follows ascii ICSP. the digit is 2, as the TMS/TDI
+ *         codes of version 1 are replaced by binary frames
+ *
+ * note 2: a 33-bit XferFastData takes 8 bytes (11 characters in ascii ICSP
+ *         v1E), and the reply to a 32-bit read is 4 bytes (12 characters)
+
+
+Interface pins on Arduino:
+-------------------------
+PGC    : (D2) open collector output, 3k3 pullup to Vcc (3v3)
+PGD    : (D3) open collector output, 3k3 pullup to Vcc (3v3)
+MCLR   : (D4) open collector output, pullup should be on target
+
+Vcc (multiple pins) : fed from multiple 5v output pins via current limiting
+resistors (100r, 17mA ea), with a 3v3 zener diode to ground. alternatively,
+replace zener with 3v3 LDO regulator and make resistor values smaller (22r
+should do)
+
+RST    : (8) base drive for external MCLR switching transistor
+Vpp    : (9) drive for external Vpp switching opto coupler
+
+RST and Vpp are mutually exclusive. if an HV programmer is implemented it
+should have it's own seperate ICSP header. Vpp should NEVER be on the same
+header as MCLR to prevent the risk of damaging the 328p
+
+
+2-wire, 4-phase transaction:
+---------------------------
+PGD := TDI
+pulse PGC high
+PGD := TMS
+pulse PGC high
+PGD := 1 (hi-Z with 3k3 pullup)
+pulse PGC high
+TDO := PGD
+pulse PGC high
+
+
+Enter ICSP mode:
+---------------
+MCLR := 0
+PGD := 0
+PGC := 0
+Vcc := 1		(apply power to target, wait 50mS to stabilize)
+pulse MCLR high
+(pause P18)
+clock out "MCHP" signature
+(pause P19)
+MCLR := 1
+(pause P7)
+
+command string: "5.88888.32.8.0100.1101.0100.0011.0100.1000.0101.0000.8.3.8"
+
+
+Exit ICSP mode:
+--------------
+MCLR := 0	(hold target in reset)
+Vcc := 0	(target now powered down)
+
+command string: "88888.4"    (first wait 50mS to ensure target is no longer busy)
+
+
+Using an Arduino NANO just as a USB to serial bridge:
+----------------------------------------------------
+if pins 28 and 29 are jumpered together (RESET and GND) then the 328p will be
+held in reset with the processors TxD and RxD pins hi-Z. while in this state the
+USB to serial bridge portion of the Nano can be used for communicating with a
+target processor
+
+if pins 28 and 27 are jumpered together, resetting via the USB serial port will
+be disabled. if not jumpered, opening the port on some systems may cause one or
+more resets, delaying the 328p being able to respond to commands. remember that
+the jumper must be removed to upload new firmware, and that while fitted NEVER
+press the onboard reset button
+
+
+Arduino code:
+************/
+
+
+int PGC  = 2;
+int PGD  = 3;
+int MCLR = 4;
+int Vcc1 = 5;
+int Vcc2 = 6;
+int Vcc3 = 7;
+int RST  = 8;
+int Vpp  = 9;
+int SPKR = 10;
+int LED  = 13;
+
+int LEDxx = 0;                      // LED blink counter
+int PrAcc = 1;                      // accumulated PrAcc flag
+
+void setup()
+{
+  digitalWrite(PGC, LOW);           // PGC, open collector /w 3k3 pullup
+  digitalWrite(PGD, LOW);           // PGD, open collector /w 3k3 pullup
+  digitalWrite(MCLR, LOW);          // MCLR, open collector /w 3k3 pullup
+  pinMode(PGC, OUTPUT);             // PGC = 0
+  pinMode(PGD, OUTPUT);             // PGD = 0
+  pinMode(MCLR, OUTPUT);            // MCLR = 0
+
+  digitalWrite(RST, HIGH);
+  digitalWrite(Vpp, LOW);
+  digitalWrite(LED, LOW);
+  pinMode(RST, OUTPUT);             // not MCLR (to drive base of NPN OC)
+  pinMode(Vpp, OUTPUT);             // Vpp enable output (use optocoupler)
+  pinMode(LED, OUTPUT);             // status LED on arduino
+
+  Serial.begin(115200, SERIAL_8N1);
+//  38400, 115200, 230400, 256000, 460800, 921600, 250000, 500000, 1000000
+//          (ok)   (fail)  (fail)                   (ok)    (ok)     (ok)
+//          2:34                                    1:53    1:54     1:54
+}
+
+
+long readVcc()                      // Read 1.1V reference against AVcc
+{
+  long result;
+  ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+  delay(2); // Wait for Vref to settle
+  ADCSRA |= _BV(ADSC); // Convert
+  while (bit_is_set(ADCSRA,ADSC));
+  result = ADCL;
+  result |= ADCH<<8;
+  result = 1126400L / result;       // Back-calculate AVcc in mV
+  return result;
+}
+
+
+int clock1(int D)
+{
+//if (D) pinMode(PGD, INPUT);                   // PGD = hi-Z
+//  else pinMode(PGD, OUTPUT);                  // PGD = 0
+//pinMode(PGC, INPUT);                          // HIGH (via 3k3 pullup)
+//pinMode(PGC, OUTPUT);                         // LOW
+
+// below lines use direct port manipulation to improve speed
+
+  if (D) DDRD &= B11110111;                     // PGD = hi-Z
+    else DDRD |= B00001000;                     // PGD = 0
+  delayMicroseconds(1);
+  DDRD &= B11111011;                            // HIGH (via 3k3 pullup)
+  delayMicroseconds(1);
+  DDRD |= B00000100;                            // LOW
+  delayMicroseconds(1);
+
+  int B = ((PIND & B00001000) >> 3);
+  return B;
+}
+
+
+int clock4( int TDI, int TMS)
+{
+// phase 1
+  if (TDI) DDRD &= B11110111;                   // PGD = hi-Z
+      else DDRD |= B00001000;                   // PGD = 0
+  delayMicroseconds(1);
+  DDRD &= B11111011;                            // HIGH (via 3k3 pullup)
+  delayMicroseconds(1);
+  DDRD |= B00000100;                            // LOW
+  delayMicroseconds(1);
+
+// phase 2
+  if (TMS) DDRD &= B11110111;                   // PGD = hi-Z
+      else DDRD |= B00001000;                   // PGD = 0
+  delayMicroseconds(1);
+  DDRD &= B11111011;                            // HIGH (via 3k3 pullup)
+  delayMicroseconds(1);
+  DDRD |= B00000100;                            // LOW
+  delayMicroseconds(1);
+
+// phase 3
+  DDRD &= B11110111;                            // PGD = hi-Z (input)
+  delayMicroseconds(1);
+  DDRD &= B11111011;                            // HIGH (via 3k3 pullup)
+  delayMicroseconds(1);
+  DDRD |= B00000100;                            // LOW
+  delayMicroseconds(1);
+
+// read TDO
+  int B = ((PIND & B00001000) >> 3);
+
+// phase 4
+  DDRD &= B11111011;                            // HIGH (via 3k3 pullup)
+  delayMicroseconds(1);
+  DDRD |= B00000100;                            // LOW
+
+  return B;
+}
+
+
+
+int nextchar()                      // wait for an operand byte
+{
+  while (!Serial.available());
+  return Serial.read();
+}
+
+
+void shift(int R)                   // binary shift frame, R = read mode
+{
+  byte D[8];
+  byte Q[8];
+  int N, i, B;
+  unsigned int TMS = 0;
+
+  N = nextchar();                               // TMS bits, TDI = 0
+  for (i = 0; i < N; i += 8)
+    TMS |= nextchar() << i;
+  for (i = 0; i < N; i++)
+  {
+    clock4(0, TMS & 1);
+    TMS >>= 1;
+  }
+
+  N = nextchar();                               // TDI bits
+  if (N == 0) return;
+  for (i = 0; i < N; i += 8)
+    D[i >> 3] = nextchar();
+
+  clock4(0, 1);                                 // header 1-0-0
+  clock4(0, 0);
+  B = clock4(0, 0);
+  if (R == 2) Serial.write((byte)B);
+  if (R == 3 && !B) PrAcc = 0;                  // remember if any error ('0')
+
+  memset(Q, 0, sizeof(Q));
+  Q[0] = B;
+  for (i = 0; i < N; i++)
+  {
+    B = clock4((D[i >> 3] >> (i & 7)) & 1, i == N-1);
+    if (i < N-1) Q[(i+1) >> 3] |= B << ((i+1) & 7);
+  }
+
+  clock4(0, 1);                                 // footer 1-0
+  clock4(0, 0);
+
+  if (R == 1) Serial.write(Q, (N + 7) / 8);
+}
+
+
+void loop()
+{
+
+//if (LEDxx == 0) digitalWrite(LED, HIGH);      // turn status LED ON
+//if (LEDxx == 3) digitalWrite(LED, LOW);       // turn status LED OFF
+  if (LEDxx == 0) PORTB |= B00100000;           // turn status LED ON
+  if (LEDxx == 3) PORTB &= B11011111;           // turn status LED OFF
+  LEDxx = ++LEDxx & 0x001F;
+
+  char ch;
+
+  while (Serial.available())                    // loop while data in buffer
+  {
+    int I = Serial.read();
+
+    if ((I & 0xFC) == 0x10)                     // binary shift frame
+      shift(I & 3);
+    else
+    switch (char(I))
+    {
+
+// '>', '.', '=': handshake and formatting commands, placed here for possible speed
+
+      case '>':                                 // request a sync response of '<'
+        Serial.print('<');
+      break;
+
+      case '=':                                 // retrieve value of PrAcc
+        Serial.print(PrAcc ? '1' : '0');
+        PrAcc = 1;                              // reset to default
+      break;
+
+      case '.':                                 // no operation, used for formatting
+      break;
+
+// '0','1': used to clock out "MCHP" signature for ICSP entry
+
+      case '0':                                 // clock out a 0 bit on PGD pin
+        clock1(0);                              // PGD = 0
+      break;
+
+      case '1':                                 // clock out a 1 bit on PGD pin
+        clock1(1);                              // PGD = 1
+      break;
+
+      case '-':                                 // clock in single PGD bit
+        ch = '0' + clock1(1);
+        Serial.print(ch);
+      break;
+
+// the remaining commands have no great speed requirements, therefore can use
+// the slower arduino library routines for pinMode, digitalWrite, analogRead
+
+// '2','3': pulse MCLR high, clock out signature, set MCLR high
+
+      case '2':                                 // set MCLR low
+        pinMode(MCLR, OUTPUT);                  // MCLR = 0
+      break;
+
+      case '3':                                 // set MCLR high
+        pinMode(MCLR, INPUT);                   // MCLR = 1
+      break;
+
+// '4','5': control power supply to target
+
+      case '4':                                 // turn power to target OFF
+        pinMode(PGC, OUTPUT);                   // PGC = 0
+        pinMode(PGD, OUTPUT);				// PGD = 0
+        pinMode(MCLR, OUTPUT);                  // hold target in reset
+
+        pinMode(Vcc1, INPUT);                   // hi-Z
+        pinMode(Vcc2, INPUT);                   // hi-Z
+        pinMode(Vcc3, INPUT);                   // hi-Z
+//      DDRD &= B00011111;
+      break;
+
+      case '5':                                 // turn power to target ON
+        pinMode(PGC, OUTPUT);                   // PGC = 0
+        pinMode(PGD, OUTPUT);                   // PGD = 0
+        pinMode(MCLR, OUTPUT);                  // hold target in reset
+
+        digitalWrite(Vcc1, HIGH);               // Vcc1 )
+        digitalWrite(Vcc2, HIGH);               // Vcc2 )  reset to +5v
+        digitalWrite(Vcc3, HIGH);               // Vcc3 )
+
+        pinMode(Vcc1, OUTPUT);                  // +5v
+        pinMode(Vcc2, OUTPUT);                  // +5v
+        pinMode(Vcc3, OUTPUT);                  // +5v
+//      DDRD |= B11100000;
+      break;
+
+// HV programming commands, for older device families that require Vpp
+
+      case '6':                                 // turn OFF Vpp, hold in reset
+        digitalWrite(Vpp, LOW);			            // Vpp = 0 (Vpp OFF)
+        delay (1);                              // 1mS delay
+        digitalWrite(RST, HIGH);                // RST = 1 (hold in reset)
+      break;
+
+      case '7':                                 // release reset, turn ON Vpp
+        digitalWrite(RST, LOW);                 // RST = 0 (release reset)
+        delay (1);                              // 1mS delay
+        digitalWrite(Vpp, HIGH);                // Vpp = 1 (Vpp ON)
+      break;
+
+// miscellaneous other commands
+
+      case '8':                                 // insert 10mS delay
+        delay(10);
+      break;
+
+      case '@':                                 // output analog values
+        long Vusb;
+        Vusb = readVcc();
+        Serial.println(analogRead(A0) * Vusb / 1024);
+        Serial.println(analogRead(A1) * Vusb / 1024);
+        Serial.println(analogRead(A2) * Vusb / 1024);
+        Serial.println(analogRead(A3) * Vusb / 1024);
+        Serial.println(analogRead(A4) * Vusb / 1024);
+        Serial.println(analogRead(A5) * Vusb / 1024);
+        Serial.print((char)0x00);               // null terminated
+      break;
+
+      case '?':                                 // return ID string, "ascii ICSP v2A"
+        Serial.print("ascii ICSP v2A");
+      break;
+
+      default: tone(SPKR, 440, 1000);           // invalid input - beep on pin 10
+    }	// end of switch
+  }	// end of while
+}	// end of function loop()
+
+
+
+
+//  pinMode(pin, OUTPUT);                       // drive pin to set value
+//  pinMode(pin, INPUT);                        // hi-Z state
@@ -0,0 +1,303 @@
+/*
+ * Simulator of binary ICSP programmer (bitbang2: protocol), with
+ * a simple model of PIC32 TAP controllers attached to it.
+ * Allows to run pic32prog with bitbang2 adapter without hardware.
+ *
+ * Usage:
+ *      bitbang2-sim [-v] [-i idcode]
+ *      pic32prog -d bitbang2:/dev/pts/N ...
+ *
+ * The TAP model answers IDCODE, MCHP status and EJTAG control
+ * registers; memory reads return zeros. It is enough to detect
+ * the processor and to exercise the protocol and the handshakes.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include "pic32.h"
+
+#define B2_SHIFT        0x10    /* Shift frame, plus read mode in low bits */
+
+/*
+ * States of TAP controller.
+ */
+enum {
+    RESET, IDLE,
+    SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+    SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+static const unsigned char next_state[16][2] = {
+    /* TMS=0        TMS=1 */
+    { IDLE,         RESET     },    /* RESET */
+    { IDLE,         SELECT_DR },    /* IDLE */
+    { CAPTURE_DR,   SELECT_IR },    /* SELECT_DR */
+    { SHIFT_DR,     EXIT1_DR  },    /* CAPTURE_DR */
+    { SHIFT_DR,     EXIT1_DR  },    /* SHIFT_DR */
+    { PAUSE_DR,     UPDATE_DR },    /* EXIT1_DR */
+    { PAUSE_DR,     EXIT2_DR  },    /* PAUSE_DR */
+    { SHIFT_DR,     UPDATE_DR },    /* EXIT2_DR */
+    { IDLE,         SELECT_DR },    /* UPDATE_DR */
+    { CAPTURE_IR,   RESET     },    /* SELECT_IR */
+    { SHIFT_IR,     EXIT1_IR  },    /* CAPTURE_IR */
+    { SHIFT_IR,     EXIT1_IR  },    /* SHIFT_IR */
+    { PAUSE_IR,     UPDATE_IR },    /* EXIT1_IR */
+    { PAUSE_IR,     EXIT2_IR  },    /* PAUSE_IR */
+    { SHIFT_IR,     UPDATE_IR },    /* EXIT2_IR */
+    { IDLE,         SELECT_DR },    /* UPDATE_IR */
+};
+
+static int verbose;
+static int fd;                          /* Master side of pty */
+static unsigned idcode = 0x04a07053;    /* MX110F016B */
+
+static int state = RESET;
+static int ir = MTAP_IDCODE;
+static int etap;                        /* ETAP selected, else MTAP */
+static unsigned long long sr;           /* Shift register */
+static int sr_len;
+static int pracc = 1;                   /* Accumulated PrAcc */
+
+static unsigned long nframes, nbytes_in, nbytes_out;
+
+static const char analog[] = "3300\r\n3300\r\n0\r\n0\r\n0\r\n0\r\n";
+
+/*
+ * Load the shift register on Capture-DR.
+ */
+static void capture_dr()
+{
+    sr = 0;
+    sr_len = 32;
+    if (ir == MTAP_IDCODE) {
+        sr = idcode;
+    } else if (! etap && ir == MTAP_COMMAND) {
+        sr = MCHP_STATUS_CPS | MCHP_STATUS_CFGRDY | MCHP_STATUS_FAEN;
+        sr_len = MTAP_COMMAND_DR_NBITS;
+    } else if (etap && ir == ETAP_CONTROL) {
+        /* Processor is always waiting for the probe. */
+        sr = CONTROL_PRACC | CONTROL_PROBEN | CONTROL_PROBTRAP;
+    } else if (etap && (ir == ETAP_DATA || ir == ETAP_ADDRESS)) {
+        sr = 0;
+    } else if (etap && ir == ETAP_FASTDATA) {
+        sr = 1;                         /* PrAcc set, data zero */
+        sr_len = 33;
+    } else {
+        sr_len = 1;                     /* Bypass */
+    }
+}
+
+/*
+ * One clock of 2-wire, 4-phase transaction.
+ * Return TDO, which is the low bit of the shift register.
+ */
+static int tap_clock(int tdi, int tms)
+{
+    switch (state) {
+    case CAPTURE_DR:
+        capture_dr();
+        break;
+    case CAPTURE_IR:
+        sr = 1;
+        sr_len = 5;
+        break;
+    case SHIFT_DR:
+    case SHIFT_IR:
+        sr = (sr >> 1) | ((unsigned long long) tdi << (sr_len - 1));
+        break;
+    }
+    state = next_state[state][tms];
+
+    switch (state) {
+    case RESET:
+        ir = MTAP_IDCODE;
+        break;
+    case UPDATE_IR:
+        ir = sr & 0x1f;
+        if (ir == TAP_SW_MTAP)
+            etap = 0;
+        else if (ir == TAP_SW_ETAP)
+            etap = 1;
+        break;
+    case SHIFT_DR:
+    case SHIFT_IR:
+        return sr & 1;
+    }
+    return 0;
+}
+
+static int get_byte()
+{
+    unsigned char c;
+
+    if (read(fd, &c, 1) != 1) {
+        perror("pty read");
+        exit(-1);
+    }
+    nbytes_in++;
+    return c;
+}
+
+static void put_bytes(const void *data, int len)
+{
+    if (write(fd, data, len) != len) {
+        perror("pty write");
+        exit(-1);
+    }
+    nbytes_out += len;
+}
+
+/*
+ * Binary shift frame, the same as in ICSP_v2A.ino.
+ */
+static void shift(int r)
+{
+    unsigned char d[8], q[8];
+    unsigned tms = 0;
+    int n, i, b;
+
+    nframes++;
+    n = get_byte();                     /* TMS bits, TDI = 0 */
+    for (i = 0; i < n; i += 8)
+        tms |= get_byte() << i;
+    for (i = 0; i < n; i++) {
+        tap_clock(0, tms & 1);
+        tms >>= 1;
+    }
+
+    n = get_byte();                     /* TDI bits */
+    if (n == 0)
+        return;
+    if (n > 64) {
+        fprintf(stderr, "bad frame: %d TDI bits\n", n);
+        exit(-1);
+    }
+    for (i = 0; i < n; i += 8)
+        d[i >> 3] = get_byte();
+
+    tap_clock(0, 1);                    /* header 1-0-0 */
+    tap_clock(0, 0);
+    b = tap_clock(0, 0);
+    if (r == 2) {
+        q[0] = b;
+        put_bytes(q, 1);
+    }
+    if (r == 3 && ! b)
+        pracc = 0;
+
+    memset(q, 0, sizeof(q));
+    q[0] = b;
+    for (i = 0; i < n; i++) {
+        b = tap_clock((d[i >> 3] >> (i & 7)) & 1, i == n-1);
+        if (i < n-1)
+            q[(i+1) >> 3] |= b << ((i+1) & 7);
+    }
+
+    tap_clock(0, 1);                    /* footer 1-0 */
+    tap_clock(0, 0);
+
+    if (r == 1)
+        put_bytes(q, (n + 7) / 8);
+    if (verbose > 1)
+        printf("frame r=%d, ir=%d %s, %d bits\n", r, ir, etap ? "etap" : "mtap", n);
+}
+
+int main(int argc, char **argv)
+{
+    struct termios t;
+    const char *name;
+    int slave, c;
+
+    while ((c = getopt(argc, argv, "vi:")) != -1) {
+        switch (c) {
+        case 'v':
+            verbose++;
+            break;
+        case 'i':
+            idcode = strtoul(optarg, 0, 0);
+            break;
+        default:
+            fprintf(stderr, "Usage: bitbang2-sim [-v] [-i idcode]\n");
+            return 1;
+        }
+    }
+
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+        perror("pty");
+        return 1;
+    }
+    name = ptsname(fd);
+
+    /* Keep the slave side open, so that the master
+     * survives the close by pic32prog. */
+    slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(name);
+        return 1;
+    }
+    tcgetattr(slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+
+    printf("Binary ICSP simulator, IDCODE %08x\n", idcode);
+    printf("Use: pic32prog -d bitbang2:%s\n", name);
+    fflush(stdout);
+
+    for (;;) {
+        c = get_byte();
+        if ((c & 0xfc) == B2_SHIFT) {
+            shift(c & 3);
+            continue;
+        }
+        if (verbose > 1 && c != '.')
+            printf("command '%c'\n", c);
+
+        switch (c) {
+        case '>':                       /* sync */
+            put_bytes("<", 1);
+            break;
+        case '=':                       /* retrieve PrAcc */
+            put_bytes(pracc ? "1" : "0", 1);
+            pracc = 1;
+            break;
+        case '?':                       /* ID string */
+            put_bytes("ascii ICSP v2A", 14);
+            break;
+        case '-':                       /* clock in PGD bit */
+            put_bytes("1", 1);
+            break;
+        case '@':                       /* analog inputs, null terminated */
+            put_bytes(analog, sizeof(analog));
+            break;
+        case '4':                       /* power off */
+            if (verbose)
+                printf("power off: %lu frames, %lu bytes in, %lu bytes out\n",
+                    nframes, nbytes_in, nbytes_out);
+            state = RESET;
+            break;
+        case '5':                       /* power on */
+            if (verbose)
+                printf("power on\n");
+            state = RESET;
+            etap = 0;
+            ir = MTAP_IDCODE;
+            break;
+        case '.': case '0': case '1': case '2': case '3':
+        case '6': case '7': case '8':
+            break;
+        default:
+            fprintf(stderr, "invalid command 0x%02x\n", c);
+            break;
+        }
+        fflush(stdout);
+    }
+}
@@ -14,12 +14,23 @@
 #include <ctype.h>
 #include "target.h"
 
-static const char *confname;
-static char *bufr;
-static int bsize;
-static char *cursec;
-
-extern char *progname;
+/*
+ * State of the parser.
+ */
+typedef struct {
+    const char  *confname;
+    char        *bufr;
+    int         bsize;
+    char        *cursec;            /* Current section name */
+    variant_t   *tab;               /* Table of chip variants to update */
+    int         debug_level;
+
+    /* Parameters of the last section */
+    char        *last_section;
+    char        *family;
+    unsigned    id;
+    unsigned    flash_kbytes;
+} conf_t;
 
 /*
  * Scan to the end of a comment.
@@ -67,7 +78,8 @@ static int find_continuation(char *line, int pos)
  * Scan a parameter name (or name and value pair) and pass the value (or
  * values) to function pfunc().
  */
-static void parse_parameter(FILE *fp, void (*pfunc)(char*, char*, char*), int c)
+static void parse_parameter(conf_t *cf, FILE *fp,
+    void (*pfunc)(conf_t*, char*, char*, char*), int c)
 {
     int i = 0;          /* position withing bufr */
     int end = 0;        /* bufr[end] is current end-of-string */
@@ -76,56 +88,56 @@ static void parse_parameter(FILE *fp, void (*pfunc)(char*, char*, char*), int c)
     /* Loop until we found the start of the value */
     while (vstart == 0) {
         /* Ensure there's space for next char */
-        if (i > (bsize-2)) {
-            bsize += 1024;
-            bufr = realloc(bufr, bsize);
-            if (! bufr) {
-                fprintf(stderr, "%s: malloc failed\n", confname);
-                exit(-1);
+        if (i > (cf->bsize-2)) {
+            cf->bsize += 1024;
+            cf->bufr = realloc(cf->bufr, cf->bsize);
+            if (! cf->bufr) {
+                fprintf(stderr, "%s: malloc failed\n", cf->confname);
+                session_abort(-1);
             }
         }
         switch (c) {
         case '=':
             if (end == 0) {
-                fprintf(stderr, "%s: invalid parameter name\n", confname);
-                exit(-1);
+                fprintf(stderr, "%s: invalid parameter name\n", cf->confname);
+                session_abort(-1);
             }
-            bufr[end++] = '\0';
+            cf->bufr[end++] = '\0';
             i = end;
             vstart = end;
-            bufr[i] = '\0';
+            cf->bufr[i] = '\0';
             break;
 
         case ';':           /* comment line */
         case '#':
             c = eat_comment(fp);
         case '\n':
-            i = find_continuation(bufr, i);
+            i = find_continuation(cf->bufr, i);
             if (i < 0) {
                 /* End of line, but no assignment symbol. */
-                bufr[end]='\0';
+                cf->bufr[end]='\0';
                 fprintf(stderr, "%s: bad line, ignored: `%s'\n",
-                    confname, bufr);
+                    cf->confname, cf->bufr);
                 return;
             }
-            end = ((i > 0) && (bufr[i-1] == ' ')) ? (i-1) : (i);
+            end = ((i > 0) && (cf->bufr[i-1] == ' ')) ? (i-1) : (i);
             c = getc(fp);
             break;
 
         case '\0':
         case EOF:
-            bufr[i] = '\0';
+            cf->bufr[i] = '\0';
             fprintf(stderr, "%s: unexpected end-of-file at %s: func\n",
-                confname, bufr);
-            exit(-1);
+                cf->confname, cf->bufr);
+            session_abort(-1);
 
         default:
             if (isspace(c)) {
-                bufr[end] = ' ';
+                cf->bufr[end] = ' ';
                 i = end + 1;
                 c = eat_whitespace(fp);
             } else {
-                bufr[i++] = c;
+                cf->bufr[i++] = c;
                 end = i;
                 c = getc(fp);
             }
@@ -136,12 +148,12 @@ static void parse_parameter(FILE *fp, void (*pfunc)(char*, char*, char*), int c)
     /* Now parse the value */
     c = eat_whitespace(fp);
     while (c > 0) {
-        if (i > (bsize-2)) {
-            bsize += 1024;
-            bufr = realloc(bufr, bsize);
-            if (! bufr) {
-                fprintf(stderr, "%s: malloc failed\n", confname);
-                exit(-1);
+        if (i > (cf->bsize-2)) {
+            cf->bsize += 1024;
+            cf->bufr = realloc(cf->bufr, cf->bsize);
+            if (! cf->bufr) {
+                fprintf(stderr, "%s: malloc failed\n", cf->confname);
+                session_abort(-1);
             }
         }
         switch(c) {
@@ -153,32 +165,32 @@ static void parse_parameter(FILE *fp, void (*pfunc)(char*, char*, char*), int c)
         case '#':
             c = eat_comment(fp);
         case '\n':
-            i = find_continuation(bufr, i);
+            i = find_continuation(cf->bufr, i);
             if (i < 0)
                 c = 0;
             else {
-                for (end=i; (end >= 0) && isspace(bufr[end]); end--)
+                for (end=i; (end >= 0) && isspace(cf->bufr[end]); end--)
                     ;
                 c = getc(fp);
             }
             break;
 
         default:
-            bufr[i++] = c;
+            cf->bufr[i++] = c;
             if (! isspace(c))
                 end = i;
             c = getc(fp);
             break;
         }
     }
-    bufr[end] = '\0';
-    pfunc(cursec, bufr, &bufr [vstart]);
+    cf->bufr[end] = '\0';
+    pfunc(cf, cf->cursec, cf->bufr, &cf->bufr [vstart]);
 }
 
 /*
  * Scan a section name and remember it in `cursec'.
  */
-static void parse_section(FILE *fp)
+static void parse_section(conf_t *cf, FILE *fp)
 {
     int c, i, end;
 
@@ -187,48 +199,48 @@ static void parse_section(FILE *fp)
     i = 0;
     end = 0;
     while (c > 0) {
-        if (i > (bsize-2)) {
-            bsize += 1024;
-            bufr = realloc(bufr, bsize);
-            if (! bufr) {
-                fprintf(stderr, "%s: malloc failed\n", confname);
-                exit(-1);
+        if (i > (cf->bsize-2)) {
+            cf->bsize += 1024;
+            cf->bufr = realloc(cf->bufr, cf->bsize);
+            if (! cf->bufr) {
+                fprintf(stderr, "%s: malloc failed\n", cf->confname);
+                session_abort(-1);
             }
         }
         switch (c) {
         case ']':       /* found the closing bracked */
-            bufr[end] = '\0';
+            cf->bufr[end] = '\0';
             if (end == 0) {
-                fprintf(stderr, "%s: empty section name\n", confname);
-                exit(-1);
+                fprintf(stderr, "%s: empty section name\n", cf->confname);
+                session_abort(-1);
             }
             /* Register a section. */
-            if (cursec)
-                free(cursec);
-            cursec = strdup(bufr);
+            if (cf->cursec)
+                free(cf->cursec);
+            cf->cursec = strdup(cf->bufr);
 
             eat_comment(fp);
             return;
 
         case '\n':
-            i = find_continuation(bufr, i);
+            i = find_continuation(cf->bufr, i);
             if (i < 0) {
-                bufr [end] = 0;
+                cf->bufr [end] = 0;
                 fprintf(stderr, "%s: invalid line: '%s'\n",
-                    confname, bufr);
-                exit(-1);
+                    cf->confname, cf->bufr);
+                session_abort(-1);
             }
-            end = ((i > 0) && (bufr[i-1] == ' ')) ? (i-1) : (i);
+            end = ((i > 0) && (cf->bufr[i-1] == ' ')) ? (i-1) : (i);
             c = getc(fp);
             break;
 
         default:
             if (isspace(c)) {
-                bufr[end] = ' ';
+                cf->bufr[end] = ' ';
                 i = end + 1;
                 c = eat_whitespace(fp);
             } else {
-                bufr[i++] = c;
+                cf->bufr[i++] = c;
                 end = i;
                 c = getc(fp);
             }
@@ -240,10 +252,8 @@ static void parse_section(FILE *fp)
 /*
  * This function is called for every parameter found in the config file.
  */
-static void configure_parameter(char *section, char *param, char *value)
+static void configure_parameter(conf_t *cf, char *section, char *param, char *value)
 {
-    static char *last_section = 0, *family;
-    static unsigned id, flash_kbytes;
     char *ep;
 
     //printf("Configure: [%s] %s = %s\n", section, param, value);
@@ -252,78 +262,84 @@ static void configure_parameter(char *section, char *param, char *value)
          * This is the case for the initial part of config file.
          * Usually some generic parameters are placed here. */
         fprintf(stderr, "%s: Unknown parameter: %s = %s\n",
-            confname, param, value);
+            cf->confname, param, value);
         return;
     }
 
-    if (last_section && strcmp(section, last_section) != 0) {
+    if (cf->last_section && strcmp(section, cf->last_section) != 0) {
         /* Last section finished.
          * Use collected data to add a new CPU variant. */
-        if (! id || ! family || ! flash_kbytes) {
+        if (! cf->id || ! cf->family || ! cf->flash_kbytes) {
             fprintf(stderr, "%s: Not enough parameters for section %s\n",
-                confname, last_section);
+                cf->confname, cf->last_section);
         } else
-            target_add_variant(last_section, id, family, flash_kbytes);
+            target_add_variant(cf->tab, cf->last_section, cf->id,
+                cf->family, cf->flash_kbytes);
 
-        free(last_section);
-        last_section = 0;
+        free(cf->last_section);
+        cf->last_section = 0;
     }
 
     if (! param) {
         /* No parameter name: end of file reached. */
-        free(last_section);
-        last_section = 0;
-        if (family) {
-            free(family);
-            family = 0;
+        free(cf->last_section);
+        cf->last_section = 0;
+        if (cf->family) {
+            free(cf->family);
+            cf->family = 0;
         }
         return;
     }
 
     /* Store the section name. */
-    if (! last_section)
-        last_section = strdup(section);
+    if (! cf->last_section)
+        cf->last_section = strdup(section);
 
     /* We have a new parameter for the current section. */
     if (strcasecmp(param, "id") == 0) {
-        id = strtoul(value, 0, 0);
-        if (debug_level > 1)
-            printf("[%s] Id = %07x\n", section, id);
+        cf->id = strtoul(value, 0, 0);
+        if (cf->debug_level > 1)
+            printf("[%s] Id = %07x\n", section, cf->id);
 
     } else if (strcasecmp(param, "family") == 0) {
-        if (family)
-            free(family);
-        family = strdup(value);
-        if (debug_level > 1)
-            printf("[%s] Family = %s\n", section, family);
+        if (cf->family)
+            free(cf->family);
+        cf->family = strdup(value);
+        if (cf->debug_level > 1)
+            printf("[%s] Family = %s\n", section, cf->family);
 
     } else if (strcasecmp(param, "flash") == 0) {
-        flash_kbytes = strtoul(value, &ep, 0);
+        cf->flash_kbytes = strtoul(value, &ep, 0);
         if (*ep == 'k' || *ep == 'K') {
             /* Size in kilobytes. */
         } else if (*ep == 'm' || *ep == 'M') {
             /* Size in megabytes. */
-            flash_kbytes *= 1024;
+            cf->flash_kbytes *= 1024;
         } else {
             fprintf(stderr, "%s: Invalid Flash size: %s\n",
-                confname, value);
+                cf->confname, value);
         }
-        if (debug_level > 1)
-            printf("[%s] Flash = %uk\n", section, flash_kbytes);
+        if (cf->debug_level > 1)
+            printf("[%s] Flash = %uk\n", section, cf->flash_kbytes);
     } else {
         fprintf(stderr, "%s: Unknown parameter: %s = %s\n",
-            confname, param, value);
+            cf->confname, param, value);
     }
 }
 
 /*
  * Read configuration file and setup target parameters.
  */
-void target_configure()
+void target_configure(variant_t *tab, const char *progname, int debug_level)
 {
+    conf_t conf, *cf = &conf;
     FILE *fp;
     int c;
 
+    memset(cf, 0, sizeof(conf_t));
+    cf->tab = tab;
+    cf->debug_level = debug_level;
+
     /*
      * Find the configuration file, if any.
      * (1) First, try a path from PIC32PROG_CONF_FILE environment variable.
@@ -331,40 +347,40 @@ void target_configure()
      * (3) Otherwise, use /usr/local/etc/ directory (on Unix)
      *     or a directory where pic32prog.exe resides (on Windows)
      */
-    confname = getenv("PIC32PROG_CONF_FILE");
-    if (! confname)
-        confname = "pic32prog.conf";
+    cf->confname = getenv("PIC32PROG_CONF_FILE");
+    if (! cf->confname)
+        cf->confname = "pic32prog.conf";
 
-    if (access(confname, 0) < 0) {
+    if (access(cf->confname, 0) < 0) {
 #if defined(__CYGWIN32__) || defined(MINGW32)
         char *p = strrchr(progname, '\\');
         if (p) {
             char *buf = malloc(p - progname + 16);
             if (! buf) {
                 fprintf(stderr, "%s: out of memory\n", progname);
-                exit(-1);
+                session_abort(-1);
             }
             strncpy(buf, progname, p - progname);
             strcpy(buf + (p - progname), "\\pic32prog.conf");
-            confname = buf;
+            cf->confname = buf;
         } else
-            confname = "c:\\pic32prog.conf";
+            cf->confname = "c:\\pic32prog.conf";
 #else
-        confname = "/usr/local/etc/pic32prog.conf";
+        cf->confname = "/usr/local/etc/pic32prog.conf";
 #endif
     }
 
-    fp = fopen(confname, "r");
+    fp = fopen(cf->confname, "r");
     if (! fp) {
         /* No config file available: that's OK. */
         return;
     }
-    bsize = 1024;
-    bufr = (char*) malloc(bsize);
-    if (! bufr) {
-        fprintf(stderr, "%s: malloc failed\n", confname);
+    cf->bsize = 1024;
+    cf->bufr = (char*) malloc(cf->bsize);
+    if (! cf->bufr) {
+        fprintf(stderr, "%s: malloc failed\n", cf->confname);
         fclose(fp);
-        exit(-1);
+        session_abort(-1);
     }
 
     /* Parse file. */
@@ -381,7 +397,7 @@ void target_configure()
             break;
 
         case '[':           /* section header */
-            parse_section(fp);
+            parse_section(cf, fp);
             c = eat_whitespace(fp);
             break;
 
@@ -390,18 +406,18 @@ void target_configure()
             break;
 
         default:            /* parameter line */
-            parse_parameter(fp, configure_parameter, c);
+            parse_parameter(cf, fp, configure_parameter, c);
             c = eat_whitespace(fp);
             break;
         }
     }
-    configure_parameter("", 0, 0); /* Final call: end of file. */
+    configure_parameter(cf, "", 0, 0); /* Final call: end of file. */
     fclose(fp);
-    if (cursec) {
-        free(cursec);
-        cursec = 0;
+    if (cf->cursec) {
+        free(cf->cursec);
+        cf->cursec = 0;
     }
-    free(bufr);
-    bufr = 0;
-    bsize = 0;
+    free(cf->bufr);
+    cf->bufr = 0;
+    cf->bsize = 0;
 }
@@ -0,0 +1,272 @@
+/*
+ * Session daemon: keep the adapter open and the PE loaded
+ * between runs, and execute jobs sent over a local socket.
+ *
+ * The client sends its working directory and the command line
+ * as a list of zero-terminated strings, ended by an empty string.
+ * The daemon replies with the output of the job, followed
+ * by a zero byte and the exit status.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include "daemon.h"
+
+#if defined(__WIN32__) || defined(WIN32)
+
+const char *daemon_socket_path()
+{
+    return "";
+}
+
+void daemon_serve(const char *path, daemon_job_t *job)
+{
+    fprintf(stderr, "Daemon mode is not supported on this platform.\n");
+    exit(1);
+}
+
+int daemon_request(const char *path, int argc, char **argv)
+{
+    fprintf(stderr, "Daemon mode is not supported on this platform.\n");
+    return -1;
+}
+
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAXARGS     64          /* Max number of arguments of a job */
+#define MAXREQ      4096        /* Max size of a request */
+
+const char *daemon_socket_path()
+{
+    static char path [64];
+
+    if (! path[0])
+        sprintf(path, "/tmp/pic32prog-%u.sock", (unsigned) getuid());
+    return path;
+}
+
+static void make_address(struct sockaddr_un *sa, const char *path)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa->sun_path)) {
+        fprintf(stderr, "%s: socket name too long\n", path);
+        exit(-1);
+    }
+    strcpy(sa->sun_path, path);
+}
+
+static int write_all(int fd, const char *buf, int nbytes)
+{
+    int n;
+
+    while (nbytes > 0) {
+        n = write(fd, buf, nbytes);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        nbytes -= n;
+    }
+    return 0;
+}
+
+/*
+ * Receive a request and split it into arguments.
+ * Return the number of arguments, or -1 on error.
+ */
+static int read_request(int fd, char *buf, char **argv)
+{
+    int len = 0, argc = 0, start = 0, n;
+
+    for (;;) {
+        if (len >= MAXREQ)
+            return -1;
+        n = read(fd, buf + len, MAXREQ - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        n += len;
+        for (; len < n; len++) {
+            if (buf[len] != 0)
+                continue;
+            if (len == start) {
+                /* Empty string: end of request. */
+                argv[argc] = 0;
+                return argc;
+            }
+            if (argc >= MAXARGS)
+                return -1;
+            argv[argc++] = buf + start;
+            start = len + 1;
+        }
+    }
+}
+
+void daemon_serve(const char *path, daemon_job_t *job)
+{
+    struct sockaddr_un sa;
+    int sock, conn, out, err, argc, status;
+    char buf [MAXREQ], *argv [MAXARGS+1], home [4096], reply [2];
+
+    if (! getcwd(home, sizeof(home))) {
+        perror("getcwd");
+        exit(-1);
+    }
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        exit(-1);
+    }
+    make_address(&sa, path);
+
+    /* Remove a socket, left by previous daemon. */
+    unlink(path);
+    if (bind(sock, (struct sockaddr*) &sa, sizeof(sa)) < 0 ||
+        listen(sock, 4) < 0) {
+        perror(path);
+        exit(-1);
+    }
+
+    /* A client can go away in the middle of a job. */
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("       Daemon: waiting for jobs on %s\n", path);
+    for (;;) {
+        conn = accept(sock, 0, 0);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            exit(-1);
+        }
+        argc = read_request(conn, buf, argv);
+        if (argc < 1) {
+            close(conn);
+            continue;
+        }
+
+        /* First argument is the working directory of the client. */
+        if (chdir(argv[0]) < 0) {
+            perror(argv[0]);
+            close(conn);
+            continue;
+        }
+        argv[0] = "pic32prog";
+
+        /* Send the output of the job to the client. */
+        fflush(stdout);
+        fflush(stderr);
+        out = dup(1);
+        err = dup(2);
+        dup2(conn, 1);
+        dup2(conn, 2);
+
+        status = job(argc, argv);
+
+        fflush(stdout);
+        fflush(stderr);
+        dup2(out, 1);
+        dup2(err, 2);
+        close(out);
+        close(err);
+
+        reply[0] = 0;
+        reply[1] = status;
+        write_all(conn, reply, 2);
+        close(conn);
+        if (status != 0)
+            printf("       Daemon: job failed, status %d\n", status);
+
+        if (chdir(home) < 0)
+            perror(home);
+    }
+}
+
+int daemon_request(const char *path, int argc, char **argv)
+{
+    struct sockaddr_un sa;
+    int sock, len, i, n, got_end = 0;
+    char buf [MAXREQ], *p;
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    make_address(&sa, path);
+    if (connect(sock, (struct sockaddr*) &sa, sizeof(sa)) < 0) {
+        fprintf(stderr, "%s: cannot connect to daemon: %s\n",
+            path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    /* Working directory, arguments and an empty string. */
+    if (! getcwd(buf, sizeof(buf) - 1)) {
+        perror("getcwd");
+        close(sock);
+        return -1;
+    }
+    len = strlen(buf) + 1;
+    for (i=0; i<argc; i++) {
+        n = strlen(argv[i]) + 1;
+        if (n == 1)
+            continue;
+        if (len + n >= MAXREQ || i >= MAXARGS-1) {
+            fprintf(stderr, "Too many arguments for daemon.\n");
+            close(sock);
+            return -1;
+        }
+        memcpy(buf + len, argv[i], n);
+        len += n;
+    }
+    buf[len++] = 0;
+    if (write_all(sock, buf, len) < 0) {
+        perror(path);
+        close(sock);
+        return -1;
+    }
+
+    /* Copy the output, until a zero byte and the status. */
+    for (;;) {
+        n = read(sock, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        if (got_end) {
+            close(sock);
+            return (unsigned char) buf[0];
+        }
+        p = memchr(buf, 0, n);
+        if (! p) {
+            fwrite(buf, 1, n, stdout);
+            continue;
+        }
+        fwrite(buf, 1, p - buf, stdout);
+        if (p + 1 < buf + n) {
+            close(sock);
+            return (unsigned char) p[1];
+        }
+        got_end = 1;
+    }
+    close(sock);
+    fflush(stdout);
+    fprintf(stderr, "Daemon terminated.\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * Session daemon: keep the adapter open and the PE loaded
+ * between runs, and execute jobs sent over a local socket.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+
+#ifndef _DAEMON_H
+#define _DAEMON_H
+
+/*
+ * Job handler: run a command line, received from a client.
+ * Return the exit status for the client.
+ */
+typedef int daemon_job_t(int argc, char **argv);
+
+/*
+ * Default name of the daemon socket.
+ */
+const char *daemon_socket_path(void);
+
+/*
+ * Listen on the socket and run jobs, one at a time.
+ * Output of the job is sent back to the client.
+ * Never returns.
+ */
+void daemon_serve(const char *path, daemon_job_t *job);
+
+/*
+ * Send a command line to the daemon and print the output.
+ * Return the exit status of the job, or -1 when
+ * the daemon is not available.
+ */
+int daemon_request(const char *path, int argc, char **argv);
+
+#endif
@@ -1227,3 +1227,24 @@ const unsigned pic32_pemk[] =
 /*0c80*/ 0xa0002000, 0x00000400, 0x00000000, 0x00000000,
          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // Extra zeroes to pad to multiple of 10
 };
+
+/*
+ * Calculate checksum, same way as PE does for GET_CRC command.
+ */
+unsigned pic32_crc16(unsigned crc, const unsigned char *data, unsigned nbytes)
+{
+    static const unsigned short crc_table [16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    };
+    unsigned i;
+
+    while (nbytes--) {
+        i = (crc >> 12) ^ (*data >> 4);
+        crc = crc_table[i & 0x0F] ^ (crc << 4);
+        i = (crc >> 12) ^ (*data >> 0);
+        crc = crc_table[i & 0x0F] ^ (crc << 4);
+        data++;
+    }
+    return crc & 0xffff;
+}
@@ -0,0 +1,1154 @@
+/*
+ * Library interface of PIC32PROG: programming session,
+ * which owns the image, the options and the target.
+ *
+ * Copyright (C) 2011-2014 Serge Vakulenko
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <sys/time.h>
+
+#include "libpic32prog.h"
+#include "localize.h"
+#include "pic32.h"
+
+#define MAXRUNSZ            (32*1024)   /* Max bytes programmed at once */
+#define FLASHV_KSEG0_BASE   0x9d000000
+#define BOOTV_KSEG0_BASE    0x9fc00000
+#define FLASHV_KSEG1_BASE   0xBD000000
+#define BOOTV_KSEG1_BASE    0xBFC00000
+#define FLASHP_BASE     0x1d000000
+#define BOOTP_BASE      0x1fc00000
+
+/* Macros for converting between hex and binary. */
+#define NIBBLE(x)       (isdigit(x) ? (x)-'0' : tolower(x)+10-'a')
+#define HEX(buffer)     ((NIBBLE((buffer)[0])<<4) + NIBBLE((buffer)[1]))
+
+/* Trace level of adapter protocols, set from the session
+ * for the time of a library call. */
+__thread int debug_level;
+
+/* Error context of the active library call. */
+static __thread jmp_buf *fail_env;
+static __thread int fail_status;
+
+// PIC32MX, MZ DEVCFG definitions
+#define devcfg3 (*(unsigned*) &p->boot_data [p->devcfg_offset])
+#define devcfg2 (*(unsigned*) &p->boot_data [p->devcfg_offset + 4])
+#define devcfg1 (*(unsigned*) &p->boot_data [p->devcfg_offset + 8])
+#define devcfg0 (*(unsigned*) &p->boot_data [p->devcfg_offset + 12])
+
+// PIC32MK DEVCFG definitions
+#define bf1devcfg3 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000])
+#define bf1devcfg2 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 4])
+#define bf1devcfg1 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 8])
+#define bf1devcfg0 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 12])
+#define bf1devcp 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 28])
+#define bf1devsign 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 44])
+#define bf1seq 		(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 48])
+
+#define bf2devcfg3 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000])
+#define bf2devcfg2 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 4])
+#define bf2devcfg1 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 8])
+#define bf2devcfg0 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 12])
+#define bf2devcp 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 28])
+#define bf2devsign 	(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 44])
+#define bf2seq 		(*(unsigned*) &p->boot_data [p->devcfg_offset + 0x40000 + 0x20000 + 48])
+
+
+
+// PIC32MM definitions
+#define offset_first 0xc0
+#define offset_alternate 0x40
+#define fdevopt  (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x04])
+#define ficd     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x08])
+#define fpor     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x0c])
+#define fwdt     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x10])
+#define foscsel  (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x14])
+#define fsec     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_first + 0x18])
+#define afdevopt  (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x04])
+#define aficd     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x08])
+#define afpor     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x0c])
+#define afwdt     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x10])
+#define afoscsel  (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x14])
+#define afsec     (*(unsigned*) &p->boot_data [p->devcfg_offset + offset_alternate + 0x18])
+
+unsigned mseconds_elapsed(struct timeval *t0)
+{
+    struct timeval t1;
+    unsigned mseconds;
+
+    gettimeofday(&t1, 0);
+    mseconds = (t1.tv_sec - t0->tv_sec) * 1000 +
+        (t1.tv_usec - t0->tv_usec) / 1000;
+    if (mseconds < 1)
+        mseconds = 1;
+    return mseconds;
+}
+
+/*
+ * Stop the library call with the given status.
+ * Without an active call, exit the program.
+ */
+void session_abort(int status)
+{
+    if (! fail_env)
+        exit(status);
+    fail_status = status;
+    longjmp(*fail_env, 1);
+}
+
+/*
+ * Run an operation of the session, catching errors.
+ * On error the target is closed, so that the next call
+ * opens it again.  Return 0 on success, or the error status.
+ */
+static int session_run(pic32prog_t *p, void (*func)(pic32prog_t*, void*),
+    void *arg)
+{
+    jmp_buf env, *saved_env = fail_env;
+    int saved_debug_level = debug_level;
+    int status = 0;
+
+    debug_level = p->debug_level;
+    fail_env = &env;
+    if (setjmp(env) == 0) {
+        func(p, arg);
+    } else {
+        status = fail_status;
+        if (p->target) {
+            /* Ignore errors of the adapter, which already failed. */
+            if (setjmp(env) == 0)
+                target_close(p->target, p->power_on);
+            free(p->target);
+            p->target = 0;
+        }
+    }
+    fail_env = saved_env;
+    debug_level = saved_debug_level;
+    return status;
+}
+
+/*
+ * Create a session with default options and empty image.
+ */
+pic32prog_t *pic32prog_new(const char *progname)
+{
+    pic32prog_t *p;
+
+    p = calloc(1, sizeof(pic32prog_t));
+    if (! p) {
+        fprintf(stderr, _("Out of memory\n"));
+        return 0;
+    }
+    p->boot_data = malloc(BOOT_BYTES);
+    p->flash_data = malloc(FLASH_BYTES);
+    p->boot_dirty = malloc(BOOT_BYTES / MINBLOCKSZ);
+    p->flash_dirty = malloc(FLASH_BYTES / MINBLOCKSZ);
+    if (! p->boot_data || ! p->flash_data || ! p->boot_dirty || ! p->flash_dirty) {
+        fprintf(stderr, _("Out of memory\n"));
+        pic32prog_free(p);
+        return 0;
+    }
+    p->progname = progname;
+    p->baud_rate = 115200;
+    p->alt_baud_rate = 115200;
+    p->interface = INTERFACE_DEFAULT;
+    p->out = stdout;
+    pic32prog_clear(p);
+    return p;
+}
+
+/*
+ * Close the target and free the session.
+ */
+void pic32prog_free(pic32prog_t *p)
+{
+    pic32prog_close(p);
+    free(p->variants);
+    free(p->boot_data);
+    free(p->flash_data);
+    free(p->boot_dirty);
+    free(p->flash_dirty);
+    free(p);
+}
+
+/*
+ * Clear the image and the programming mode options.
+ */
+void pic32prog_clear(pic32prog_t *p)
+{
+    p->verify_only = 0;
+    p->skip_verify = 0;
+    p->update_only = 0;
+    p->region_only = 0;
+    p->blank_check = 0;
+    p->boot_used = 0;
+    p->flash_used = 0;
+    p->bootv_kseg = 1;      // Default to 1, same as before. Set in store_data.
+    p->flashv_kseg = 1;     // Default to 1, same as before. Set in store_data.
+    p->total_bytes = 0;
+    memset(p->boot_data, ~0, BOOT_BYTES);
+    memset(p->flash_data, ~0, FLASH_BYTES);
+    memset(p->boot_dirty, 0, BOOT_BYTES / MINBLOCKSZ);
+    memset(p->flash_dirty, 0, FLASH_BYTES / MINBLOCKSZ);
+}
+
+static void store_data(pic32prog_t *p, unsigned address, unsigned byte)
+{
+    unsigned offset;
+
+    if (address >= BOOTV_KSEG0_BASE && address < BOOTV_KSEG0_BASE + BOOT_BYTES) {
+        /* Boot code, virtual. KSEG0! */
+        offset = address - BOOTV_KSEG0_BASE;
+        p->boot_data [offset] = byte;
+        p->boot_used = 1;
+        p->bootv_kseg = 0;
+    } else if (address >= BOOTV_KSEG1_BASE && address < BOOTV_KSEG1_BASE + BOOT_BYTES) {
+        /* Boot code, virtual. KSEG1! */
+        offset = address - BOOTV_KSEG1_BASE;
+        p->boot_data [offset] = byte;
+        p->boot_used = 1;
+        p->bootv_kseg = 1;
+    } else if (address >= BOOTP_BASE && address < BOOTP_BASE + BOOT_BYTES) {
+        /* Boot code, physical. */
+        offset = address - BOOTP_BASE;
+        p->boot_data [offset] = byte;
+        p->boot_used = 1;
+    } else if (address >= FLASHV_KSEG1_BASE && address < FLASHV_KSEG1_BASE + FLASH_BYTES) {
+        /* Main flash memory, virtual. */
+        offset = address - FLASHV_KSEG1_BASE;
+        p->flash_data [offset] = byte;
+        p->flash_used = 1;
+        p->flashv_kseg = 1;
+    }
+    else if (address >= FLASHV_KSEG0_BASE && address < FLASHV_KSEG0_BASE + FLASH_BYTES) {
+        /* Main flash memory, virtual. */
+        offset = address - FLASHV_KSEG0_BASE;
+        p->flash_data [offset] = byte;
+        p->flash_used = 1;
+        p->flashv_kseg = 0;
+    } else if (address >= FLASHP_BASE && address < FLASHP_BASE + FLASH_BYTES) {
+        /* Main flash memory, physical. */
+        offset = address - FLASHP_BASE;
+        p->flash_data [offset] = byte;
+        p->flash_used = 1;
+    } else {
+        /* Ignore incorrect data. */
+        //fprintf(stderr, _("%08X: address out of flash memory\n"), address);
+		fprintf(p->out, "Else statement\n");
+        return;
+    }
+    p->total_bytes++;
+}
+
+/*
+ * Read the S record file.
+ * Return 0 when the file is not in SREC format, -1 on error.
+ */
+static int read_srec(pic32prog_t *p, const char *filename)
+{
+    FILE *fd;
+    unsigned char buf [256];
+    unsigned char *data;
+    unsigned address;
+    int bytes;
+
+    fd = fopen(filename, "r");
+    if (! fd) {
+        perror(filename);
+        return -1;
+    }
+
+    while (fgets((char*) buf, sizeof(buf), fd)) {
+        if (buf[0] == '\n')
+            continue;
+        if (buf[0] != 'S') {
+            fclose(fd);
+            return 0;
+        }
+        if (buf[1] == '7' || buf[1] == '8' || buf[1] == '9')
+            break;
+
+        /* Starting an S-record.  */
+        if (! isxdigit(buf[2]) || ! isxdigit(buf[3])) {
+            fprintf(stderr, _("%s: bad SREC record: %s\n"), filename, buf);
+            fclose(fd);
+            return -1;
+        }
+        bytes = HEX(buf + 2);
+
+        /* Ignore the checksum byte.  */
+        --bytes;
+
+        address = 0;
+        data = buf + 4;
+        switch (buf[1]) {
+        case '3':
+            address = HEX(data);
+            data += 2;
+            --bytes;
+            /* Fall through.  */
+        case '2':
+            address = (address << 8) | HEX(data);
+            data += 2;
+            --bytes;
+            /* Fall through.  */
+        case '1':
+            address = (address << 8) | HEX(data);
+            data += 2;
+            address = (address << 8) | HEX(data);
+            data += 2;
+            bytes -= 2;
+
+            while (bytes-- > 0) {
+                store_data(p, address++, HEX(data));
+                data += 2;
+            }
+            break;
+        }
+    }
+    fclose(fd);
+    return 1;
+}
+
+/*
+ * Read HEX file.
+ * Return 0 when the file is not in HEX format, -1 on error.
+ */
+static int read_hex(pic32prog_t *p, const char *filename)
+{
+    FILE *fd;
+    unsigned char buf [256], data[16], record_type, sum;
+    unsigned address, high;
+    int bytes, i;
+
+    fd = fopen(filename, "r");
+    if (! fd) {
+        perror(filename);
+        return -1;
+    }
+    high = 0;
+    while (fgets((char*) buf, sizeof(buf), fd)) {
+        if (buf[0] == '\n')
+            continue;
+        if (buf[0] != ':') {
+            fclose(fd);
+            return 0;
+        }
+        if (! isxdigit(buf[1]) || ! isxdigit(buf[2]) ||
+            ! isxdigit(buf[3]) || ! isxdigit(buf[4]) ||
+            ! isxdigit(buf[5]) || ! isxdigit(buf[6]) ||
+            ! isxdigit(buf[7]) || ! isxdigit(buf[8])) {
+            fprintf(stderr, _("%s: bad HEX record: %s\n"), filename, buf);
+            fclose(fd);
+            return -1;
+        }
+        record_type = HEX(buf+7);
+        if (record_type == 1) {
+            /* End of file. */
+            break;
+        }
+        if (record_type == 5) {
+            /* Start address, ignore. */
+            continue;
+        }
+
+        bytes = HEX(buf+1);
+        if (strlen((char*) buf) < bytes * 2 + 11) {
+            fprintf(stderr, _("%s: too short hex line\n"), filename);
+            fclose(fd);
+            return -1;
+        }
+        address = high << 16 | HEX(buf+3) << 8 | HEX(buf+5);
+
+        sum = 0;
+        for (i=0; i<bytes; ++i) {
+            data [i] = HEX(buf+9 + i + i);
+            sum += data [i];
+        }
+        sum += record_type + bytes + (address & 0xff) + (address >> 8 & 0xff);
+        if (sum != (unsigned char) - HEX(buf+9 + bytes + bytes)) {
+            fprintf(stderr, _("%s: bad HEX checksum\n"), filename);
+            fclose(fd);
+            return -1;
+        }
+
+        if (record_type == 4) {
+            /* Extended address. */
+            if (bytes != 2) {
+                fprintf(stderr, _("%s: invalid HEX linear address record length\n"),
+                    filename);
+                fclose(fd);
+                return -1;
+            }
+            high = data[0] << 8 | data[1];
+            continue;
+        }
+        if (record_type != 0) {
+            fprintf(stderr, _("%s: unknown HEX record type: %d\n"),
+                filename, record_type);
+            fclose(fd);
+            return -1;
+        }
+        //printf("%08x: %u bytes\n", address, bytes);
+        for (i=0; i<bytes; i++) {
+            store_data(p, address++, data [i]);
+        }
+    }
+    fclose(fd);
+    return 1;
+}
+
+static void print_symbols(pic32prog_t *p, char symbol, int cnt)
+{
+    while (cnt-- > 0)
+        fputc(symbol, p->out);
+}
+
+static void progress(pic32prog_t *p, unsigned step)
+{
+    ++p->progress_count;
+    if (p->progress_count % step == 0) {
+        fputc('#', p->out);
+        fflush(p->out);
+    }
+}
+
+/*
+ * Check that the boot block, containing devcfg registers,
+ * has some useful data.
+ */
+static int is_flash_block_dirty(pic32prog_t *p, unsigned offset)
+{
+    int i;
+
+    for (i=0; i<p->blocksz; i++, offset++) {
+        if (p->flash_data [offset] != 0xff)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Check that the boot block, containing devcfg registers,
+ * has some other data.
+ */
+static int is_boot_block_dirty(pic32prog_t *p, unsigned offset)
+{
+    int i;
+
+    for (i=0; i<p->blocksz; i++, offset++) {
+        /* Skip devcfg registers. */
+		if (offset >= p->devcfg_offset && offset < p->devcfg_offset+16)
+            continue;
+        if (p->boot_data [offset] != 0xff)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Compare pages of memory with the data, using checksums
+ * computed by the programming executive.  Clear dirty bits
+ * of unchanged pages, erase changed pages when requested.
+ * Pages without data are skipped, unless check_all is set.
+ * Return the number of changed pages.
+ */
+static unsigned update_pages(pic32prog_t *p, unsigned char *data, unsigned char *dirty,
+    unsigned nbytes, unsigned base, unsigned page_bytes,
+    int check_all, int erase)
+{
+    unsigned addr, offset, len, nchanged = 0, erase_addr = 0, erase_len = 0;
+    int used;
+
+    for (addr=0; addr<nbytes; addr+=page_bytes) {
+        /* Last page can be partial: compare only the memory part,
+         * but erase the whole page when it differs. */
+        len = page_bytes;
+        if (addr + len > nbytes)
+            len = nbytes - addr;
+        used = check_all;
+        for (offset=addr; offset<addr+len; offset+=p->blocksz)
+            if (dirty [offset / p->blocksz])
+                used = 1;
+        if (used && target_check_crc(p->target, base + addr, len / 4,
+            (unsigned*) &data [addr]) > 0) {
+            /* Page is up to date. */
+            for (offset=addr; offset<addr+len; offset+=p->blocksz)
+                dirty [offset / p->blocksz] = 0;
+            used = 0;
+        }
+        if (! used) {
+            if (erase_len > 0)
+                target_erase_range(p->target, base + erase_addr, erase_len);
+            erase_len = 0;
+            continue;
+        }
+        nchanged++;
+        if (! erase)
+            continue;
+
+        /* Merge adjacent changed pages into one erase command. */
+        if (erase_len == 0)
+            erase_addr = addr;
+        erase_len += page_bytes;
+    }
+    if (erase_len > 0)
+        target_erase_range(p->target, base + erase_addr, erase_len);
+    return nchanged;
+}
+
+/*
+ * Erase flash pages, which contain any data.
+ * Adjacent pages are erased by one command.
+ * Return the number of erased pages.
+ */
+static unsigned erase_used_pages(pic32prog_t *p, unsigned char *dirty, unsigned nbytes,
+    unsigned base, unsigned page_bytes)
+{
+    unsigned addr, offset, nerased = 0, erase_addr = 0, erase_len = 0;
+    int used;
+
+    for (addr=0; addr<nbytes; addr+=page_bytes) {
+        used = 0;
+        for (offset=addr; offset<addr+page_bytes && offset<nbytes; offset+=p->blocksz)
+            if (dirty [offset / p->blocksz])
+                used = 1;
+        if (! used) {
+            if (erase_len > 0)
+                target_erase_range(p->target, base + erase_addr, erase_len);
+            erase_len = 0;
+            continue;
+        }
+        if (erase_len == 0)
+            erase_addr = addr;
+        erase_len += page_bytes;
+        nerased++;
+    }
+    if (erase_len > 0)
+        target_erase_range(p->target, base + erase_addr, erase_len);
+    return nerased;
+}
+
+/*
+ * Erase only flash pages, which are not blank.
+ * Return 0 when the chip erase is needed instead.
+ */
+static int erase_nonblank_pages(pic32prog_t *p, unsigned page_bytes)
+{
+    unsigned flash_base = p->flashv_kseg ? FLASHV_KSEG1_BASE : FLASHV_KSEG0_BASE;
+    unsigned boot_base = p->bootv_kseg ? BOOTV_KSEG1_BASE : BOOTV_KSEG0_BASE;
+    unsigned addr, nerased = 0, erase_addr = 0, erase_len = 0;
+    int status;
+
+    /* On MK family, configuration registers are placed
+     * outside of boot memory, so always erase the chip. */
+    if (FAMILY_MK == p->target->family->name_short)
+        return 0;
+
+    fprintf(p->out, _("  Blank check: "));
+    fflush(p->out);
+    status = target_blank_check(p->target, flash_base, p->flash_bytes);
+    if (status < 0) {
+        fprintf(p->out, _("not supported\n"));
+        return 0;
+    }
+    if (p->boot_bytes > 0 && target_blank_check(p->target, boot_base, p->boot_bytes) != 1) {
+        fprintf(p->out, _("boot memory not blank\n"));
+        return 0;
+    }
+    if (status == 1) {
+        fprintf(p->out, _("blank\n"));
+        return 1;
+    }
+    if (page_bytes == 0) {
+        fprintf(p->out, _("not blank\n"));
+        return 0;
+    }
+
+    /* Find pages to erase, merging adjacent ones. */
+    for (addr=0; addr<p->flash_bytes; addr+=page_bytes) {
+        if (target_blank_check(p->target, flash_base + addr, page_bytes) == 1) {
+            if (erase_len > 0)
+                target_erase_range(p->target, flash_base + erase_addr, erase_len);
+            erase_len = 0;
+            continue;
+        }
+        if (erase_len == 0)
+            erase_addr = addr;
+        erase_len += page_bytes;
+        nerased++;
+    }
+    if (erase_len > 0)
+        target_erase_range(p->target, flash_base + erase_addr, erase_len);
+    fprintf(p->out, _("%u pages erased\n"), nerased);
+    return 1;
+}
+
+/*
+ * Load the image from a file in SREC or Intel HEX format.
+ */
+int pic32prog_load(pic32prog_t *p, const char *filename)
+{
+    int status;
+
+    status = read_srec(p, filename);
+    if (status == 0)
+        status = read_hex(p, filename);
+    if (status == 0)
+        fprintf(stderr, _("%s: bad file format\n"), filename);
+    return (status > 0) ? 0 : 1;
+}
+
+/*
+ * Open and detect the device.
+ * The target stays open until pic32prog_close(), so that
+ * a daemon can run several jobs with the PE loaded.
+ */
+static void do_open(pic32prog_t *p, void *arg)
+{
+    if (p->target) {
+        /* Target stays open between calls, like in the daemon:
+         * the board could be reset or replaced since then. */
+        target_check_executive(p->target);
+        return;
+    }
+    if (! p->variants) {
+        /* Update the table of chip variants from pic32prog.conf file. */
+        p->variants = target_variants();
+        target_configure(p->variants, p->progname, p->debug_level);
+    }
+    p->target = target_open(p->port, p->baud_rate, p->alt_baud_rate,
+        p->interface, p->interface_speed, p->variants);
+    if (! p->target) {
+        fprintf(stderr, _("Error detecting device -- check cable!\n"));
+        session_abort(1);
+    }
+    p->target->out = p->out;
+}
+
+static void do_close(pic32prog_t *p, void *arg)
+{
+    target_close((target_t*) arg, p->power_on);
+}
+
+int pic32prog_close(pic32prog_t *p)
+{
+    target_t *t = p->target;
+    int status;
+
+    if (! t)
+        return 0;
+
+    /* Detach the target first: a failed close is not repeated. */
+    p->target = 0;
+    status = session_run(p, do_close, t);
+    free(t);
+    return status;
+}
+
+static void do_probe(pic32prog_t *p, void *arg)
+{
+    do_open(p, 0);
+
+    if ((p->target->adapter->flags & AD_PROBE) == 0) {
+        fprintf(stderr, _("Error: Target probe not supported.\n"));
+        session_abort(1);
+    }
+
+    p->boot_bytes = target_boot_bytes(p->target);
+    fprintf(p->out, _("    Processor: %s (id %08X)\n"), target_cpu_name(p->target),
+        target_idcode(p->target));
+    fprintf(p->out, _(" Flash memory: %d kbytes\n"), target_flash_bytes(p->target) / 1024);
+    if (p->boot_bytes > 0)
+        fprintf(p->out, _("  Boot memory: %d kbytes\n"), p->boot_bytes / 1024);
+    target_print_devcfg(p->target);
+}
+
+/*
+ * Write a contiguous range of blocks to flash memory.
+ */
+static void program_range(pic32prog_t *p, unsigned addr, unsigned nbytes)
+{
+    unsigned char *data;
+    unsigned offset;
+
+    if (addr >= BOOTV_KSEG0_BASE && addr < BOOTV_KSEG0_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTV_KSEG0_BASE;
+    } else if (addr >= BOOTV_KSEG1_BASE && addr < BOOTV_KSEG1_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTV_KSEG1_BASE;
+    } else if (addr >= BOOTP_BASE && addr < BOOTP_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTP_BASE;
+    } else if (addr >= FLASHV_KSEG0_BASE && addr < FLASHV_KSEG0_BASE + p->flash_bytes) {
+        data = p->flash_data;
+        offset = addr - FLASHV_KSEG0_BASE;
+    } else if (addr >= FLASHV_KSEG1_BASE && addr < FLASHV_KSEG1_BASE + p->flash_bytes) {
+        data = p->flash_data;
+        offset = addr - FLASHV_KSEG1_BASE;
+    } else {
+        data = p->flash_data;
+        offset = addr - FLASHP_BASE;
+    }
+    target_program_block(p->target, addr, nbytes/4, (unsigned*) (data + offset));
+}
+
+/*
+ * Verify a contiguous range of blocks.
+ */
+static int verify_range(pic32prog_t *p, unsigned addr, unsigned nbytes)
+{
+    unsigned char *data;
+    unsigned offset;
+
+    if (addr >= BOOTV_KSEG0_BASE && addr < BOOTV_KSEG0_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTV_KSEG0_BASE;
+    } else if (addr >= BOOTV_KSEG1_BASE && addr < BOOTV_KSEG1_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTV_KSEG1_BASE;
+    } else if (addr >= BOOTP_BASE && addr < BOOTP_BASE + p->boot_bytes) {
+        data = p->boot_data;
+        offset = addr - BOOTP_BASE;
+    } else if (addr >= FLASHV_KSEG0_BASE && addr < FLASHV_KSEG0_BASE + p->flash_bytes) {
+        data = p->flash_data;
+        offset = addr - FLASHV_KSEG0_BASE;
+    } else if (addr >= FLASHV_KSEG1_BASE && addr < FLASHV_KSEG1_BASE + p->flash_bytes) {
+        data = p->flash_data;
+        offset = addr - FLASHV_KSEG1_BASE;
+    } else {
+        data = p->flash_data;
+        offset = addr - FLASHP_BASE;
+    }
+    return target_verify_range(p->target, addr, nbytes/4, (unsigned*) (data + offset), p->blocksz/4);
+}
+
+static void do_erase(pic32prog_t *p, void *arg)
+{
+    do_open(p, 0);
+
+    if ((p->target->adapter->flags & AD_ERASE) == 0) {
+        fprintf(stderr, _("Error: Target erase not supported.\n"));
+        session_abort(1);
+    }
+
+    target_erase(p->target);
+}
+
+static void do_program(pic32prog_t *p, void *arg)
+{
+    unsigned addr, end, page_bytes, nchanged;
+    int progress_len, progress_step, boot_progress_len;
+    struct timeval t0;
+
+    do_open(p, 0);
+
+    if ((p->target->adapter->flags & AD_WRITE) == 0) {
+        fprintf(stderr, _("Error: Target write not supported.\n"));
+        session_abort(1);
+    }
+
+    p->flash_bytes = target_flash_bytes(p->target);
+    p->boot_bytes = target_boot_bytes(p->target);
+    if (p->target->adapter->block_override != 0) {
+        p->blocksz = p->target->adapter->block_override;
+    } else {
+        p->blocksz = target_block_size(p->target);
+    }
+    p->devcfg_offset = target_devcfg_offset(p->target);
+    fprintf(p->out, _("    Processor: %s\n"), target_cpu_name(p->target));
+    fprintf(p->out, _(" Flash memory: %d kbytes\n"), p->flash_bytes / 1024);
+    if (p->boot_bytes > 0)
+        fprintf(p->out, _("  Boot memory: %d kbytes\n"), p->boot_bytes / 1024);
+    fprintf(p->out, _("         Data: %d bytes\n"), p->total_bytes);
+
+    /* Verify DEVCFGx values. */
+    if (p->boot_used) {
+        if (FAMILY_MM == p->target->family->name_short){
+            /* Check if both values have something in them.
+             * DEVOPT (and other) have some permanent 1 bits. Use those.
+               It would be more sensible, to set some bits to 0 in read_*, and compare to that... */
+			
+            if ( ((fdevopt&0x0f00) != 0x0f00) || ((afdevopt&0x0f00) != 0x0f00)){
+                fprintf(stderr, _("Configuration bits are missing -- check your HEX file!\n"));
+                if (p->debug_level > 0){
+                    fprintf(stderr, "Read config bits are:\n");
+                    fprintf(stderr, "Fdevopt:  %08x\n", fdevopt);
+                    fprintf(stderr, "Ficd:     %08x\n", ficd);
+                    fprintf(stderr, "Fpor:     %08x\n", fpor);
+                    fprintf(stderr, "Fwdt:     %08x\n", fwdt);
+                    fprintf(stderr, "Foscsel:  %08x\n", foscsel);
+                    fprintf(stderr, "Fsec:     %08x\n", fsec);
+                    fprintf(stderr, "AFdevopt: %08x\n", afdevopt);
+                    fprintf(stderr, "AFicd:    %08x\n", aficd);
+                    fprintf(stderr, "AFpor:    %08x\n", afpor);
+                    fprintf(stderr, "AFwdt:    %08x\n", afwdt);
+                    fprintf(stderr, "AFoscsel: %08x\n", afoscsel);
+                    fprintf(stderr, "AFsec:    %08x\n", afsec);
+                }
+                session_abort(1);
+            }
+        }
+		else if (FAMILY_MK == p->target->family->name_short){
+			/* Check if some bits were set to high */
+            if ( (bf1devcfg0 & 0x0F000000) != 0x0F000000 ){
+                fprintf(stderr, _("Configuration bits are missing -- check your HEX file!\n"));
+                session_abort(1);
+            }
+
+			
+		    // This is a bit of a hack, but OK.
+		    // Any unused data should be 0xFFFFFFFF in the flash and here. But some isn't (special values, etc).
+		    // For example, there's a clash in the Lower Alias Boot region. 
+		    // CRC here calculates based on 0xFFFFFFFF, but GET_CRC calculates based on real data.
+
+			// Also, because even though the registers exist, but MPLAB doesn't do anything with it...
+			bf1devsign &= 0x7FFFFFFF;
+			bf2devsign &= 0x7FFFFFFF;
+
+		    uint32_t copyFrom = 0x1fc43fc0 - BOOTP_BASE;
+			uint32_t copyTo = 0x1fc03fc0 - BOOTP_BASE;
+			uint32_t length = 0x40;
+			uint32_t counter = 0;
+			for(counter = 0; counter < length; counter++){
+				p->boot_data[copyTo + counter] = p->boot_data[copyFrom + counter];
+			}
+
+
+		}
+        else{
+            if (devcfg0 == 0xffffffff) {
+                fprintf(stderr, _("DEVCFG values are missing -- check your HEX file!\n"));
+                session_abort(1);
+            }
+            if (p->devcfg_offset == 0xffc0) {
+                /* For MZ family, clear bits DEVSIGN0[31] and ADEVSIGN0[31]. */
+                p->boot_data[0xFFEF] &= 0x7f;
+                p->boot_data[0xFF6F] &= 0x7f;
+            }
+        }
+    }
+
+    page_bytes = target_page_size(p->target);
+    if (p->region_only && ! p->verify_only) {
+        if (page_bytes == 0 || page_bytes % p->blocksz != 0 ||
+            p->target->family->pe_nwords == 0) {
+            fprintf(stderr, _("Region mode not supported by this adapter.\n"));
+            session_abort(1);
+        }
+        if (p->boot_used) {
+            fprintf(stderr, _("Region mode cannot program boot memory -- check your HEX file!\n"));
+            session_abort(1);
+        }
+    }
+    if (p->update_only && ! p->verify_only && (page_bytes == 0 ||
+        page_bytes % p->blocksz != 0 || p->target->family->pe_nwords == 0)) {
+        fprintf(stderr, _("Update mode not supported by this adapter, erasing chip.\n"));
+        p->update_only = 0;
+    }
+    if (p->blank_check && ! p->verify_only && ! p->update_only && ! p->region_only) {
+        /* Erase only when the chip is not blank. */
+        target_use_executive(p->target);
+        if (! erase_nonblank_pages(p, page_bytes)) {
+            target_erase(p->target);
+            target_use_executive(p->target);
+        }
+    } else if (! p->verify_only && ! p->update_only && ! p->region_only) {
+        /* Erase flash. */
+        target_erase(p->target);
+        target_use_executive(p->target);
+    } else {
+        target_use_executive(p->target);
+    }
+
+    /* Compute dirty bits for every block. */
+    if (p->flash_used) {
+        for (addr=0; addr<p->flash_bytes; addr+=p->blocksz) {
+            p->flash_dirty [addr / p->blocksz] = is_flash_block_dirty(p, addr);
+        }
+    }
+    if (p->boot_used) {
+        for (addr=0; addr<p->boot_bytes; addr+=p->blocksz) {
+            p->boot_dirty [addr / p->blocksz] = is_boot_block_dirty(p, addr);
+        }
+    }
+
+    if (! p->verify_only && p->update_only) {
+        /* Boot memory contains configuration registers:
+         * when it differs, fall back to the full chip erase.
+         * On MK family, configuration registers are placed
+         * outside of boot memory, so always erase. */
+        if (p->boot_used) {
+            if (FAMILY_MK == p->target->family->name_short)
+                nchanged = 1;
+            else
+                nchanged = update_pages(p, p->boot_data, p->boot_dirty, p->boot_bytes,
+                    p->bootv_kseg ? BOOTV_KSEG1_BASE : BOOTV_KSEG0_BASE,
+                    page_bytes, 1, 0);
+            if (nchanged > 0) {
+                for (addr=0; addr<p->boot_bytes; addr+=p->blocksz) {
+                    p->boot_dirty [addr / p->blocksz] = is_boot_block_dirty(p, addr);
+                }
+                p->update_only = 0;
+                target_erase(p->target);
+                target_use_executive(p->target);
+            } else {
+                /* Nothing to program in boot memory. */
+                p->boot_used = 0;
+            }
+        }
+        if (p->update_only) {
+            /* Compare flash pages, and erase changed ones.
+             * In region mode, pages without data are left as is. */
+            fprintf(p->out, _("       Update: "));
+            fflush(p->out);
+            nchanged = update_pages(p, p->flash_data, p->flash_dirty, p->flash_bytes,
+                p->flashv_kseg ? FLASHV_KSEG1_BASE : FLASHV_KSEG0_BASE,
+                page_bytes, ! p->region_only, 1);
+            fprintf(p->out, _("%u of %u pages changed\n"), nchanged,
+                p->flash_bytes / page_bytes);
+        }
+    } else if (! p->verify_only && p->region_only) {
+        /* Erase only the pages covered by the file. */
+        fprintf(p->out, _("        Erase: "));
+        fflush(p->out);
+        nchanged = erase_used_pages(p, p->flash_dirty, p->flash_bytes,
+            p->flashv_kseg ? FLASHV_KSEG1_BASE : FLASHV_KSEG0_BASE, page_bytes);
+        fprintf(p->out, _("%u pages\n"), nchanged);
+    }
+
+    /* Compute length of progress indicator for flash memory. */
+    for (progress_step=1; ; progress_step<<=1) {
+        progress_len = 0;
+        for (addr=0; addr<p->flash_bytes; addr+=p->blocksz) {
+            if (p->flash_dirty [addr / p->blocksz])
+                progress_len++;
+        }
+        if (progress_len / progress_step < 64) {
+            progress_len /= progress_step;
+            if (progress_len < 1)
+                progress_len = 1;
+            break;
+        }
+    }
+
+    /* Compute length of progress indicator for boot memory. */
+    boot_progress_len = 1;
+    for (addr=0; addr<p->boot_bytes; addr+=p->blocksz) {
+        if (p->boot_dirty [addr / p->blocksz])
+            boot_progress_len++;
+    }
+
+    p->progress_count = 0;
+    gettimeofday(&t0, 0);
+    if (! p->verify_only) {
+        if (p->flash_used) {
+            fprintf(p->out, _("Program flash: "));
+            print_symbols(p, '.', progress_len);
+            print_symbols(p, '\b', progress_len);
+            fflush(p->out);
+            for (addr=0; addr<p->flash_bytes; addr+=p->blocksz) {
+                if (! p->flash_dirty [addr / p->blocksz])
+                    continue;
+
+                /* Program a contiguous range of dirty blocks at once. */
+                for (end=addr+p->blocksz; end<p->flash_bytes && end-addr<MAXRUNSZ; end+=p->blocksz)
+                    if (! p->flash_dirty [end / p->blocksz])
+                        break;
+                program_range(p, addr + (p->flashv_kseg ? FLASHV_KSEG1_BASE : FLASHV_KSEG0_BASE), end - addr);
+                for (; addr<end; addr+=p->blocksz)
+                    progress(p, progress_step);
+                addr -= p->blocksz;
+            }
+            fprintf(p->out, _("# done\n"));
+        }
+        if (p->boot_used) {
+            fprintf(p->out, _(" Program boot: "));
+            print_symbols(p, '.', boot_progress_len);
+            print_symbols(p, '\b', boot_progress_len);
+            fflush(p->out);
+            for (addr=0; addr<p->boot_bytes; addr+=p->blocksz) {
+                if (! p->boot_dirty [addr / p->blocksz])
+                    continue;
+
+                /* Program a contiguous range of dirty blocks at once. */
+                for (end=addr+p->blocksz; end<p->boot_bytes && end-addr<MAXRUNSZ; end+=p->blocksz)
+                    if (! p->boot_dirty [end / p->blocksz])
+                        break;
+                program_range(p, addr + (p->bootv_kseg ? BOOTV_KSEG1_BASE : BOOTV_KSEG0_BASE), end - addr);
+                for (; addr<end; addr+=p->blocksz)
+                    progress(p, 1);
+                addr -= p->blocksz;
+            }
+            fprintf(p->out, _("# done      \n"));
+            if (! p->boot_dirty [p->devcfg_offset / p->blocksz]) {
+                /* Write chip configuration. */
+                if (FAMILY_MM == p->target->family->name_short){
+                    target_program_devcfg(p->target, fdevopt, ficd, fpor, fwdt, 
+                                            foscsel, fsec, afdevopt, aficd, 
+                                            afpor, afwdt, afoscsel, afsec, 0, 0);
+                }
+				else if (FAMILY_MK == p->target->family->name_short){
+					target_program_devcfg(p->target, bf1devcfg0, bf1devcfg1,
+						bf1devcfg2, bf1devcfg3, bf1devcp, bf1devsign, bf1seq,
+						bf2devcfg0, bf2devcfg1, bf2devcfg2, bf2devcfg3,
+						bf2devcp, bf2devsign, bf2seq);
+				}
+                else{
+                    target_program_devcfg(p->target, devcfg0, devcfg1, devcfg2, devcfg3,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+                }
+                p->boot_dirty [p->devcfg_offset / p->blocksz] = 1;
+            }
+        }
+    }
+    if (p->flash_used && !p->skip_verify) {
+        fprintf(p->out, _(" Verify flash: "));
+        print_symbols(p, '.', progress_len);
+        print_symbols(p, '\b', progress_len);
+        fflush(p->out);
+        for (addr=0; addr<p->flash_bytes; addr+=p->blocksz) {
+            if (! p->flash_dirty [addr / p->blocksz])
+                continue;
+
+            /* Verify a contiguous range of dirty blocks at once. */
+            for (end=addr+p->blocksz; end<p->flash_bytes; end+=p->blocksz)
+                if (! p->flash_dirty [end / p->blocksz])
+                    break;
+            if (! verify_range(p, addr + (p->flashv_kseg ? FLASHV_KSEG1_BASE : FLASHV_KSEG0_BASE), end - addr))
+                session_abort(1);
+            for (; addr<end; addr+=p->blocksz)
+                progress(p, progress_step);
+        }
+        fprintf(p->out, _(" done\n"));
+    }
+    if (p->boot_used && !p->skip_verify) {
+        fprintf(p->out, _("  Verify boot: "));
+        print_symbols(p, '.', boot_progress_len);
+        print_symbols(p, '\b', boot_progress_len);
+        fflush(p->out);
+        for (addr=0; addr<p->boot_bytes; addr+=p->blocksz) {
+            if (! p->boot_dirty [addr / p->blocksz])
+                continue;
+
+            /* Verify a contiguous range of dirty blocks at once. */
+            for (end=addr+p->blocksz; end<p->boot_bytes; end+=p->blocksz)
+                if (! p->boot_dirty [end / p->blocksz])
+                    break;
+            if (! verify_range(p, addr + (p->bootv_kseg ? BOOTV_KSEG1_BASE : BOOTV_KSEG0_BASE), end - addr))
+                session_abort(1);
+            for (; addr<end; addr+=p->blocksz)
+                progress(p, 1);
+        }
+        fprintf(p->out, _(" done       \n"));
+    }
+    if (p->boot_used || p->flash_used)
+        fprintf(p->out, _(" Program rate: %ld bytes per second\n"),
+            p->total_bytes * 1000L / mseconds_elapsed(&t0));
+}
+
+/*
+ * Arguments of the read operation.
+ */
+typedef struct {
+    FILE        *fd;
+    const char  *filename;
+    unsigned    base;
+    unsigned    nbytes;
+} read_args_t;
+
+static void do_read(pic32prog_t *p, void *arg)
+{
+    read_args_t *r = arg;
+    unsigned len, addr, data [256], progress_step;
+    unsigned base = r->base, nbytes = r->nbytes;
+    struct timeval t0;
+
+    fprintf(p->out, _("       Memory: total %d bytes\n"), nbytes);
+
+    /* Use 1kbyte blocks. */
+    p->blocksz = 1024;
+
+    do_open(p, 0);
+
+    if ((p->target->adapter->flags & AD_READ) == 0) {
+        fprintf(stderr, _("Error: Target read not supported.\n"));
+        session_abort(1);
+    }
+
+    target_use_executive(p->target);
+    for (progress_step=1; ; progress_step<<=1) {
+        len = 1 + nbytes / progress_step / p->blocksz;
+        if (len < 64)
+            break;
+    }
+    fprintf(p->out, "         Read: " );
+    print_symbols(p, '.', len);
+    print_symbols(p, '\b', len);
+    fflush(p->out);
+
+    p->progress_count = 0;
+    gettimeofday(&t0, 0);
+    for (addr=base; addr-base<nbytes; addr+=p->blocksz) {
+        progress(p, progress_step);
+        target_read_block(p->target, addr, p->blocksz/4, data);
+        if (fwrite(data, 1, p->blocksz, r->fd) != p->blocksz) {
+            fprintf(stderr, "%s: write error!\n", r->filename);
+            session_abort(1);
+        }
+    }
+    fprintf(p->out, _("# done\n"));
+    fprintf(p->out, _("         Rate: %ld bytes per second\n"),
+        nbytes * 1000L / mseconds_elapsed(&t0));
+}
+
+int pic32prog_open(pic32prog_t *p)
+{
+    return session_run(p, do_open, 0);
+}
+
+int pic32prog_probe(pic32prog_t *p)
+{
+    return session_run(p, do_probe, 0);
+}
+
+int pic32prog_erase(pic32prog_t *p)
+{
+    return session_run(p, do_erase, 0);
+}
+
+int pic32prog_program(pic32prog_t *p)
+{
+    return session_run(p, do_program, 0);
+}
+
+int pic32prog_read(pic32prog_t *p, const char *filename,
+    unsigned base, unsigned nbytes)
+{
+    read_args_t r;
+    int status;
+
+    r.fd = fopen(filename, "wb");
+    if (! r.fd) {
+        perror(filename);
+        return 1;
+    }
+    r.filename = filename;
+    r.base = base;
+    r.nbytes = nbytes;
+    status = session_run(p, do_read, &r);
+    fclose(r.fd);
+    return status;
+}
@@ -0,0 +1,129 @@
+/*
+ * Library interface of PIC32PROG: programming session,
+ * which owns the image, the options and the target.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+
+#ifndef _LIBPIC32PROG_H
+#define _LIBPIC32PROG_H
+
+#include <stdio.h>
+#include <sys/time.h>
+#include "target.h"
+
+#define FLASH_BYTES     (2048 * 1024)
+#define BOOT_BYTES      (512 * 1024)    // Fix for MK family, space is 404kB big
+#define MINBLOCKSZ      128
+
+/*
+ * Programming session.
+ * Sessions are independent of each other: every one has its own
+ * image buffers, table of chip variants and target.
+ */
+typedef struct {
+    /* Options, set by the caller */
+    const char      *progname;          /* Used to find pic32prog.conf */
+    const char      *port;              /* Name of serial or USB port, or 0 */
+    int             baud_rate;          /* Baud rate for serial port */
+    int             alt_baud_rate;      /* Alternate speed for serial port */
+    int             interface;          /* Optionally specified JTAG or ICSP */
+    int             interface_speed;    /* Optional clock speed of interface */
+    int             debug_level;
+    int             power_on;           /* Leave board powered on at close */
+    int             verify_only;
+    int             skip_verify;
+    int             update_only;
+    int             region_only;
+    int             blank_check;
+    FILE            *out;               /* Messages and progress */
+
+    /* Data to write */
+    unsigned char   *boot_data;
+    unsigned char   *flash_data;
+    unsigned char   *boot_dirty;
+    unsigned char   *flash_dirty;
+    unsigned        boot_used;
+    unsigned        flash_used;
+    unsigned char   bootv_kseg;         /* Boot data in KSEG1 or KSEG0 */
+    unsigned char   flashv_kseg;        /* Flash data in KSEG1 or KSEG0 */
+    int             total_bytes;
+
+    /* Target */
+    variant_t       *variants;          /* Chip variants, with pic32prog.conf */
+    target_t        *target;
+    unsigned        blocksz;            /* Size of flash memory block */
+    unsigned        boot_bytes;
+    unsigned        flash_bytes;
+    unsigned        devcfg_offset;      /* Offset of devcfg registers in boot data */
+    unsigned        progress_count;
+} pic32prog_t;
+
+/*
+ * Library calls return 0 on success, or the error status,
+ * after printing the error message to stderr.
+ * After an error the target is closed, and opened again
+ * by the next call.
+ */
+
+/*
+ * Create a session with default options and empty image.
+ * Return 0 when out of memory.
+ */
+pic32prog_t *pic32prog_new(const char *progname);
+
+/*
+ * Close the target and free the session.
+ */
+void pic32prog_free(pic32prog_t *p);
+
+/*
+ * Clear the image and the programming mode options.
+ * The target stays open.
+ */
+void pic32prog_clear(pic32prog_t *p);
+
+/*
+ * Load the image from a file in SREC or Intel HEX format.
+ */
+int pic32prog_load(pic32prog_t *p, const char *filename);
+
+/*
+ * Open and detect the target, when not opened yet.
+ */
+int pic32prog_open(pic32prog_t *p);
+
+/*
+ * Close the target, when opened.
+ */
+int pic32prog_close(pic32prog_t *p);
+
+/*
+ * Print the processor type and configuration registers.
+ */
+int pic32prog_probe(pic32prog_t *p);
+
+/*
+ * Erase the chip.
+ */
+int pic32prog_erase(pic32prog_t *p);
+
+/*
+ * Write the image to the target and verify it.
+ */
+int pic32prog_program(pic32prog_t *p);
+
+/*
+ * Read a memory region of the target to a binary file.
+ */
+int pic32prog_read(pic32prog_t *p, const char *filename,
+    unsigned base, unsigned nbytes);
+
+/*
+ * Milliseconds since the given time.
+ */
+unsigned mseconds_elapsed(struct timeval *t0);
+
+#endif
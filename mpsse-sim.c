@@ -0,0 +1,1396 @@
+/*
+ * Emulator of FT2232 adapter in MPSSE mode, with PIC32 attached to it.
+ * Replaces libusb for adapter-mpsse.c, compiled with -DMPSSE_SIM,
+ * so that the adapter can be run and measured without hardware.
+ *
+ * The emulated device is an FT2232H with default identifiers,
+ * wired like Bus Blaster.  MPSSE commands are interpreted down
+ * to TCK clocks of the JTAG port.  The PIC32 is modelled by:
+ *  - MTAP and ETAP controllers, with IDCODE, MCHP command,
+ *    EJTAG control, address, data and FASTDATA registers;
+ *  - processor in serial execution mode, which executes
+ *    the few MIPS32 instructions used by pic32prog;
+ *  - PE loader, and programming executive at command level,
+ *    with flash memory of the real size and page erase.
+ * ICSP mode of the adapter and microMIPS code of PIC32MM
+ * are not modelled.
+ *
+ * Environment variable PIC32PROG_MPSSE_SIM sets the parameters:
+ *      [cpu][,latency=usec][,busy=scans][,file=image]
+ *
+ * cpu      - name of chip variant, or CPUID in hex; default MX795F512L
+ * latency  - time of every USB transfer; when given, the transfers
+ *            also take time to clock the JTAG bits at TCK rate
+ * busy     - PE programs flash after every 64 words of a cluster,
+ *            and reads flash for every 64 words of a response;
+ *            meanwhile it does not take or give a word for the given
+ *            number of scans
+ * file     - load flash memory from the image file, save at close
+ *
+ * USB transfers are counted per operation of the target, and
+ * the statistics is printed when the device is closed.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+
+#include "mpsse-sim.h"
+#include "target.h"
+#include "pic32.h"
+
+#define SIM_VID         0x0403          /* FT2232H default */
+#define SIM_PID         0x6010
+#define SIM_PRODUCT     "Dual RS232-HS"
+#define SIM_PACKET      512             /* High speed bulk packet */
+#define SYSRST_PIN      0x0200          /* Bus Blaster, active low */
+#define TMS_PIN         0x0008
+
+#define FIFO_SIZE       (64*1024)       /* Replies of MPSSE commands */
+#define CMD_SIZE        (16*1024)       /* Partial MPSSE command */
+#define MAX_INFLIGHT    8               /* Asynchronous transfers */
+
+#define FLASH_BASE      0x1d000000
+#define BOOT_BASE       0x1fc00000
+#define BOOT_NBYTES     (512 * 1024)
+#define RAM_NBYTES      (128 * 1024)
+#define BMXDMSZ         0x1f882040      /* Size of data RAM */
+#define DMSEG           0xff200000      /* Debug memory segment */
+#define DMSEG_END       0xff400000
+#define DEBUG_VECTOR    0xff200200
+#define PE_LOADER_ADDR  0xa0000800
+
+#define RESPONSE_QUEUE  4096            /* Enough for PE_READ of 1024 words */
+
+/* MPSSE opcode bits. */
+#define CLKWNEG         0x01
+#define BITMODE         0x02
+#define CLKRNEG         0x04
+#define LSB             0x08
+#define WTDI            0x10
+#define RTDO            0x20
+#define WTMS            0x40
+
+/* FTDI vendor requests. */
+#define SIO_RESET               0
+#define SIO_SET_LATENCY_TIMER   9
+#define SIO_GET_LATENCY_TIMER   10
+#define SIO_SET_BITMODE         11
+
+/*
+ * States of TAP controller.
+ */
+enum {
+    RESET, IDLE,
+    SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+    SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+static const unsigned char next_state[16][2] = {
+    /* TMS=0        TMS=1 */
+    { IDLE,         RESET     },    /* RESET */
+    { IDLE,         SELECT_DR },    /* IDLE */
+    { CAPTURE_DR,   SELECT_IR },    /* SELECT_DR */
+    { SHIFT_DR,     EXIT1_DR  },    /* CAPTURE_DR */
+    { SHIFT_DR,     EXIT1_DR  },    /* SHIFT_DR */
+    { PAUSE_DR,     UPDATE_DR },    /* EXIT1_DR */
+    { PAUSE_DR,     EXIT2_DR  },    /* PAUSE_DR */
+    { SHIFT_DR,     UPDATE_DR },    /* EXIT2_DR */
+    { IDLE,         SELECT_DR },    /* UPDATE_DR */
+    { CAPTURE_IR,   RESET     },    /* SELECT_IR */
+    { SHIFT_IR,     EXIT1_IR  },    /* CAPTURE_IR */
+    { SHIFT_IR,     EXIT1_IR  },    /* SHIFT_IR */
+    { PAUSE_IR,     UPDATE_IR },    /* EXIT1_IR */
+    { PAUSE_IR,     EXIT2_IR  },    /* PAUSE_IR */
+    { SHIFT_IR,     UPDATE_IR },    /* EXIT2_IR */
+    { IDLE,         SELECT_DR },    /* UPDATE_IR */
+};
+
+/*
+ * Modes of the processor.
+ */
+enum {
+    CPU_RUN,                    /* Running user code, not accessible */
+    CPU_DEBUG,                  /* Serial execution from dmseg */
+    CPU_LOADER,                 /* PE loader, reads words from FASTDATA */
+    CPU_PE,                     /* Programming executive */
+};
+
+/*
+ * Pending processor access in debug mode.
+ */
+enum { ACC_NONE, ACC_FETCH, ACC_LOAD, ACC_STORE };
+
+struct libusb_context { int unused; };
+struct libusb_device { int unused; };
+struct libusb_device_handle { int unused; };
+
+static libusb_context sim_context;
+static libusb_device sim_device;
+static libusb_device_handle sim_handle;
+
+/*
+ * Target chip and memory.
+ */
+static const variant_t *variant;
+static const family_t *family;
+static unsigned idcode;
+static unsigned char *flash, *boot, *ram;
+static unsigned flash_nbytes;
+static char *filename;
+
+/*
+ * USB device.
+ */
+static unsigned latency_usec;           /* Timing is off when zero */
+static unsigned latency_timer = 16;
+static unsigned char fifo [FIFO_SIZE];  /* Replies to host */
+static int fifo_head, fifo_tail;
+static unsigned char cmd [CMD_SIZE];    /* Incomplete MPSSE command */
+static int cmd_len;
+static struct libusb_transfer *inflight [MAX_INFLIGHT];
+static unsigned long long inflight_due [MAX_INFLIGHT];
+static int inflight_first, inflight_count;
+static unsigned long long busy_until;
+static int empty_reads;
+
+/*
+ * MPSSE engine and pins.
+ */
+static unsigned pins = SYSRST_PIN | TMS_PIN;
+static unsigned divisor;
+static int div5 = 1;
+static unsigned long long clocks;       /* TCK clocks in this transfer */
+
+/*
+ * TAP controllers.
+ */
+static int state = RESET;
+static int ir = MTAP_IDCODE;
+static int etap;                        /* ETAP selected, else MTAP */
+static unsigned long long sr;           /* Shift register */
+static int sr_len;
+static int fastdata_ready;              /* PrAcc of FASTDATA at capture */
+static int flash_busy;                  /* Status reads with FCBUSY */
+
+/*
+ * Processor.
+ */
+static int cpu_mode = CPU_RUN;
+static int rst_pin, rst_mtap;           /* Reset is active */
+static int ejtagboot;                   /* Enter debug mode on reset */
+static unsigned ctl_probe;              /* Bits of control register, set by probe */
+static unsigned data_reg;               /* EJTAG data register */
+static unsigned reg [32];
+static unsigned pc;
+static int in_delay_slot;
+static unsigned jump_target;
+static int acc;                         /* Pending access */
+static unsigned acc_addr, acc_data, acc_reg;
+static int deferred;                    /* Access after the next fetch */
+static unsigned deferred_addr, deferred_data, deferred_reg;
+static unsigned held_insn;              /* Fetched, waits for the access */
+
+/* PE loader. */
+static int loader_state;
+static unsigned loader_addr, loader_count;
+
+/* Programming executive. */
+static unsigned pe_cmd [6];
+static int pe_nin, pe_need;
+static unsigned pe_addr, pe_left, pe_status;
+static unsigned pe_busy_scans, pe_busy;
+static unsigned response [RESPONSE_QUEUE];
+static int resp_head, resp_count;
+static unsigned resp_taken;
+
+/*
+ * Statistics, per operation of the target.
+ */
+typedef struct {
+    const char *name;
+    unsigned count;
+    unsigned writes;
+    unsigned reads;
+    unsigned long long bytes;
+} opstat_t;
+
+static opstat_t opstat [24];
+static int nops;
+static opstat_t *op;
+static unsigned long long total_clocks, sim_usec;
+static unsigned ninsns, nunknown, nwords_read, ndirty;
+
+/*
+ * Start a new operation for the statistics.
+ */
+static void sim_op(const char *name)
+{
+    int i;
+
+    for (i=0; i<nops; i++)
+        if (strcmp(opstat[i].name, name) == 0)
+            break;
+    if (i == nops) {
+        if (nops >= (int) (sizeof(opstat) / sizeof(opstat[0])))
+            i = nops - 1;
+        else
+            opstat[nops++].name = name;
+    }
+    op = &opstat[i];
+    op->count++;
+}
+
+static unsigned long long now_usec()
+{
+    struct timeval t;
+
+    gettimeofday(&t, 0);
+    return t.tv_sec * 1000000ULL + t.tv_usec;
+}
+
+/*
+ * Find memory for the given address range.
+ * Return 0 when there is no memory.
+ */
+static unsigned char *sim_memory(unsigned addr, unsigned nbytes)
+{
+    addr &= 0x1fffffff;
+    if (addr >= FLASH_BASE && addr + nbytes <= FLASH_BASE + flash_nbytes)
+        return flash + addr - FLASH_BASE;
+    if (addr >= BOOT_BASE && addr + nbytes <= BOOT_BASE + BOOT_NBYTES)
+        return boot + addr - BOOT_BASE;
+    if (addr + nbytes <= RAM_NBYTES)
+        return ram + addr;
+    return 0;
+}
+
+static unsigned mem_read(unsigned addr)
+{
+    unsigned char *mem = sim_memory(addr, 4);
+    unsigned word = 0;
+
+    if (mem)
+        memcpy(&word, mem, 4);
+    else if ((addr & 0x1fffffff) == BMXDMSZ)
+        word = RAM_NBYTES;
+    return word;
+}
+
+/*
+ * Store by processor: only RAM is writable.
+ * Stores to peripheral registers are ignored.
+ */
+static void mem_write(unsigned addr, unsigned word)
+{
+    if ((addr & 0x1fffffff) + 4 <= RAM_NBYTES)
+        memcpy(ram + (addr & 0x1fffffff), &word, 4);
+}
+
+/*
+ * Program flash words. Programming can only clear bits.
+ * Return 0 on bad address.
+ */
+static int flash_program(unsigned addr, const unsigned *data, unsigned nwords)
+{
+    unsigned char *mem = sim_memory(addr, nwords * 4);
+    unsigned i, word;
+
+    if (! mem || (addr & 0x1fffffff) < FLASH_BASE || (addr & 3))
+        return 0;
+    for (i=0; i<nwords; i++) {
+        memcpy(&word, mem, 4);
+        if ((word & data[i]) != data[i])
+            ndirty++;
+        word &= data[i];
+        memcpy(mem, &word, 4);
+        mem += 4;
+    }
+    return 1;
+}
+
+static void flash_erase()
+{
+    memset(flash, 0xff, flash_nbytes);
+    memset(boot, 0xff, BOOT_NBYTES);
+}
+
+/*
+ * Queue a word, written by PE to the host.
+ */
+static void pe_respond(unsigned word)
+{
+    if (resp_count >= RESPONSE_QUEUE) {
+        fprintf(stderr, "mpsse-sim: PE response queue overflow\n");
+        exit(-1);
+    }
+    response[(resp_head + resp_count) % RESPONSE_QUEUE] = word;
+    resp_count++;
+}
+
+/*
+ * Execute a PE command, when all header words are received.
+ * Commands with data continue in pe_input().
+ */
+static void pe_execute()
+{
+    unsigned code = pe_cmd[0] >> 16;
+    unsigned len = pe_cmd[0] & 0xffff;
+    unsigned addr = pe_cmd[1];
+    unsigned char *mem;
+    unsigned i, status = 0;
+
+    switch (code) {
+    case PE_ROW_PROGRAM:
+        /* Data words follow. */
+        pe_addr = addr;
+        pe_left = len;
+        pe_status = (len * 4 != family->bytes_per_row ||
+                     addr % family->bytes_per_row != 0);
+        if (pe_left > 0)
+            return;
+        status = pe_status;
+        break;
+    case PE_PROGRAM_CLUSTER:
+        pe_addr = addr;
+        pe_left = pe_cmd[2] / 4;
+        pe_status = 0;
+        if (pe_left > 0)
+            return;
+        break;
+    case PE_READ:
+        pe_respond(code << 16);
+        for (i=0; i<len; i++)
+            pe_respond(mem_read(addr + i*4));
+        return;
+    case PE_WORD_PROGRAM:
+        status = ! flash_program(addr, &pe_cmd[2], 1);
+        break;
+    case PE_DOUBLE_WORD_PGRM:
+        status = ! flash_program(addr, &pe_cmd[2], 2);
+        break;
+    case PE_QUAD_WORD_PGRM:
+        status = ! flash_program(addr, &pe_cmd[2], 4);
+        break;
+    case PE_CHIP_ERASE:
+        flash_erase();
+        break;
+    case PE_PAGE_ERASE:
+        if (addr % family->page_bytes != 0) {
+            status = 1;
+            break;
+        }
+        mem = sim_memory(addr, len * family->page_bytes);
+        if (mem && (addr & 0x1fffffff) >= FLASH_BASE)
+            memset(mem, 0xff, len * family->page_bytes);
+        else
+            status = 1;
+        break;
+    case PE_BLANK_CHECK:
+        mem = sim_memory(addr, pe_cmd[2]);
+        if (! mem) {
+            status = 1;
+            break;
+        }
+        for (i=0; i<pe_cmd[2]; i++)
+            if (mem[i] != 0xff) {
+                status = 1;
+                break;
+            }
+        break;
+    case PE_EXEC_VERSION:
+        status = family->pe_version;
+        break;
+    case PE_GET_CRC:
+        mem = sim_memory(addr, pe_cmd[2]);
+        pe_respond(code << 16 | ! mem);
+        pe_respond(mem ? pic32_crc16(0xffff, mem, pe_cmd[2]) : 0);
+        return;
+    case PE_GET_DEVICEID:
+        pe_respond(code << 16);
+        pe_respond(idcode);
+        return;
+    default:
+        fprintf(stderr, "mpsse-sim: unknown PE command %08x\n", pe_cmd[0]);
+        status = 0xffff;
+        break;
+    }
+    pe_respond(code << 16 | status);
+}
+
+/*
+ * Word from host to PE, through FASTDATA.
+ */
+static void pe_input(unsigned word)
+{
+    static const char *const name[16] = {
+        "pe row program", "pe read", "pe program", "pe word program",
+        "pe chip erase", "pe page erase", "pe blank check", "pe version",
+        "pe get crc", "pe cluster program", "pe device id", "pe change cfg",
+        "pe command c", "pe quad word", "pe double word", "pe command f",
+    };
+
+    if (pe_left > 0) {
+        /* Data of row or cluster. */
+        if (! flash_program(pe_addr, &word, 1))
+            pe_status = 1;
+        pe_addr += 4;
+        if (pe_left % 64 == 1 && pe_left > 1 &&
+            (pe_cmd[0] >> 16) == PE_PROGRAM_CLUSTER)
+            pe_busy = pe_busy_scans;
+        if (--pe_left == 0)
+            pe_respond((pe_cmd[0] & 0xffff0000) | pe_status);
+        return;
+    }
+    if (pe_nin == 0) {
+        switch (word >> 16) {
+        case PE_ROW_PROGRAM:
+        case PE_READ:
+        case PE_PAGE_ERASE:
+            pe_need = 2;
+            break;
+        case PE_WORD_PROGRAM:
+        case PE_BLANK_CHECK:
+        case PE_GET_CRC:
+        case PE_PROGRAM_CLUSTER:
+            pe_need = 3;
+            break;
+        case PE_DOUBLE_WORD_PGRM:
+            pe_need = 4;
+            break;
+        case PE_QUAD_WORD_PGRM:
+            pe_need = 6;
+            break;
+        default:
+            pe_need = 1;
+            break;
+        }
+        sim_op(name[(word >> 16) & 15]);
+    }
+    pe_cmd[pe_nin++] = word;
+    if (pe_nin < pe_need)
+        return;
+    pe_nin = 0;
+    pe_execute();
+}
+
+/*
+ * Word from host to PE loader, through FASTDATA.
+ * The loader receives blocks of address and count, followed by data.
+ * Zero address is followed by the jump to the PE.
+ */
+static void loader_input(unsigned word)
+{
+    switch (loader_state) {
+    case 0:
+        if (word == 0) {
+            loader_state = 3;
+            break;
+        }
+        loader_addr = word;
+        loader_state = 1;
+        break;
+    case 1:
+        loader_count = word;
+        loader_state = (word > 0) ? 2 : 0;
+        break;
+    case 2:
+        mem_write(loader_addr, word);
+        loader_addr += 4;
+        if (--loader_count == 0)
+            loader_state = 0;
+        break;
+    case 3:
+        /* Jump to PE. */
+        cpu_mode = CPU_PE;
+        pe_nin = 0;
+        pe_left = 0;
+        resp_count = 0;
+        break;
+    }
+}
+
+/*
+ * Processor enters debug mode, and fetches from the debug vector.
+ */
+static void enter_debug()
+{
+    cpu_mode = CPU_DEBUG;
+    pc = DEBUG_VECTOR;
+    in_delay_slot = 0;
+    deferred = ACC_NONE;
+    acc = ACC_FETCH;
+    acc_addr = pc;
+    sim_op("serial execution");
+}
+
+/*
+ * Change of reset signal, from pin or from MTAP.
+ */
+static void cpu_reset(int pin, int mtap)
+{
+    int was_reset = rst_pin || rst_mtap;
+
+    rst_pin = pin;
+    rst_mtap = mtap;
+    if (rst_pin || rst_mtap) {
+        cpu_mode = CPU_RUN;
+        acc = ACC_NONE;
+        resp_count = 0;
+    } else if (was_reset && ejtagboot) {
+        enter_debug();
+    }
+}
+
+/*
+ * Execute one instruction in serial execution mode.
+ */
+static void cpu_execute(unsigned insn)
+{
+    unsigned opcode = insn >> 26;
+    unsigned rs = (insn >> 21) & 31;
+    unsigned rt = (insn >> 16) & 31;
+    unsigned imm = insn & 0xffff;
+    unsigned simm = (int) (short) imm;
+    unsigned addr = reg[rs] + simm;
+    int delay_slot = in_delay_slot;
+
+    ninsns++;
+    in_delay_slot = 0;
+    switch (opcode) {
+    case 0x00:
+        if ((insn & 0x3f) == 0x08) {            /* jr */
+            jump_target = reg[rs];
+            in_delay_slot = 1;
+        } else if (insn != 0) {
+            goto unknown;
+        }
+        break;
+    case 0x09:                                  /* addiu */
+        reg[rt] = reg[rs] + simm;
+        break;
+    case 0x0d:                                  /* ori */
+        reg[rt] = reg[rs] | imm;
+        break;
+    case 0x0f:                                  /* lui */
+        reg[rt] = imm << 16;
+        break;
+    case 0x23:                                  /* lw */
+        if (addr >= DMSEG && addr < DMSEG_END) {
+            deferred = ACC_LOAD;
+            deferred_addr = addr;
+            deferred_reg = rt;
+        } else {
+            reg[rt] = mem_read(addr);
+        }
+        break;
+    case 0x2b:                                  /* sw */
+        if (addr >= DMSEG && addr < DMSEG_END) {
+            deferred = ACC_STORE;
+            deferred_addr = addr;
+            deferred_data = reg[rt];
+        } else {
+            mem_write(addr, reg[rt]);
+        }
+        break;
+    default:
+unknown:
+        nunknown++;
+        if (debug_level > 0)
+            fprintf(stderr, "mpsse-sim: unknown instruction %08x at %08x\n",
+                insn, pc);
+        break;
+    }
+    reg[0] = 0;
+    pc += 4;
+
+    if (delay_slot) {
+        pc = jump_target;
+        if (pc < DMSEG || pc >= DMSEG_END) {
+            /* Leave debug mode. */
+            acc = ACC_NONE;
+            if (pc == PE_LOADER_ADDR) {
+                cpu_mode = CPU_LOADER;
+                loader_state = 0;
+                sim_op("pe download");
+            } else
+                cpu_mode = CPU_RUN;
+            return;
+        }
+    }
+    acc = ACC_FETCH;
+    acc_addr = pc;
+}
+
+/*
+ * Probe completes the pending processor access.
+ * Data of fetch or load are taken from the data register.
+ * Memory access of an instruction comes after the fetch
+ * of the next instruction, like in the pipeline.
+ */
+static void cpu_complete(unsigned data)
+{
+    switch (acc) {
+    case ACC_FETCH:
+        if (deferred != ACC_NONE) {
+            held_insn = data;
+            acc = deferred;
+            acc_addr = deferred_addr;
+            acc_data = deferred_data;
+            acc_reg = deferred_reg;
+            deferred = ACC_NONE;
+            return;
+        }
+        cpu_execute(data);
+        break;
+    case ACC_LOAD:
+        reg[acc_reg] = data;
+        reg[0] = 0;
+        /* fall through */
+    case ACC_STORE:
+        if (acc_addr == DMSEG)
+            nwords_read++;
+        cpu_execute(held_insn);
+        break;
+    }
+}
+
+/*
+ * PE is busy with flash memory for a number of scans.
+ */
+static int pe_is_busy()
+{
+    if (pe_busy > 0) {
+        pe_busy--;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Processor access is pending: value of PrAcc bit.
+ */
+static int cpu_pracc()
+{
+    if (cpu_mode == CPU_DEBUG)
+        return acc != ACC_NONE;
+    if (cpu_mode == CPU_PE)
+        return resp_count > 0 && ! pe_is_busy();
+    return 0;
+}
+
+/*
+ * PE response is taken by probe.
+ */
+static void pe_response_taken()
+{
+    resp_head = (resp_head + 1) % RESPONSE_QUEUE;
+    resp_count--;
+    if (++resp_taken % 64 == 0 && resp_count > 0)
+        pe_busy = pe_busy_scans;
+}
+
+/*
+ * FASTDATA access can be completed: value of PrAcc bit
+ * in FASTDATA register.
+ */
+static int cpu_fastdata_ready()
+{
+    switch (cpu_mode) {
+    case CPU_DEBUG:
+        return (acc == ACC_LOAD || acc == ACC_STORE) &&
+            acc_addr >= DMSEG && acc_addr < DMSEG + 16;
+    case CPU_LOADER:
+        return 1;
+    case CPU_PE:
+        /* Load of the next input word, or store of a response. */
+        return ! pe_is_busy();
+    }
+    return 0;
+}
+
+/*
+ * Load the shift register on Capture-DR.
+ */
+static void capture_dr()
+{
+    unsigned status;
+
+    sr = 0;
+    sr_len = 32;
+    if (ir == MTAP_IDCODE) {
+        sr = idcode;
+    } else if (! etap && ir == MTAP_COMMAND) {
+        status = MCHP_STATUS_CPS | MCHP_STATUS_FAEN;
+        if (flash_busy > 0) {
+            status |= MCHP_STATUS_FCBUSY;
+            flash_busy--;
+        } else
+            status |= MCHP_STATUS_CFGRDY;
+        if (rst_pin || rst_mtap)
+            status |= MCHP_STATUS_DEVRST;
+        sr = status;
+        sr_len = MTAP_COMMAND_DR_NBITS;
+    } else if (etap && ir == ETAP_IMPCODE) {
+        sr = 0x20404000;
+    } else if (etap && ir == ETAP_CONTROL) {
+        sr = ctl_probe;
+        if (cpu_pracc()) {
+            sr |= CONTROL_PRACC;
+            if (cpu_mode == CPU_PE || acc == ACC_STORE)
+                sr |= CONTROL_PRNW;
+        }
+        if (cpu_mode == CPU_DEBUG)
+            sr |= CONTROL_DM;
+    } else if (etap && ir == ETAP_ADDRESS) {
+        sr = (cpu_mode == CPU_DEBUG) ? acc_addr : DMSEG;
+    } else if (etap && ir == ETAP_DATA) {
+        if (cpu_mode == CPU_DEBUG && acc == ACC_STORE)
+            sr = acc_data;
+        else if (cpu_mode == CPU_PE && resp_count > 0)
+            sr = response[resp_head];
+        else
+            sr = data_reg;
+    } else if (etap && ir == ETAP_FASTDATA) {
+        fastdata_ready = cpu_fastdata_ready();
+        sr = fastdata_ready;
+        if (fastdata_ready && cpu_mode == CPU_DEBUG && acc == ACC_STORE)
+            sr |= (unsigned long long) acc_data << 1;
+        if (fastdata_ready && cpu_mode == CPU_PE && resp_count > 0)
+            sr |= (unsigned long long) response[resp_head] << 1;
+        sr_len = 33;
+    } else {
+        sr_len = 1;                     /* Bypass */
+    }
+}
+
+/*
+ * Apply the shift register on Update-DR.
+ */
+static void update_dr()
+{
+    unsigned value = sr;
+
+    if (! etap && ir == MTAP_COMMAND) {
+        switch (value & 0xff) {
+        case MCHP_ASSERT_RST:
+            cpu_reset(rst_pin, 1);
+            break;
+        case MCHP_DEASSERT_RST:
+            cpu_reset(rst_pin, 0);
+            break;
+        case MCHP_ERASE:
+            sim_op("mtap chip erase");
+            flash_erase();
+            flash_busy = 3;
+            cpu_reset(rst_pin, 1);
+            break;
+        }
+    } else if (etap && ir == ETAP_DATA) {
+        data_reg = value;
+    } else if (etap && ir == ETAP_CONTROL) {
+        ctl_probe = value & (CONTROL_PROBEN | CONTROL_PROBTRAP | CONTROL_EJTAGBRK);
+        if (! (value & CONTROL_PRACC) && cpu_pracc()) {
+            if (cpu_mode == CPU_PE)
+                pe_response_taken();
+            else
+                cpu_complete(data_reg);
+        }
+    } else if (etap && ir == ETAP_FASTDATA && fastdata_ready) {
+        value = sr >> 1;
+        fastdata_ready = 0;
+        switch (cpu_mode) {
+        case CPU_DEBUG:
+            cpu_complete(value);
+            break;
+        case CPU_LOADER:
+            loader_input(value);
+            break;
+        case CPU_PE:
+            if (resp_count > 0)
+                pe_response_taken();
+            else
+                pe_input(value);
+            break;
+        }
+    }
+}
+
+/*
+ * Apply the instruction register on Update-IR.
+ */
+static void update_ir()
+{
+    ir = sr & 0x1f;
+    switch (ir) {
+    case TAP_SW_MTAP:
+        etap = 0;
+        break;
+    case TAP_SW_ETAP:
+        etap = 1;
+        break;
+    case ETAP_EJTAGBOOT:
+        if (etap)
+            ejtagboot = 1;
+        break;
+    case ETAP_NORMALBOOT:
+        if (etap)
+            ejtagboot = 0;
+        break;
+    }
+}
+
+/*
+ * One TCK clock of JTAG port.
+ * Return TDO, sampled on the rising edge.
+ */
+static int jtag_clock(int tdi, int tms)
+{
+    int tdo = 0;
+
+    clocks++;
+    switch (state) {
+    case CAPTURE_DR:
+        capture_dr();
+        break;
+    case CAPTURE_IR:
+        sr = 1;
+        sr_len = 5;
+        break;
+    case SHIFT_DR:
+    case SHIFT_IR:
+        tdo = sr & 1;
+        sr = (sr >> 1) | ((unsigned long long) tdi << (sr_len - 1));
+        break;
+    }
+    state = next_state[state][tms];
+
+    switch (state) {
+    case RESET:
+        ir = MTAP_IDCODE;
+        break;
+    case UPDATE_DR:
+        update_dr();
+        break;
+    case UPDATE_IR:
+        update_ir();
+        break;
+    }
+    return tdo;
+}
+
+static void fifo_put(int byte)
+{
+    if ((fifo_tail + 1) % FIFO_SIZE == fifo_head) {
+        fprintf(stderr, "mpsse-sim: receive buffer overflow\n");
+        exit(-1);
+    }
+    fifo[fifo_tail] = byte;
+    fifo_tail = (fifo_tail + 1) % FIFO_SIZE;
+}
+
+static void set_pins(unsigned value)
+{
+    int reset = ! (value & SYSRST_PIN);
+
+    pins = value;
+    if (reset != rst_pin)
+        cpu_reset(reset, rst_mtap);
+}
+
+/*
+ * Interpret one MPSSE command.
+ * Return the length of the command, or 0 when it is incomplete.
+ */
+static int mpsse_command(const unsigned char *p, int n)
+{
+    int opcode = p[0], len, nbits, i, k, tdi, tdo, reply;
+
+    if (opcode & 0x80) {
+        switch (opcode) {
+        case 0x80:                      /* Set data bits low byte */
+            if (n < 3)
+                return 0;
+            set_pins((pins & 0xff00) | p[1]);
+            return 3;
+        case 0x82:                      /* Set data bits high byte */
+            if (n < 3)
+                return 0;
+            set_pins((pins & 0x00ff) | p[1] << 8);
+            return 3;
+        case 0x81:                      /* Read data bits low byte */
+            fifo_put(pins);
+            return 1;
+        case 0x83:                      /* Read data bits high byte */
+            fifo_put(pins >> 8);
+            return 1;
+        case 0x86:                      /* Set TCK divisor */
+            if (n < 3)
+                return 0;
+            divisor = p[1] | p[2] << 8;
+            return 3;
+        case 0x8a:                      /* Disable clock divide by 5 */
+            div5 = 0;
+            return 1;
+        case 0x8b:                      /* Enable clock divide by 5 */
+            div5 = 1;
+            return 1;
+        case 0x8e:                      /* Clock n bits, no data */
+            if (n < 2)
+                return 0;
+            for (i=0; i<=p[1]; i++)
+                jtag_clock(0, (pins & TMS_PIN) != 0);
+            return 2;
+        case 0x8f:                      /* Clock n bytes, no data */
+            if (n < 3)
+                return 0;
+            for (i=0; i<((p[1] | p[2] << 8) + 1) * 8; i++)
+                jtag_clock(0, (pins & TMS_PIN) != 0);
+            return 3;
+        case 0x84: case 0x85:           /* Loopback on, off */
+        case 0x87:                      /* Send immediate */
+        case 0x8c: case 0x8d:           /* Three-phase clocking on, off */
+        case 0x96: case 0x97:           /* Adaptive clocking on, off */
+            return 1;
+        }
+        /* Bad command: the chip replies with 0xfa. */
+        fprintf(stderr, "mpsse-sim: bad MPSSE command %02x\n", opcode);
+        fifo_put(0xfa);
+        fifo_put(opcode);
+        return 1;
+    }
+
+    if (opcode & WTMS) {
+        /* Clock data to TMS pin, with TDI from bit 7. */
+        if (n < 3)
+            return 0;
+        nbits = p[1] + 1;
+        tdi = p[2] >> 7;
+        reply = 0;
+        for (i=0; i<nbits; i++) {
+            int tms = (p[2] >> i) & 1;
+
+            tdo = jtag_clock(tdi, tms);
+            pins = (pins & ~TMS_PIN) | (tms ? TMS_PIN : 0);
+            reply = (reply >> 1) | (tdo << 7);
+        }
+        if (opcode & RTDO)
+            fifo_put(reply);
+        return 3;
+    }
+
+    if (opcode & BITMODE) {
+        /* Clock bits of TDI. */
+        len = (opcode & WTDI) ? 3 : 2;
+        if (n < len)
+            return 0;
+        nbits = p[1] + 1;
+        reply = 0;
+        for (i=0; i<nbits; i++) {
+            tdi = 0;
+            if (opcode & WTDI)
+                tdi = (opcode & LSB) ? (p[2] >> i) & 1 : (p[2] >> (7 - i)) & 1;
+            tdo = jtag_clock(tdi, (pins & TMS_PIN) != 0);
+            if (opcode & LSB)
+                reply = (reply >> 1) | (tdo << 7);
+            else
+                reply = (reply << 1) | tdo;
+        }
+        if (opcode & RTDO)
+            fifo_put(reply);
+        return len;
+    }
+
+    /* Clock bytes of TDI. */
+    if (n < 3)
+        return 0;
+    nbits = ((p[1] | p[2] << 8) + 1) * 8;
+    len = 3 + ((opcode & WTDI) ? nbits / 8 : 0);
+    if (len > CMD_SIZE) {
+        fprintf(stderr, "mpsse-sim: too long MPSSE command\n");
+        exit(-1);
+    }
+    if (n < len)
+        return 0;
+    for (k=0; k<nbits/8; k++) {
+        int byte = (opcode & WTDI) ? p[3+k] : 0;
+
+        reply = 0;
+        for (i=0; i<8; i++) {
+            if (opcode & LSB) {
+                tdo = jtag_clock((byte >> i) & 1, (pins & TMS_PIN) != 0);
+                reply |= tdo << i;
+            } else {
+                tdo = jtag_clock((byte >> (7 - i)) & 1, (pins & TMS_PIN) != 0);
+                reply |= tdo << (7 - i);
+            }
+        }
+        if (opcode & RTDO)
+            fifo_put(reply);
+    }
+    return len;
+}
+
+/*
+ * Data from host to MPSSE engine.
+ * Commands can be split between transfers.
+ */
+static void mpsse_write(const unsigned char *data, int nbytes)
+{
+    int i, len;
+
+    if (cmd_len + nbytes > CMD_SIZE) {
+        fprintf(stderr, "mpsse-sim: command buffer overflow\n");
+        exit(-1);
+    }
+    memcpy(cmd + cmd_len, data, nbytes);
+    cmd_len += nbytes;
+
+    for (i=0; i<cmd_len; i+=len) {
+        len = mpsse_command(cmd + i, cmd_len - i);
+        if (len == 0)
+            break;
+    }
+    memmove(cmd, cmd + i, cmd_len - i);
+    cmd_len -= i;
+}
+
+/*
+ * Data from MPSSE engine to host: two bytes of modem status,
+ * and the replies, up to the packet size.
+ */
+static int mpsse_read(unsigned char *data, int nbytes)
+{
+    int n = 2;
+
+    data[0] = 0x32;
+    data[1] = 0x60;
+    while (n < nbytes && fifo_head != fifo_tail) {
+        data[n++] = fifo[fifo_head];
+        fifo_head = (fifo_head + 1) % FIFO_SIZE;
+    }
+    if (n > 2)
+        empty_reads = 0;
+    else if (++empty_reads > 10000) {
+        fprintf(stderr, "mpsse-sim: host waits for a reply, which never comes\n");
+        exit(-1);
+    }
+    return n;
+}
+
+/*
+ * Process a bulk transfer by the device.
+ * Return the time when the transfer is completed.
+ */
+static unsigned long long usb_transfer(unsigned char endpoint,
+    unsigned char *data, int length, int *actual)
+{
+    unsigned long long start, done, wire_usec, tck_hz;
+
+    clocks = 0;
+    if (endpoint & LIBUSB_ENDPOINT_IN) {
+        *actual = mpsse_read(data, length);
+        op->reads++;
+    } else {
+        mpsse_write(data, length);
+        *actual = length;
+        op->writes++;
+        op->bytes += length;
+    }
+    total_clocks += clocks;
+
+    /* Timing of the transfers. */
+    tck_hz = (div5 ? 6000000 : 30000000) / (divisor + 1);
+    wire_usec = clocks * 1000000 / tck_hz;
+    start = now_usec();
+    if (start < busy_until)
+        start = busy_until;
+    done = start + latency_usec + wire_usec;
+    sim_usec += latency_usec + wire_usec;
+    if (! (endpoint & LIBUSB_ENDPOINT_IN))
+        busy_until = done;
+    return latency_usec ? done : 0;
+}
+
+static void wait_until(unsigned long long t)
+{
+    unsigned long long now = now_usec();
+
+    if (t > now)
+        usleep(t - now);
+}
+
+/*
+ * Parse the parameters and find the chip variant.
+ */
+static int sim_configure(const char *spec)
+{
+    char buf[256], *p, *next;
+    const char *cpu = "MX795F512L";
+    const variant_t *tab = target_variants();
+    unsigned id = 0;
+    int i;
+
+    strncpy(buf, spec ? spec : "", sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    for (p = buf; p; p = next) {
+        next = strchr(p, ',');
+        if (next)
+            *next++ = 0;
+
+        if (strncmp(p, "latency=", 8) == 0)
+            latency_usec = strtoul(p + 8, 0, 0);
+        else if (strncmp(p, "busy=", 5) == 0)
+            pe_busy_scans = strtoul(p + 5, 0, 0);
+        else if (strncmp(p, "file=", 5) == 0)
+            filename = strdup(p + 5);
+        else if (*p)
+            cpu = p;
+    }
+    if (strchr(cpu, '=')) {
+        fprintf(stderr, "mpsse-sim: unknown option '%s'\n", cpu);
+        return 0;
+    }
+    if (cpu[0] >= '0' && cpu[0] <= '9')
+        id = strtoul(cpu, 0, 16);
+
+    for (i=0; tab[i].devid != 0; i++) {
+        if (id ? ((id ^ tab[i].devid) & 0x0fffffff) == 0 :
+                 strcasecmp(cpu, tab[i].name) == 0)
+            break;
+    }
+    if (tab[i].devid == 0 || tab[i].flash_kbytes == 0) {
+        fprintf(stderr, "mpsse-sim: unknown processor '%s'\n", cpu);
+        return 0;
+    }
+    variant = &tab[i];
+    family = tab[i].family;
+    idcode = tab[i].devid;
+    flash_nbytes = tab[i].flash_kbytes * 1024;
+    return 1;
+}
+
+int libusb_init(libusb_context **ctx)
+{
+    FILE *fd;
+
+    if (! flash) {
+        if (! sim_configure(getenv("PIC32PROG_MPSSE_SIM")))
+            exit(-1);
+        flash = malloc(flash_nbytes);
+        boot = malloc(BOOT_NBYTES);
+        ram = calloc(1, RAM_NBYTES);
+        if (! flash || ! boot || ! ram) {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+        flash_erase();
+        if (filename) {
+            fd = fopen(filename, "rb");
+            if (fd) {
+                if (fread(flash, 1, flash_nbytes, fd) != flash_nbytes ||
+                    fread(boot, 1, BOOT_NBYTES, fd) != BOOT_NBYTES)
+                    fprintf(stderr, "mpsse-sim: %s: short image\n", filename);
+                fclose(fd);
+            }
+        }
+        sim_op("connect");
+        printf("    Simulator: FT2232H with %s, %s family\n",
+            variant->name, family->name);
+    }
+    *ctx = &sim_context;
+    return 0;
+}
+
+const char *libusb_strerror(int errcode)
+{
+    return "Simulator error";
+}
+
+libusb_device_handle *libusb_open_device_with_vid_pid(libusb_context *ctx,
+    uint16_t vid, uint16_t pid)
+{
+    if (vid != SIM_VID || pid != SIM_PID)
+        return 0;
+    return &sim_handle;
+}
+
+libusb_device *libusb_get_device(libusb_device_handle *dev)
+{
+    return &sim_device;
+}
+
+int libusb_get_device_descriptor(libusb_device *dev,
+    struct libusb_device_descriptor *desc)
+{
+    memset(desc, 0, sizeof(*desc));
+    desc->idVendor = SIM_VID;
+    desc->idProduct = SIM_PID;
+    desc->iManufacturer = 1;
+    desc->iProduct = 2;
+    return 0;
+}
+
+int libusb_get_string_descriptor_ascii(libusb_device_handle *dev,
+    uint8_t index, unsigned char *data, int length)
+{
+    const char *str = (index == 2) ? SIM_PRODUCT : "FTDI";
+
+    if (length <= 0)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    strncpy((char*) data, str, length - 1);
+    data[length - 1] = 0;
+    return strlen((char*) data);
+}
+
+int libusb_get_max_packet_size(libusb_device *dev, unsigned char endpoint)
+{
+    return SIM_PACKET;
+}
+
+int libusb_kernel_driver_active(libusb_device_handle *dev, int interface)
+{
+    return 0;
+}
+
+int libusb_detach_kernel_driver(libusb_device_handle *dev, int interface)
+{
+    return 0;
+}
+
+int libusb_claim_interface(libusb_device_handle *dev, int interface)
+{
+    return 0;
+}
+
+int libusb_release_interface(libusb_device_handle *dev, int interface)
+{
+    return 0;
+}
+
+/*
+ * Close the device: print statistics and save the memory.
+ */
+void libusb_close(libusb_device_handle *dev)
+{
+    FILE *fd;
+    int i;
+
+    printf("mpsse-sim: %llu TCK clocks, %u instructions, %u words read by FASTDATA",
+        total_clocks, ninsns, nwords_read);
+    if (nunknown > 0)
+        printf(", %u unknown instructions", nunknown);
+    if (ndirty > 0)
+        printf(", %u writes to non-erased flash", ndirty);
+    printf("\n");
+    if (latency_usec)
+        printf("mpsse-sim: link time %llu.%03llu sec\n",
+            sim_usec / 1000000, sim_usec / 1000 % 1000);
+    printf("mpsse-sim: operation         count  writes   reads   bytes  writes/op\n");
+    for (i=0; i<nops; i++) {
+        if (opstat[i].writes == 0 && opstat[i].reads == 0)
+            continue;
+        printf("mpsse-sim: %-18s %6u %7u %7u %7llu %8.1f\n",
+            opstat[i].name, opstat[i].count, opstat[i].writes,
+            opstat[i].reads, opstat[i].bytes,
+            (double) opstat[i].writes / opstat[i].count);
+    }
+
+    if (filename) {
+        fd = fopen(filename, "wb");
+        if (! fd) {
+            perror(filename);
+        } else {
+            fwrite(flash, 1, flash_nbytes, fd);
+            fwrite(boot, 1, BOOT_NBYTES, fd);
+            fclose(fd);
+        }
+    }
+}
+
+int libusb_control_transfer(libusb_device_handle *dev, uint8_t request_type,
+    uint8_t request, uint16_t value, uint16_t index,
+    unsigned char *data, uint16_t length, unsigned timeout)
+{
+    switch (request) {
+    case SIO_RESET:
+        fifo_head = fifo_tail = 0;
+        cmd_len = 0;
+        break;
+    case SIO_SET_LATENCY_TIMER:
+        latency_timer = value;
+        break;
+    case SIO_GET_LATENCY_TIMER:
+        if (length < 1)
+            return LIBUSB_ERROR_INVALID_PARAM;
+        data[0] = latency_timer;
+        return 1;
+    case SIO_SET_BITMODE:
+        break;
+    }
+    return 0;
+}
+
+/*
+ * Synchronous bulk transfer.
+ */
+int libusb_bulk_transfer(libusb_device_handle *dev, unsigned char endpoint,
+    unsigned char *data, int length, int *transferred, unsigned timeout)
+{
+    wait_until(usb_transfer(endpoint, data, length, transferred));
+    return 0;
+}
+
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets)
+{
+    return calloc(1, sizeof(struct libusb_transfer));
+}
+
+void libusb_free_transfer(struct libusb_transfer *xfer)
+{
+    free(xfer);
+}
+
+/*
+ * Start asynchronous transfer. The data are processed at once,
+ * and the completion is reported by libusb_handle_events()
+ * when the simulated time of the transfer is over.
+ */
+int libusb_submit_transfer(struct libusb_transfer *xfer)
+{
+    int i;
+
+    if (inflight_count >= MAX_INFLIGHT)
+        return LIBUSB_ERROR_NO_MEM;
+    i = (inflight_first + inflight_count) % MAX_INFLIGHT;
+    inflight[i] = xfer;
+    inflight_due[i] = usb_transfer(xfer->endpoint, xfer->buffer,
+        xfer->length, &xfer->actual_length);
+    inflight_count++;
+    return 0;
+}
+
+/*
+ * Complete the transfers in order.
+ */
+int libusb_handle_events(libusb_context *ctx)
+{
+    struct libusb_transfer *xfer;
+
+    if (inflight_count == 0)
+        return 0;
+    xfer = inflight[inflight_first];
+    wait_until(inflight_due[inflight_first]);
+    inflight_first = (inflight_first + 1) % MAX_INFLIGHT;
+    inflight_count--;
+
+    xfer->status = LIBUSB_TRANSFER_COMPLETED;
+    xfer->callback(xfer);
+    return 0;
+}
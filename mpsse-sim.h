@@ -0,0 +1,128 @@
+/*
+ * Emulated FT2232 adapter with PIC32 target, for adapter-mpsse.c.
+ * When compiled with -DMPSSE_SIM, the adapter includes this file
+ * instead of libusb.h, and all the USB calls go to the emulator.
+ * Only the part of libusb API, used by the adapter, is provided.
+ *
+ * This file is part of PIC32PROG project, which is distributed
+ * under the terms of the GNU General Public License (GPL).
+ * See the accompanying file "COPYING" for more details.
+ */
+#ifndef _MPSSE_SIM_H
+#define _MPSSE_SIM_H
+
+#include <stdint.h>
+
+#define LIBUSB_CALL
+
+#define LIBUSB_SUCCESS                  0
+#define LIBUSB_ERROR_IO                 -1
+#define LIBUSB_ERROR_INVALID_PARAM      -2
+#define LIBUSB_ERROR_NOT_FOUND          -5
+#define LIBUSB_ERROR_INTERRUPTED        -10
+#define LIBUSB_ERROR_NO_MEM             -11
+
+#define LIBUSB_ENDPOINT_IN              0x80
+#define LIBUSB_ENDPOINT_OUT             0x00
+#define LIBUSB_REQUEST_TYPE_VENDOR      (2 << 5)
+#define LIBUSB_RECIPIENT_DEVICE         0
+#define LIBUSB_TRANSFER_TYPE_BULK       2
+
+enum libusb_transfer_status {
+    LIBUSB_TRANSFER_COMPLETED,
+    LIBUSB_TRANSFER_ERROR,
+    LIBUSB_TRANSFER_TIMED_OUT,
+};
+
+typedef struct libusb_context libusb_context;
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+struct libusb_device_descriptor {
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint8_t  iManufacturer;
+    uint8_t  iProduct;
+    uint8_t  iSerialNumber;
+};
+
+struct libusb_transfer;
+typedef void (*libusb_transfer_cb_fn)(struct libusb_transfer *xfer);
+
+struct libusb_transfer {
+    libusb_device_handle *dev_handle;
+    unsigned char endpoint;
+    unsigned char type;
+    unsigned timeout;
+    enum libusb_transfer_status status;
+    int length;
+    int actual_length;
+    libusb_transfer_cb_fn callback;
+    void *user_data;
+    unsigned char *buffer;
+};
+
+static inline void libusb_fill_bulk_transfer(struct libusb_transfer *xfer,
+    libusb_device_handle *dev, unsigned char endpoint,
+    unsigned char *buffer, int length, libusb_transfer_cb_fn callback,
+    void *user_data, unsigned timeout)
+{
+    xfer->dev_handle = dev;
+    xfer->endpoint = endpoint;
+    xfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+    xfer->timeout = timeout;
+    xfer->buffer = buffer;
+    xfer->length = length;
+    xfer->callback = callback;
+    xfer->user_data = user_data;
+}
+
+/*
+ * Names of emulated functions differ from libusb, so that
+ * the real library can still be linked in for other adapters.
+ */
+#define libusb_init                         sim_libusb_init
+#define libusb_strerror                     sim_libusb_strerror
+#define libusb_open_device_with_vid_pid     sim_libusb_open_device_with_vid_pid
+#define libusb_get_device                   sim_libusb_get_device
+#define libusb_get_device_descriptor        sim_libusb_get_device_descriptor
+#define libusb_get_string_descriptor_ascii  sim_libusb_get_string_descriptor_ascii
+#define libusb_get_max_packet_size          sim_libusb_get_max_packet_size
+#define libusb_kernel_driver_active         sim_libusb_kernel_driver_active
+#define libusb_detach_kernel_driver         sim_libusb_detach_kernel_driver
+#define libusb_claim_interface              sim_libusb_claim_interface
+#define libusb_release_interface            sim_libusb_release_interface
+#define libusb_close                        sim_libusb_close
+#define libusb_control_transfer             sim_libusb_control_transfer
+#define libusb_bulk_transfer                sim_libusb_bulk_transfer
+#define libusb_alloc_transfer               sim_libusb_alloc_transfer
+#define libusb_free_transfer                sim_libusb_free_transfer
+#define libusb_submit_transfer              sim_libusb_submit_transfer
+#define libusb_handle_events                sim_libusb_handle_events
+
+int libusb_init(libusb_context **ctx);
+const char *libusb_strerror(int errcode);
+libusb_device_handle *libusb_open_device_with_vid_pid(libusb_context *ctx,
+    uint16_t vid, uint16_t pid);
+libusb_device *libusb_get_device(libusb_device_handle *dev);
+int libusb_get_device_descriptor(libusb_device *dev,
+    struct libusb_device_descriptor *desc);
+int libusb_get_string_descriptor_ascii(libusb_device_handle *dev,
+    uint8_t index, unsigned char *data, int length);
+int libusb_get_max_packet_size(libusb_device *dev, unsigned char endpoint);
+int libusb_kernel_driver_active(libusb_device_handle *dev, int interface);
+int libusb_detach_kernel_driver(libusb_device_handle *dev, int interface);
+int libusb_claim_interface(libusb_device_handle *dev, int interface);
+int libusb_release_interface(libusb_device_handle *dev, int interface);
+void libusb_close(libusb_device_handle *dev);
+int libusb_control_transfer(libusb_device_handle *dev, uint8_t request_type,
+    uint8_t request, uint16_t value, uint16_t index,
+    unsigned char *data, uint16_t length, unsigned timeout);
+int libusb_bulk_transfer(libusb_device_handle *dev, unsigned char endpoint,
+    unsigned char *data, int length, int *transferred, unsigned timeout);
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer *xfer);
+int libusb_submit_transfer(struct libusb_transfer *xfer);
+int libusb_handle_events(libusb_context *ctx);
+
+#endif
@@ -26,6 +26,8 @@ extern const unsigned pic32_pemm_gpl[];
 extern const unsigned pic32_pemm_gpm[];
 extern const unsigned pic32_pemk[];
 
+unsigned pic32_crc16(unsigned crc, const unsigned char *data, unsigned nbytes);
+
 #define FAMILY_MX1	0
 #define FAMILY_MX3	1
 #define FAMILY_MZ	2
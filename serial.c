@@ -14,18 +14,31 @@
 #include <fcntl.h>
 #include <errno.h>
 #include "adapter.h"
+#include "serial.h"
 
 #if defined(__WIN32__) || defined(WIN32)
     #include <windows.h>
     #include <malloc.h>
-    static void *fd = INVALID_HANDLE_VALUE;
-    static DCB saved_mode;
 #else
     #include <termios.h>
-    static int fd = -1;
-    static struct termios saved_mode;
+    #include <poll.h>
 #endif
 
+/*
+ * Open serial port.
+ */
+struct _serial_t {
+#if defined(__WIN32__) || defined(WIN32)
+    void            *fd;
+    DCB             saved_mode;
+    int             timeout_msec;   /* Receive timeout, set on the port */
+#else
+    int             fd;
+    struct termios  saved_mode;
+    struct pollfd   pfd;            /* Wait for input */
+#endif
+};
+
 /*
  * Encode the speed in bits per second into bit value
  * accepted by cfsetspeed() function.
@@ -146,16 +159,16 @@ int serial_speed_valid(int bps)
  * Send data to device.
  * Return number of bytes, or -1 on error.
  */
-int serial_write(unsigned char *data, int len)
+int serial_write(serial_t *s, unsigned char *data, int len)
 {
 #if defined(__WIN32__) || defined(WIN32)
     DWORD written;
 
-    if (! WriteFile(fd, data, len, &written, 0))
+    if (! WriteFile(s->fd, data, len, &written, 0))
         return -1;
     return written;
 #else
-    return write(fd, data, len);
+    return write(s->fd, data, len);
 #endif
 }
 
@@ -163,49 +176,44 @@ int serial_write(unsigned char *data, int len)
  * Receive data from device.
  * Return number of bytes, or -1 on error.
  */
-int serial_read(unsigned char *data, int len, int timeout_msec)
+int serial_read(serial_t *s, unsigned char *data, int len, int timeout_msec)
 {
 #if defined(__WIN32__) || defined(WIN32)
     DWORD got;
     COMMTIMEOUTS ctmo;
 
-    /* Reset the Windows RX timeout to the current timeout_msec
-     * value, as it may have changed since the last read.
+    /* Reset the Windows RX timeout, when the timeout_msec
+     * value has changed since the last read.
      */
-    memset(&ctmo, 0, sizeof(ctmo));
-    ctmo.ReadIntervalTimeout = 0;
-    ctmo.ReadTotalTimeoutMultiplier = 0;
-    ctmo.ReadTotalTimeoutConstant = timeout_msec;
-    if (! SetCommTimeouts(fd, &ctmo)) {
-        fprintf(stderr, "Cannot set timeouts in serial_read()\n");
-        return -1;
+    if (timeout_msec != s->timeout_msec) {
+        memset(&ctmo, 0, sizeof(ctmo));
+        ctmo.ReadIntervalTimeout = 0;
+        ctmo.ReadTotalTimeoutMultiplier = 0;
+        ctmo.ReadTotalTimeoutConstant = timeout_msec;
+        if (! SetCommTimeouts(s->fd, &ctmo)) {
+            fprintf(stderr, "Cannot set timeouts in serial_read()\n");
+            return -1;
+        }
+        s->timeout_msec = timeout_msec;
     }
 
-    if (! ReadFile(fd, data, len, &got, 0)) {
+    if (! ReadFile(s->fd, data, len, &got, 0)) {
         fprintf(stderr, "serial_read: read error\n");
-        exit(-1);
+        session_abort(-1);
     }
 #else
-    struct timeval timeout, to2;
     long got;
-    fd_set rfds;
 
-    timeout.tv_sec = timeout_msec / 1000;
-    timeout.tv_usec = timeout_msec % 1000 * 1000;
 again:
-    to2 = timeout;
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
-
-    got = select(fd + 1, &rfds, 0, 0, &to2);
+    got = poll(&s->pfd, 1, timeout_msec);
     if (got < 0) {
         if (errno == EINTR || errno == EAGAIN) {
             if (debug_level > 1)
-                printf("serial_read: retry on select\n");
+                printf("serial_read: retry on poll\n");
             goto again;
         }
-        fprintf(stderr, "serial_read: select error: %s\n", strerror(errno));
-        exit(-1);
+        fprintf(stderr, "serial_read: poll error: %s\n", strerror(errno));
+        session_abort(-1);
     }
 #endif
     if (got == 0) {
@@ -215,10 +223,10 @@ again:
     }
 
 #if ! defined(__WIN32__) && ! defined(WIN32)
-    got = read(fd, data, (len > 1024) ? 1024 : len);
+    got = read(s->fd, data, (len > 1024) ? 1024 : len);
     if (got < 0) {
         fprintf(stderr, "serial_read: read error\n");
-        exit(-1);
+        session_abort(-1);
     }
 #endif
     return got;
@@ -227,29 +235,39 @@ again:
 /*
  * Close the serial port.
  */
-void serial_close()
+void serial_close(serial_t *s)
 {
+    if (! s)
+        return;
 #if defined(__WIN32__) || defined(WIN32)
-    SetCommState(fd, &saved_mode);
-    CloseHandle(fd);
+    SetCommState(s->fd, &s->saved_mode);
+    CloseHandle(s->fd);
 #else
-    tcsetattr(fd, TCSANOW, &saved_mode);
-    close(fd);
+    tcsetattr(s->fd, TCSANOW, &s->saved_mode);
+    close(s->fd);
 #endif
+    free(s);
 }
 
 /*
  * Open the serial port.
- * Return -1 on error.
+ * Return 0 on error.
  */
-int serial_open(const char *devname, int baud_rate)
+serial_t *serial_open(const char *devname, int baud_rate)
 {
+    serial_t *s;
 #if defined(__WIN32__) || defined(WIN32)
     DCB new_mode;
 #else
     struct termios new_mode;
 #endif
 
+    s = calloc(1, sizeof(serial_t));
+    if (! s) {
+        fprintf(stderr, "%s: Out of memory\n", devname);
+        return 0;
+    }
+
 #if defined(__WIN32__) || defined(WIN32)
     /* Check for the Windows device syntax and bend a DOS device
      * into that syntax to allow higher COM numbers than 9
@@ -259,7 +277,8 @@ int serial_open(const char *devname, int baud_rate)
         char *buf = alloca(5 + strlen(devname));
         if (! buf) {
             fprintf(stderr, "%s: Out of memory\n", devname);
-            return -1;
+            free(s);
+            return 0;
         }
         strcpy(buf, "\\\\.\\");
         strcat(buf, devname);
@@ -267,21 +286,25 @@ int serial_open(const char *devname, int baud_rate)
     }
 
     /* Open port */
-    fd = CreateFile(devname, GENERIC_READ | GENERIC_WRITE,
+    s->fd = CreateFile(devname, GENERIC_READ | GENERIC_WRITE,
         0, 0, OPEN_EXISTING, 0, 0);
-    if (fd == INVALID_HANDLE_VALUE) {
+    if (s->fd == INVALID_HANDLE_VALUE) {
         fprintf(stderr, "%s: Cannot open\n", devname);
-        return -1;
+        free(s);
+        return 0;
     }
+    s->timeout_msec = -1;
 
     /* Set serial attributes */
-    memset(&saved_mode, 0, sizeof(saved_mode));
-    if (! GetCommState(fd, &saved_mode)) {
+    memset(&s->saved_mode, 0, sizeof(s->saved_mode));
+    if (! GetCommState(s->fd, &s->saved_mode)) {
         fprintf(stderr, "%s: Cannot get state\n", devname);
-        return -1;
+        CloseHandle(s->fd);
+        free(s);
+        return 0;
     }
 
-    new_mode = saved_mode;
+    new_mode = s->saved_mode;
 
     new_mode.fDtrControl = DTR_CONTROL_ENABLE;
     new_mode.BaudRate = baud_rate;
@@ -297,28 +320,34 @@ int serial_open(const char *devname, int baud_rate)
     new_mode.fNull = FALSE;
     new_mode.fAbortOnError = FALSE;
     new_mode.fBinary = TRUE;
-    if (! SetCommState(fd, &new_mode)) {
+    if (! SetCommState(s->fd, &new_mode)) {
         fprintf(stderr, "%s: Cannot set state\n", devname);
-        return -1;
+        CloseHandle(s->fd);
+        free(s);
+        return 0;
     }
 #else
     /* Encode baud rate. */
     int baud_code = baud_encode(baud_rate);
     if (baud_code < 0) {
         fprintf(stderr, "%s: Bad baud rate %d\n", devname, baud_rate);
-        return -1;
+        free(s);
+        return 0;
     }
 
     /* Open port */
-    fd = open(devname, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd < 0) {
+    s->fd = open(devname, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (s->fd < 0) {
         perror(devname);
-        return -1;
+        free(s);
+        return 0;
     }
+    s->pfd.fd = s->fd;
+    s->pfd.events = POLLIN;
 
     /* Set serial attributes */
-    memset(&saved_mode, 0, sizeof(saved_mode));
-    tcgetattr(fd, &saved_mode);
+    memset(&s->saved_mode, 0, sizeof(s->saved_mode));
+    tcgetattr(s->fd, &s->saved_mode);
 
     /* 8n1, ignore parity */
     memset(&new_mode, 0, sizeof(new_mode));
@@ -330,22 +359,22 @@ int serial_open(const char *devname, int baud_rate)
     new_mode.c_cc[VMIN]  = 1;
     cfsetispeed(&new_mode, baud_code);
     cfsetospeed(&new_mode, baud_code);
-    tcflush(fd, TCIFLUSH);
-    tcsetattr(fd, TCSANOW, &new_mode);
+    tcflush(s->fd, TCIFLUSH);
+    tcsetattr(s->fd, TCSANOW, &new_mode);
 
     /* Clear O_NONBLOCK flag. */
-    int flags = fcntl(fd, F_GETFL, 0);
+    int flags = fcntl(s->fd, F_GETFL, 0);
     if (flags >= 0)
-        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        fcntl(s->fd, F_SETFL, flags & ~O_NONBLOCK);
 #endif
-    return 0;
+    return s;
 }
 
 /*
  * Change baud rate
  * Return -1 on error.
  */
-int serial_baud(int baud_rate)
+int serial_baud(serial_t *s, int baud_rate)
 {
 #if defined(__WIN32__) || defined(WIN32)
     DCB new_mode;
@@ -354,7 +383,7 @@ int serial_baud(int baud_rate)
 #endif
 
 #if defined(__WIN32__) || defined(WIN32)
-    new_mode = saved_mode;
+    new_mode = s->saved_mode;
 
     new_mode.BaudRate = baud_rate;
     new_mode.ByteSize = 8;
@@ -369,7 +398,7 @@ int serial_baud(int baud_rate)
     new_mode.fNull = FALSE;
     new_mode.fAbortOnError = FALSE;
     new_mode.fBinary = TRUE;
-    if (! SetCommState(fd, &new_mode)) {
+    if (! SetCommState(s->fd, &new_mode)) {
         fprintf(stderr, "Cannot set state\n");
         return -1;
     }
@@ -391,13 +420,13 @@ int serial_baud(int baud_rate)
     new_mode.c_cc[VMIN]  = 1;
     cfsetispeed(&new_mode, baud_code);
     cfsetospeed(&new_mode, baud_code);
-    tcflush(fd, TCIFLUSH);
-    tcsetattr(fd, TCSANOW, &new_mode);
+    tcflush(s->fd, TCIFLUSH);
+    tcsetattr(s->fd, TCSANOW, &new_mode);
 
     /* Clear O_NONBLOCK flag. */
-    int flags = fcntl(fd, F_GETFL, 0);
+    int flags = fcntl(s->fd, F_GETFL, 0);
     if (flags >= 0)
-        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        fcntl(s->fd, F_SETFL, flags & ~O_NONBLOCK);
 #endif
     return 0;
 }
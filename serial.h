@@ -12,34 +12,40 @@
 #define _SERIAL_H
 
 /*
- * Open the serial port with the specified baud rate and
- * receive timeout (in milliseconds).
- * Return -1 on error.
+ * Handle of open serial port.
+ * Any number of ports can be open at once.
  */
-int serial_open(const char *devname, int baud_rate);
+typedef struct _serial_t serial_t;
+
+/*
+ * Open the serial port with the specified baud rate.
+ * Return 0 on error.
+ */
+serial_t *serial_open(const char *devname, int baud_rate);
 
 /*
  * Change the serial baud rate
  * Return -1 on error.
  */
-int serial_baud(int baud_rate);
+int serial_baud(serial_t *s, int baud_rate);
 
 /*
  * Close the serial port.
  */
-void serial_close(void);
+void serial_close(serial_t *s);
 
 /*
  * Send data to device.
  * Return number of bytes, or -1 on error.
  */
-int serial_write(unsigned char *data, int len);
+int serial_write(serial_t *s, unsigned char *data, int len);
 
 /*
- * Receive data from device.
- * Return number of bytes, or -1 on error.
+ * Receive data from device, waiting up to timeout
+ * (in milliseconds) for the first byte.
+ * Return number of bytes, 0 on timeout, or -1 on error.
  */
-int serial_read(unsigned char *data, int len, int timeout_msec);
+int serial_read(serial_t *s, unsigned char *data, int len, int timeout_msec);
 
 /*
  * Check whether the given speed in bits per second
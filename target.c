@@ -30,30 +30,30 @@ extern print_func_t print_mk;
 /*
  * PIC32 families.
  */
-                    /*-Boot-Devcfg--Row---Print------Code--------Nwords-Version-*/
+                    /*-Boot-Devcfg--Row---Print------Code--------Nwords-Version-Page-Cluster-*/
 static const
 family_t family_mm_gpl  = { "mm_gpl", FAMILY_MM,
-                        4, 0x1700,  256, print_mm,  pic32_pemm_gpl,  555, 0x0510 };
+                        4, 0x1700,  256, print_mm,  pic32_pemm_gpl,  555, 0x0510, 2048, 0 };
 static const
 family_t family_mm_gpm  = { "mm_gpm", FAMILY_MM,
-                        4, 0x1700,  256, print_mm,  pic32_pemm_gpm,  555, 0x0510 };
+                        4, 0x1700,  256, print_mm,  pic32_pemm_gpm,  555, 0x0510, 2048, 0 };
 
 static const
 family_t family_mx1 = { "mx1", FAMILY_MX1,
-                        3,  0x0bf0, 128,  print_mx1, pic32_pemx1, 422,  0x0301 };
+                        3,  0x0bf0, 128,  print_mx1, pic32_pemx1, 422,  0x0301, 1024, 1 };
 static const
 family_t family_mx3 = { "mx3", FAMILY_MX3,
-                        12, 0x2ff0, 512,  print_mx3, pic32_pemx3, 1044, 0x0201 };
+                        12, 0x2ff0, 512,  print_mx3, pic32_pemx3, 1044, 0x0201, 4096, 1 };
 static const
 family_t family_mz  = { "mz", FAMILY_MZ,
-                        80, 0xffc0, 2048, print_mz,  pic32_pemz,  1052, 0x0502 };
+                        80, 0xffc0, 2048, print_mz,  pic32_pemz,  1052, 0x0502, 16384, 0 };
 
 // Adding MK family support. Please hang on.
 //Name, FAMILY_NAME
 // Boot flash kB, offset of DevCFG from start of BootFlash, Bytes per row, etc.
 static const
 family_t family_mk  = { "mk", FAMILY_MK,
-                        16, 0x3fc0, 512, print_mk,  pic32_pemk,  804, 0x0506 };
+                        16, 0x3fc0, 512, print_mk,  pic32_pemk,  804, 0x0506, 4096, 0 };
 /*
  * This one is a special one for the bootloader. We have no idea what we're
  * programming, so set the values to the maximum out of all the others.
@@ -65,11 +65,12 @@ family_t family_bl  = { "bootloader",
 
 /*
  * Table of PIC32 chip variants.
- * This list can be extended at run time from pic32prog.conf file.
+ * Every session gets a copy, which can be extended
+ * at run time from pic32prog.conf file.
  */
 #define TABSZ   1000
 
-static variant_t pic32_tab[TABSZ] = {
+static const variant_t pic32_tab[] = {
 
     /* MX1/2 family-------------Flash---Family */
     {0x4A07053, "MX110F016B",     16,   &family_mx1},
@@ -313,11 +314,12 @@ static variant_t pic32_tab[TABSZ] = {
  */
 static const struct {
     const char *prefix;
-    adapter_t *(*func)(const char *port, int baud);
+    adapter_t *(*func)(const char *port, int baud, int alt_baud);
 } serial_tab[] = {
     { "stk500",     adapter_open_stk500v2       },  /* Default */
     { "an1388",     adapter_open_an1388_uart    },
     { "ascii",      adapter_open_bitbang        },
+    { "bitbang2",   adapter_open_bitbang2       },
     { 0 },
 };
 
@@ -448,7 +450,7 @@ found:
  * like "bitbang:COM5".
  */
 static adapter_t *open_serial_adapter(const char *port_name, int baud_rate,
-										int interface, int speed)
+										int alt_baud_rate, int interface, int speed)
 {
     const char *prefix, *delimiter;
     int prefix_len, len, i;
@@ -462,7 +464,7 @@ static adapter_t *open_serial_adapter(const char *port_name, int baud_rate,
     delimiter = strchr(port_name, ':');
     if (! delimiter) {
         /* Use stk500v2 protocol by default. */
-        return serial_tab[0].func(port_name, baud_rate);
+        return serial_tab[0].func(port_name, baud_rate, alt_baud_rate);
     }
     prefix_len = delimiter - port_name;
     prefix = port_name;
@@ -473,7 +475,7 @@ static adapter_t *open_serial_adapter(const char *port_name, int baud_rate,
         len = strlen(serial_tab[i].prefix);
         if (prefix_len == len &&
             strncasecmp(prefix, serial_tab[i].prefix, len) == 0) {
-            return serial_tab[i].func(port_name, baud_rate);
+            return serial_tab[i].func(port_name, baud_rate, alt_baud_rate);
         }
     }
     return 0;
@@ -511,31 +513,35 @@ static int is_usb_device(const char *port_name)
 
 /*
  * Connect to JTAG adapter.
+ * Chip variants are looked up in the given table.
  */
-target_t *target_open(const char *port_name, int baud_rate, int interface, int speed)
+target_t *target_open(const char *port_name, int baud_rate, int alt_baud_rate,
+    int interface, int speed, const variant_t *tab)
 {
     target_t *t;
 
     t = calloc(1, sizeof(target_t));
     if (! t) {
         fprintf(stderr, _("Out of memory\n"));
-        exit(-1);
+        session_abort(-1);
     }
     t->cpu_name = "Unknown";
-
-    /* Update pic2_tab[] array from the pic32prog.conf file. */
-    target_configure();
+    t->out = stdout;
 
     /* Find adapter. */
-    if (is_usb_device(port_name)) {
+    if (port_name && strncasecmp(port_name, "sim:", 4) == 0) {
+        t->adapter = adapter_open_sim(port_name + 4, tab);
+    } else if (is_usb_device(port_name)) {
         t->adapter = open_usb_adapter(port_name, interface, speed);
     } else {
-        t->adapter = open_serial_adapter(port_name, baud_rate, interface, speed);
+        t->adapter = open_serial_adapter(port_name, baud_rate, alt_baud_rate,
+            interface, speed);
     }
     if (! t->adapter) {
         fprintf(stderr, "\n");
         fprintf(stderr, _("No target found.\n"));
-        exit(-1);
+        free(t);
+        session_abort(-1);
     }
 
     /* Check CPU identifier. */
@@ -544,22 +550,24 @@ target_t *target_open(const char *port_name, int baud_rate, int interface, int s
         /* Device not responding. */
         fprintf(stderr, _("Unknown CPUID=%08x.\n"), t->cpuid);
         t->adapter->close(t->adapter, 0);
-        exit(1);
+        free(t);
+        session_abort(1);
     }
 
     unsigned i;
-    for (i=0; (t->cpuid ^ pic32_tab[i].devid) & 0x0fffffff; i++) {
-        if (pic32_tab[i].devid == 0) {
+    for (i=0; (t->cpuid ^ tab[i].devid) & 0x0fffffff; i++) {
+        if (tab[i].devid == 0) {
             /* Device not detected. */
             fprintf(stderr, _("Unknown CPUID=%08x.\n"), t->cpuid);
             t->adapter->close(t->adapter, 0);
-            exit(1);
+            free(t);
+            session_abort(1);
         }
     }
-    t->family = pic32_tab[i].family;
-    t->cpu_name = pic32_tab[i].name;
+    t->family = tab[i].family;
+    t->cpu_name = tab[i].name;
     t->flash_addr = 0x1d000000;
-    t->flash_bytes = pic32_tab[i].flash_kbytes * 1024;
+    t->flash_bytes = tab[i].flash_kbytes * 1024;
     if (! t->flash_bytes) {
         t->flash_addr = t->adapter->user_start;
         t->flash_bytes = t->adapter->user_nbytes;
@@ -610,27 +618,57 @@ unsigned target_block_size(target_t *t)
 }
 
 /*
- * Add an entry to the pic32_tab[] array.
+ * Size of flash page, erased by one PE_PAGE_ERASE command.
+ * Zero when page erase is not available.
+ */
+unsigned target_page_size(target_t *t)
+{
+    if (! t->adapter->erase_page || ! t->adapter->get_crc)
+        return 0;
+    return t->family->page_bytes;
+}
+
+/*
+ * Allocate a copy of the pic32_tab[] array,
+ * with free space for entries from config file.
+ */
+variant_t *target_variants()
+{
+    variant_t *tab;
+
+    tab = calloc(TABSZ, sizeof(variant_t));
+    if (! tab) {
+        fprintf(stderr, _("Out of memory\n"));
+        session_abort(-1);
+    }
+    memcpy(tab, pic32_tab, sizeof(pic32_tab));
+    return tab;
+}
+
+/*
+ * Add an entry to the table of variants.
+ * The last entry is kept zero, as end marker.
  */
-void target_add_variant(char *name, unsigned id,
+void target_add_variant(variant_t *tab, char *name, unsigned id,
     char *family, unsigned flash_kbytes)
 {
     int i;
 
     //printf("'%s'\t%07x\t'%s'\t%uk\n", name, id, family, flash_kbytes);
-    for (i=0; i<TABSZ; i++) {
-        if (pic32_tab[i].devid == 0 ||
-            id == pic32_tab[i].devid) {
+    for (i=0; i<TABSZ-1; i++) {
+        if (tab[i].devid == 0 ||
+            id == tab[i].devid) {
             /* Add a new entry or update an existing one
              * with new data from config file. */
-            pic32_tab[i].name = strdup(name);
-            pic32_tab[i].flash_kbytes = flash_kbytes;
+            tab[i].devid = id;
+            tab[i].name = strdup(name);
+            tab[i].flash_kbytes = flash_kbytes;
             if (strcmp(family, "MX1") == 0)
-                pic32_tab[i].family = &family_mx1;
+                tab[i].family = &family_mx1;
             else if (strcmp(family, "MX3") == 0)
-                pic32_tab[i].family = &family_mx3;
+                tab[i].family = &family_mx3;
             else if (strcmp(family, "MZ") == 0)
-                pic32_tab[i].family = &family_mz;
+                tab[i].family = &family_mz;
             else {
                 fprintf(stderr, "%s: Unknown family=%s.\n", name, family);
             }
@@ -644,9 +682,25 @@ void target_add_variant(char *name, unsigned id,
  */
 void target_use_executive(target_t *t)
 {
-    if (t->adapter->load_executive != 0 && t->family->pe_nwords != 0)
+    if (t->pe_loaded)
+        return;
+    if (t->adapter->load_executive != 0 && t->family->pe_nwords != 0) {
         t->adapter->load_executive(t->adapter,
             t->family->pe_code, t->family->pe_nwords, t->family->pe_version);
+        t->pe_loaded = 1;
+    }
+}
+
+/*
+ * Make sure the PE is running, when the target stays open
+ * between calls: the board could be reset since then.
+ * The adapter checks the PE, loaded before, and loads it
+ * again when it is not running.
+ */
+void target_check_executive(target_t *t)
+{
+    t->pe_loaded = 0;
+    target_use_executive(t);
 }
 
 /*
@@ -654,6 +708,8 @@ void target_use_executive(target_t *t)
  */
 void target_print_devcfg(target_t *t)
 {
+    unsigned addr[18], val[18], i;
+
     if (! t->family->devcfg_offset)
         return;
 
@@ -662,68 +718,67 @@ void target_print_devcfg(target_t *t)
         uint32_t offset_first = 0xc0;
         uint32_t offset_alternate = 0x40;
 
-        uint32_t fdevopt = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x04);
-        uint32_t ficd    = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x08);
-        uint32_t fpor    = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x0c);
-        uint32_t fwdt    = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x10);
-        uint32_t foscsel = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x14);
-        uint32_t fsec    = t->adapter->read_word(t->adapter, devcfg_addr + offset_first + 0x18);
-        uint32_t afdevopt = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x04);
-        uint32_t aficd    = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x08);
-        uint32_t afpor    = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x0c);
-        uint32_t afwdt    = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x10);
-        uint32_t afoscsel = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x14);
-        uint32_t afsec    = t->adapter->read_word(t->adapter, devcfg_addr + offset_alternate + 0x18);
+        /* FDEVOPT, FICD, FPOR, FWDT, FOSCSEL, FSEC, then alternate set */
+        for (i=0; i<6; i++) {
+            addr[i]   = devcfg_addr + offset_first + 0x04 + i*4;
+            addr[i+6] = devcfg_addr + offset_alternate + 0x04 + i*4;
+        }
+        target_read_words(t, addr, 12, val);
+
+        uint32_t fdevopt = val[0];
+        uint32_t ficd    = val[1];
+        uint32_t fpor    = val[2];
+        uint32_t fwdt    = val[3];
+        uint32_t foscsel = val[4];
+        uint32_t fsec    = val[5];
+        uint32_t afdevopt = val[6];
+        uint32_t aficd    = val[7];
+        uint32_t afpor    = val[8];
+        uint32_t afwdt    = val[9];
+        uint32_t afoscsel = val[10];
+        uint32_t afsec    = val[11];
         if (fdevopt == 0 || afdevopt == 0){
             fprintf(stderr, "Failed to read config value, or values are garbage\n");
             return;
         }
-        print_mm(fdevopt, ficd, fpor, fwdt, foscsel, fsec,
+        print_mm(t->out, fdevopt, ficd, fpor, fwdt, foscsel, fsec,
                                 afdevopt, aficd, afpor, afwdt, afoscsel, afsec,
 								0, 0, 0, 0, 0, 0);
     }
     else if (FAMILY_MK == t->family->name_short){
 		// Offset is set to BF1DEVCFG3 in Boot Flash 1!
         uint32_t devcfg_addr    = 0x1fc40000 + target_devcfg_offset(t);
+        static const unsigned bf_offset[7] = {
+            0x00, 0x04, 0x08, 0x0c, 0x1c, 0x2c, 0x30,
+        };
 
-		// Boot flash 1 area
-        uint32_t bf1devcfg3     = t->adapter->read_word(t->adapter, devcfg_addr);
-        uint32_t bf1devcfg2     = t->adapter->read_word(t->adapter, devcfg_addr + 0x04);
-        uint32_t bf1devcfg1     = t->adapter->read_word(t->adapter, devcfg_addr + 0x08);
-        uint32_t bf1devcfg0     = t->adapter->read_word(t->adapter, devcfg_addr + 0x0c);
-        uint32_t bf1devcp       = t->adapter->read_word(t->adapter, devcfg_addr + 0x1c);
-        uint32_t bf1devsign     = t->adapter->read_word(t->adapter, devcfg_addr + 0x2c);
-        uint32_t bf1seq 	    = t->adapter->read_word(t->adapter, devcfg_addr + 0x30);
-
-		// Boot flash 2 area
-        uint32_t bf2devcfg3 	= t->adapter->read_word(t->adapter, devcfg_addr + 0x20000);
-        uint32_t bf2devcfg2 	= t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x04);
-        uint32_t bf2devcfg1 	= t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x8);
-        uint32_t bf2devcfg0 	= t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x0c);
-        uint32_t bf2devcp       = t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x1c);
-        uint32_t bf2devsign     = t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x2c);
-        uint32_t bf2seq 	    = t->adapter->read_word(t->adapter, devcfg_addr + 0x20000 + 0x30);
-
-		// DEVSNx registers
-        uint32_t devsn0         = t->adapter->read_word(t->adapter, 0x1FC45020);
-        uint32_t devsn1         = t->adapter->read_word(t->adapter, 0x1FC45024);
-        uint32_t devsn2         = t->adapter->read_word(t->adapter, 0x1FC45028);
-        uint32_t devsn3         = t->adapter->read_word(t->adapter, 0x1FC4502C);
+        for (i=0; i<7; i++) {
+            addr[i]   = devcfg_addr + bf_offset[i];             // Boot flash 1 area
+            addr[i+7] = devcfg_addr + 0x20000 + bf_offset[i];   // Boot flash 2 area
+        }
+        for (i=0; i<4; i++)
+            addr[i+14] = 0x1FC45020 + i*4;                      // DEVSNx registers
+        target_read_words(t, addr, 18, val);
 
         if (t->family->print_devcfg) {
-            t->family->print_devcfg(bf1devcfg3, bf1devcfg2, bf1devcfg1, bf1devcfg0,
-                                    bf1devcp, bf1devsign, bf1seq,
-                                    bf2devcfg3, bf2devcfg2, bf2devcfg1, bf2devcfg0,
-                                    bf2devcp, bf2devsign, bf2seq,
-                                    devsn0, devsn1, devsn2, devsn3);
+            t->family->print_devcfg(t->out, val[0], val[1], val[2], val[3],
+                                    val[4], val[5], val[6],
+                                    val[7], val[8], val[9], val[10],
+                                    val[11], val[12], val[13],
+                                    val[14], val[15], val[16], val[17]);
         }
     } else {
         /* MX, MZ */
         unsigned devcfg_addr = 0x1fc00000 + target_devcfg_offset(t);
-        unsigned devcfg3 = t->adapter->read_word(t->adapter, devcfg_addr);
-        unsigned devcfg2 = t->adapter->read_word(t->adapter, devcfg_addr + 4);
-        unsigned devcfg1 = t->adapter->read_word(t->adapter, devcfg_addr + 8);
-        unsigned devcfg0 = t->adapter->read_word(t->adapter, devcfg_addr + 12);
+
+        for (i=0; i<4; i++)
+            addr[i] = devcfg_addr + i*4;
+        target_read_words(t, addr, 4, val);
+
+        unsigned devcfg3 = val[0];
+        unsigned devcfg2 = val[1];
+        unsigned devcfg1 = val[2];
+        unsigned devcfg0 = val[3];
 
         if (devcfg3 == 0xffffffff && devcfg2 == 0xffffffff &&
             devcfg1 == 0xffffffff && devcfg0 == 0x7fffffff)
@@ -732,8 +787,8 @@ void target_print_devcfg(target_t *t)
             return;
 
         if (t->family->print_devcfg) {
-            printf(_("Configuration:\n"));
-            t->family->print_devcfg(devcfg0, devcfg1, devcfg2, devcfg3,
+            fprintf(t->out, _("Configuration:\n"));
+            t->family->print_devcfg(t->out, devcfg0, devcfg1, devcfg2, devcfg3,
                                     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
         }
     }
@@ -751,6 +806,37 @@ static unsigned virt_to_phys(unsigned addr)
     return addr;
 }
 
+/*
+ * Read a series of words from memory.
+ * Use the batched read, when the adapter has it.
+ * Serial execution is not available while the PE is running,
+ * so in that case whole 1-kbyte blocks are read with the PE.
+ */
+void target_read_words(target_t *t, const unsigned *addr,
+    unsigned nwords, unsigned *data)
+{
+    unsigned block [256], block_addr = ~0, i;
+
+    if (t->pe_loaded && t->adapter->read_data) {
+        for (i=0; i<nwords; i++) {
+            unsigned a = virt_to_phys(addr[i]);
+
+            if ((a & ~1023) != block_addr) {
+                block_addr = a & ~1023;
+                t->adapter->read_data(t->adapter, block_addr, 256, block);
+            }
+            data[i] = block [(a & 1023) >> 2];
+        }
+        return;
+    }
+    if (t->adapter->read_words) {
+        t->adapter->read_words(t->adapter, addr, nwords, data);
+        return;
+    }
+    for (i=0; i<nwords; i++)
+        data[i] = t->adapter->read_word(t->adapter, addr[i]);
+}
+
 /*
  * Read data from memory.
  */
@@ -758,8 +844,8 @@ void target_read_block(target_t *t, unsigned addr,
     unsigned nwords, unsigned *data)
 {
     if (! t->adapter->read_data) {
-        printf(_("\nData reading not supported by the adapter.\n"));
-        exit(1);
+        fprintf(t->out, _("\nData reading not supported by the adapter.\n"));
+        session_abort(1);
     }
 
     addr = virt_to_phys(addr);
@@ -778,8 +864,9 @@ void target_read_block(target_t *t, unsigned addr,
 
 /*
  * Verify data.
+ * Return 0 on mismatch.
  */
-void target_verify_block(target_t *t, unsigned addr,
+int target_verify_block(target_t *t, unsigned addr,
     unsigned nwords, unsigned *data)
 {
     unsigned i, word, expected, block[512];
@@ -787,7 +874,7 @@ void target_verify_block(target_t *t, unsigned addr,
     //fprintf(stderr, "%s: addr=%08x, nwords=%u, data=%08x...\n", __func__, addr, nwords, data[0]);
     if (t->adapter->verify_data != 0) {
         t->adapter->verify_data(t->adapter, virt_to_phys(addr), nwords, data);
-        return;
+        return 1;
     }
 
     t->adapter->read_data(t->adapter, addr, nwords, block);
@@ -795,11 +882,86 @@ void target_verify_block(target_t *t, unsigned addr,
         expected = data [i];
         word = block [i];
         if (word != expected) {
-            printf(_("\nerror at address %08X: file=%08X, mem=%08X\n"),
+            fprintf(t->out, _("\nerror at address %08X: file=%08X, mem=%08X\n"),
                 addr + i*4, expected, word);
-            exit(1);
+            return 0;
         }
     }
+    return 1;
+}
+
+/*
+ * Compare checksum of memory with checksum of data.
+ * Return 1 on match, 0 on mismatch, -1 when checksum is not available.
+ */
+int target_check_crc(target_t *t, unsigned addr,
+    unsigned nwords, unsigned *data)
+{
+    int flash_crc;
+
+    if (! t->adapter->get_crc)
+        return -1;
+    flash_crc = t->adapter->get_crc(t->adapter, virt_to_phys(addr), nwords * 4);
+    if (flash_crc < 0)
+        return -1;
+    return flash_crc == pic32_crc16(0xffff, (unsigned char*) data, nwords * 4);
+}
+
+/*
+ * Max size of memory, covered by one checksum command.
+ */
+#define CRC_MAX_BYTES   (64 * 1024)
+
+/*
+ * Verify a contiguous range of memory, multiple of block size.
+ * When the adapter can get a checksum from PE, one command covers
+ * the whole range (up to CRC_MAX_BYTES). A mismatching range is bisected
+ * down to a single block, which is reported.
+ * Otherwise verify block by block.
+ * Return 0 on mismatch.
+ */
+int target_verify_range(target_t *t, unsigned addr,
+    unsigned nwords, unsigned *data, unsigned block_words)
+{
+    unsigned n, half;
+    int status;
+
+    while (nwords > 0) {
+        n = nwords;
+        if (n > CRC_MAX_BYTES / 4)
+            n = CRC_MAX_BYTES / 4 / block_words * block_words;
+
+        status = target_check_crc(t, addr, n, data);
+        if (status < 0) {
+            /* No checksum available. */
+            for (; nwords > 0; nwords -= block_words) {
+                if (! target_verify_block(t, addr, block_words, data))
+                    return 0;
+                addr += block_words * 4;
+                data += block_words;
+            }
+            return 1;
+        }
+        if (status == 0) {
+            /* Bisect down to a single block. */
+            while (n > block_words) {
+                half = n / block_words / 2 * block_words;
+                if (target_check_crc(t, addr, half, data)) {
+                    addr += half * 4;
+                    data += half;
+                    n -= half;
+                } else
+                    n = half;
+            }
+            fprintf(t->out, _("\nchecksum error in block %08X-%08X\n"),
+                addr, addr + n*4 - 1);
+            return 0;
+        }
+        addr += n * 4;
+        data += n;
+        nwords -= n;
+    }
+    return 1;
 }
 
 /*
@@ -808,14 +970,56 @@ void target_verify_block(target_t *t, unsigned addr,
 int target_erase(target_t *t)
 {
     if (t->adapter->erase_chip) {
-        printf(_("        Erase: "));
-        fflush(stdout);
+        fprintf(t->out, _("        Erase: "));
+        fflush(t->out);
         t->adapter->erase_chip(t->adapter);
-        printf(_("done\n"));
+        fprintf(t->out, _("done\n"));
+
+        /* Chip erase resets the processor. */
+        t->pe_loaded = 0;
+    }
+    return 1;
+}
+
+/*
+ * Erase a range of flash memory by pages.
+ * The range is extended to page boundaries.
+ * Return 0 when page erase is not supported by the adapter.
+ */
+int target_erase_range(target_t *t, unsigned addr, unsigned nbytes)
+{
+    unsigned page_bytes = t->family->page_bytes;
+    unsigned end, npages;
+
+    if (! t->adapter->erase_page || ! page_bytes || ! nbytes)
+        return 0;
+
+    end = addr + nbytes;
+    addr &= ~(page_bytes - 1);
+    npages = (end - addr + page_bytes - 1) / page_bytes;
+    addr = virt_to_phys(addr);
+    while (npages > 0) {
+        /* Page count is a 16-bit field of the PE command. */
+        unsigned n = (npages > 0xffff) ? 0xffff : npages;
+
+        t->adapter->erase_page(t->adapter, addr, n);
+        addr += n * page_bytes;
+        npages -= n;
     }
     return 1;
 }
 
+/*
+ * Check that a range of flash memory is erased.
+ * Return 1 when blank, 0 when not blank, -1 when not supported.
+ */
+int target_blank_check(target_t *t, unsigned addr, unsigned nbytes)
+{
+    if (! t->adapter->blank_check)
+        return -1;
+    return t->adapter->blank_check(t->adapter, virt_to_phys(addr), nbytes);
+}
+
 /*
  * Test block for non 0xFFFFFFFF value
  */
@@ -836,6 +1040,36 @@ void target_program_block(target_t *t, unsigned addr,
     addr = virt_to_phys(addr);
     //fprintf(stderr, "target_program_block(addr = %x, nwords = %d)\n", addr, nwords);
 
+    if (t->adapter->program_cluster && t->family->pe_cluster &&
+        t->adapter->program_row) {
+        /* Program contiguous runs of non-empty rows
+         * by one PROGRAM_CLUSTER command. */
+        unsigned words_per_row = t->family->bytes_per_row / 4;
+        unsigned *start = 0, start_addr = 0, run = 0;
+
+        while (nwords > 0) {
+            unsigned n = nwords;
+            if (n > words_per_row)
+                n = words_per_row;
+            if (target_test_empty_block(data, n)) {
+                if (run > 0)
+                    t->adapter->program_cluster(t->adapter, start_addr, start, run);
+                run = 0;
+            } else {
+                if (run == 0) {
+                    start = data;
+                    start_addr = addr;
+                }
+                run += n;
+            }
+            addr += n<<2;
+            data += n;
+            nwords -= n;
+        }
+        if (run > 0)
+            t->adapter->program_cluster(t->adapter, start_addr, start, run);
+        return;
+    }
     if (! t->adapter->program_block) {
         unsigned words_per_row = t->family->bytes_per_row / 4;
         while (nwords > 0) {
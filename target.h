@@ -12,9 +12,10 @@
 #define _TARGET_H
 
 #include "adapter.h"
+#include <stdio.h>
 #include <stdint.h> 
 
-typedef void print_func_t(unsigned cfg0, unsigned cfg1, unsigned cfg2, unsigned cfg3,
+typedef void print_func_t(FILE *out, unsigned cfg0, unsigned cfg1, unsigned cfg2, unsigned cfg3,
 						unsigned cfg4, unsigned cfg5, unsigned cfg6, unsigned cfg7,
 						unsigned cfg8, unsigned cfg9, unsigned cfg10, unsigned cfg11,
                         unsigned cfg12, unsigned cfg13, unsigned cfg14, unsigned cfg15,
@@ -30,6 +31,8 @@ typedef struct {
     const unsigned  *pe_code;
     unsigned        pe_nwords;
     unsigned        pe_version;
+    unsigned        page_bytes;
+    unsigned        pe_cluster;         /* PE has PROGRAM_CLUSTER command */
 } family_t;
 
 typedef struct {
@@ -47,13 +50,24 @@ typedef struct {
     unsigned        flash_addr;
     unsigned        flash_bytes;
     unsigned        boot_bytes;
+    unsigned        pe_loaded;          /* PE is running */
+    FILE            *out;               /* Messages and progress */
 } target_t;
 
-target_t *target_open(const char *port, int baud_rate, int interface, int speed);
+target_t *target_open(const char *port, int baud_rate, int alt_baud_rate,
+    int interface, int speed, const variant_t *tab);
 void target_close(target_t *t, int power_on);
 void target_use_executive(target_t *t);
-void target_configure(void);
-void target_add_variant(char *name, unsigned id, char *family, unsigned flash_kbytes);
+void target_check_executive(target_t *t);
+variant_t *target_variants(void);
+void target_configure(variant_t *tab, const char *progname, int debug_level);
+void target_add_variant(variant_t *tab, char *name, unsigned id,
+    char *family, unsigned flash_kbytes);
+
+/*
+ * Simulated target: needs the table of variants.
+ */
+adapter_t *adapter_open_sim(const char *spec, const variant_t *tab);
 
 unsigned target_idcode(target_t *t);
 const char *target_cpu_name(target_t *t);
@@ -61,15 +75,24 @@ unsigned target_flash_width(target_t *t);
 unsigned target_flash_bytes(target_t *t);
 unsigned target_boot_bytes(target_t *t);
 unsigned target_block_size(target_t *t);
+unsigned target_page_size(target_t *t);
 unsigned target_devcfg_offset(target_t *t);
 void target_print_devcfg(target_t *t);
 
 void target_read_block(target_t *t, unsigned addr,
     unsigned nwords, unsigned *data);
-void target_verify_block(target_t *t, unsigned addr,
+void target_read_words(target_t *t, const unsigned *addr,
+    unsigned nwords, unsigned *data);
+int target_verify_block(target_t *t, unsigned addr,
+    unsigned nwords, unsigned *data);
+int target_verify_range(target_t *t, unsigned addr,
+    unsigned nwords, unsigned *data, unsigned block_words);
+int target_check_crc(target_t *t, unsigned addr,
     unsigned nwords, unsigned *data);
 
 int target_erase(target_t *t);
+int target_erase_range(target_t *t, unsigned addr, unsigned nbytes);
+int target_blank_check(target_t *t, unsigned addr, unsigned nbytes);
 void target_program_block(target_t *t, unsigned addr,
     unsigned nwords, unsigned *data);
 void target_program_devcfg(target_t *t, uint32_t arg0, uint32_t arg1,